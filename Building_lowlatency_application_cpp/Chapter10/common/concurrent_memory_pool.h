@@ -0,0 +1,140 @@
+#ifndef CONCURRENT_MEMORY_POOL_H
+#define CONCURRENT_MEMORY_POOL_H
+
+#include <array>
+#include <atomic>
+#include "memory_pool.h"
+
+namespace thu{
+    constexpr size_t CMP_MAX_THREADS = 32;
+    constexpr size_t CMP_MAGAZINE_SIZE = 64;
+
+    // Fixed capacity object pool that lets one thread allocate and another free, so objects can be handed over by pointer.
+    // Each thread registers once and gets a ThreadCache. Slots remember the cache that first carved them from the slab:
+    // the home thread recycles them through a private free list (its magazine) with plain loads and stores, any other thread
+    // returns them with a single CAS onto the home cache's remote list, which the home thread takes over in one exchange
+    // when its magazine runs dry. Only the refill from the shared slab touches a counter that all threads share.
+    template<typename T>
+    class ConcurrentMemPool final{
+    private:
+        struct Slot{
+            union{
+                Slot *next_free_;
+                alignas(T) std::byte storage_[sizeof(T)];
+            };
+            uint32_t home_ = 0;
+        };
+
+    public:
+        class ThreadCache{
+        private:
+            // pushed to by every other thread
+            alignas(CACHE_LINE_SIZE) std::atomic<Slot*> remote_free_ = {nullptr};
+            // owner thread only
+            alignas(CACHE_LINE_SIZE) Slot *local_free_ = nullptr;
+            uint32_t id_ = 0;
+            size_t allocated_ = 0;
+            size_t remote_frees_ = 0;
+
+            friend class ConcurrentMemPool;
+
+        public:
+            // objects allocated and remote frees issued by this thread, read them from the owner thread
+            auto allocated() const noexcept{
+                return allocated_;
+            }
+            auto remoteFrees() const noexcept{
+                return remote_frees_;
+            }
+        };
+
+    private:
+        Slot *store_ = nullptr;
+        const size_t num_elems_;
+        size_t mapped_bytes_ = 0;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> next_unused_index_ = {0};
+        std::atomic<uint32_t> num_caches_ = {0};
+        std::array<ThreadCache, CMP_MAX_THREADS> caches_;
+
+        // Magazine is empty: take back what other threads freed, otherwise carve a fresh batch from the slab.
+        auto refill(ThreadCache *cache) noexcept{
+            cache->local_free_ = cache->remote_free_.exchange(nullptr, std::memory_order_acquire);
+            if(cache->local_free_){
+                return;
+            }
+
+            const auto begin = next_unused_index_.fetch_add(CMP_MAGAZINE_SIZE, std::memory_order_relaxed);
+            ASSERT(begin < num_elems_, "ConcurrentMemPool out of space.");
+            const auto end = std::min(begin + CMP_MAGAZINE_SIZE, num_elems_);
+            for(auto i = end; i-- > begin;){
+                store_[i].home_ = cache->id_;
+                store_[i].next_free_ = cache->local_free_;
+                cache->local_free_ = &store_[i];
+            }
+        }
+
+    public:
+        explicit ConcurrentMemPool(std::size_t num_elems, MemPoolFlags flags = MEMPOOL_PREFAULT) : num_elems_(num_elems){
+            ASSERT(num_elems_ > 0, "ConcurrentMemPool needs at least one element.");
+            const auto [mem, mapped_bytes] = mapPoolMemory(num_elems_ * sizeof(Slot), flags);
+            store_ = static_cast<Slot*>(mem);
+            mapped_bytes_ = mapped_bytes;
+        }
+
+        ~ConcurrentMemPool(){
+            munmap(store_, mapped_bytes_);
+        }
+
+        ConcurrentMemPool() = delete;
+        ConcurrentMemPool(const ConcurrentMemPool&) = delete;
+        ConcurrentMemPool& operator=(const ConcurrentMemPool&) = delete;
+        ConcurrentMemPool(ConcurrentMemPool&&) = delete;
+        ConcurrentMemPool& operator=(ConcurrentMemPool&&) = delete;
+
+        // Call once from every thread that allocates or frees, and keep the returned cache for that thread only.
+        auto registerThread() noexcept -> ThreadCache*{
+            const auto id = num_caches_.fetch_add(1, std::memory_order_relaxed);
+            ASSERT(id < CMP_MAX_THREADS, "ConcurrentMemPool supports at most " + std::to_string(CMP_MAX_THREADS) + " threads.");
+            caches_[id].id_ = id;
+            return &caches_[id];
+        }
+
+        template<typename... Args>
+        T* allocate(ThreadCache *cache, Args... args) noexcept{
+            if(UNLIKELY(!cache->local_free_)){
+                refill(cache);
+            }
+            Slot *slot = cache->local_free_;
+            cache->local_free_ = slot->next_free_;
+            ++cache->allocated_;
+            return new(slot->storage_) T(args...); // placement new
+        }
+
+        // Can be called from any registered thread, not only the one that allocated elem.
+        auto deallocate(ThreadCache *cache, const T *elem) noexcept{
+            const auto offset = reinterpret_cast<uintptr_t>(elem) - reinterpret_cast<uintptr_t>(store_);
+            ASSERT(offset < num_elems_ * sizeof(Slot) && offset % sizeof(Slot) == 0, "Element being deallocated does not belong to this Memory pool.");
+            auto slot = reinterpret_cast<Slot*>(const_cast<T*>(elem));
+            elem->~T();
+
+            if(LIKELY(slot->home_ == cache->id_)){
+                slot->next_free_ = cache->local_free_;
+                cache->local_free_ = slot;
+                return;
+            }
+
+            // Only whole lists are ever removed from remote_free_, so the push is free of ABA.
+            auto &remote_free = caches_[slot->home_].remote_free_;
+            slot->next_free_ = remote_free.load(std::memory_order_relaxed);
+            while(!remote_free.compare_exchange_weak(slot->next_free_, slot, std::memory_order_release, std::memory_order_relaxed));
+            ++cache->remote_frees_;
+        }
+
+        auto capacity() const noexcept{
+            return num_elems_;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace thu{
+    // "0-3,8,10-11" as found in /sys cpu lists, empty on a malformed list
+    inline auto parseCpuList(const std::string &list) -> std::vector<int>{
+        std::vector<int> cpus;
+        size_t pos = 0;
+        while(pos < list.size()){
+            auto end = list.find(',', pos);
+            if(end == std::string::npos){
+                end = list.size();
+            }
+            const auto range = list.substr(pos, end - pos);
+            pos = end + 1;
+            if(range.find_first_not_of(" \t\n") == std::string::npos){
+                continue;
+            }
+            try{
+                const auto dash = range.find('-');
+                const int first = std::stoi(range.substr(0, dash));
+                const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for(int cpu = first; cpu <= last; ++cpu){
+                    cpus.push_back(cpu);
+                }
+            }
+            catch(const std::exception&){
+                return {};
+            }
+        }
+        return cpus;
+    }
+
+    struct CpuInfo{
+        int cpu_ = -1;
+        int package_ = -1;
+        int numa_node_ = -1;
+        int llc_id_ = -1;               // lowest cpu sharing the last level cache with this one
+        std::vector<int> smt_siblings_; // logical cpus on the same physical core, this one included
+    };
+
+    // Online cpus as described under /sys/devices/system. Fields that cannot be read stay -1 / empty,
+    // e.g. in containers that hide parts of /sys.
+    class CpuTopology final{
+    private:
+        std::vector<CpuInfo> cpus_;
+
+        static auto readLine(const std::string &path){
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+
+        static auto readInt(const std::string &path){
+            const auto line = readLine(path);
+            try{
+                return line.empty() ? -1 : std::stoi(line);
+            }
+            catch(const std::exception&){
+                return -1;
+            }
+        }
+
+    public:
+        CpuTopology(){
+            const std::string cpu_dir = "/sys/devices/system/cpu/";
+            for(const auto cpu : parseCpuList(readLine(cpu_dir + "online"))){
+                const auto dir = cpu_dir + "cpu" + std::to_string(cpu) + "/";
+                CpuInfo info;
+                info.cpu_ = cpu;
+                info.package_ = readInt(dir + "topology/physical_package_id");
+                info.smt_siblings_ = parseCpuList(readLine(dir + "topology/thread_siblings_list"));
+                if(info.smt_siblings_.empty()){
+                    info.smt_siblings_.push_back(cpu);
+                }
+                int llc_level = 0;
+                for(int index = 0; std::filesystem::exists(dir + "cache/index" + std::to_string(index)); ++index){
+                    const auto cache_dir = dir + "cache/index" + std::to_string(index) + "/";
+                    const auto level = readInt(cache_dir + "level");
+                    const auto shared = parseCpuList(readLine(cache_dir + "shared_cpu_list"));
+                    if(level > llc_level && !shared.empty()){
+                        llc_level = level;
+                        info.llc_id_ = *std::min_element(shared.begin(), shared.end());
+                    }
+                }
+                cpus_.push_back(info);
+            }
+            const std::string node_dir = "/sys/devices/system/node/";
+            for(const auto node : parseCpuList(readLine(node_dir + "online"))){
+                const auto node_cpus = parseCpuList(readLine(node_dir + "node" + std::to_string(node) + "/cpulist"));
+                for(auto &info : cpus_){
+                    if(std::find(node_cpus.begin(), node_cpus.end(), info.cpu_) != node_cpus.end()){
+                        info.numa_node_ = node;
+                    }
+                }
+            }
+        }
+
+        auto cpus() const noexcept -> const std::vector<CpuInfo>&{
+            return cpus_;
+        }
+
+        // nullptr for a cpu that is not online
+        auto find(int cpu) const noexcept -> const CpuInfo*{
+            for(const auto &info : cpus_){
+                if(info.cpu_ == cpu){
+                    return &info;
+                }
+            }
+            return nullptr;
+        }
+
+        // Different logical cpus of one physical core, they share its execution units and L1/L2
+        auto smtSiblings(int cpu_a, int cpu_b) const noexcept{
+            const auto info = find(cpu_a);
+            return cpu_a != cpu_b && info
+                    && std::find(info->smt_siblings_.begin(), info->smt_siblings_.end(), cpu_b) != info->smt_siblings_.end();
+        }
+
+        // One line per cpu, e.g. "cpu:2 package:0 node:0 llc:0 smt:2,10"
+        auto toString() const{
+            std::string s;
+            for(const auto &info : cpus_){
+                s += "cpu:" + std::to_string(info.cpu_) + " package:" + std::to_string(info.package_) + " node:" + std::to_string(info.numa_node_)
+                        + " llc:" + std::to_string(info.llc_id_) + " smt:";
+                for(size_t i = 0; i < info.smt_siblings_.size(); ++i){
+                    if(i){
+                        s += ',';
+                    }
+                    s += std::to_string(info.smt_siblings_[i]);
+                }
+                s += "\n";
+            }
+            return s;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include "macros.h"
+
+namespace thu{
+    // Log-linear buckets: values below 2^HISTOGRAM_SUB_BUCKET_BITS get a bucket each, above that every power of two
+    // is split into 2^HISTOGRAM_SUB_BUCKET_BITS buckets, so any recorded value is reported within ~3% of itself.
+    constexpr size_t HISTOGRAM_SUB_BUCKET_BITS = 5;
+    constexpr size_t HISTOGRAM_SUB_BUCKETS = size_t{1} << HISTOGRAM_SUB_BUCKET_BITS;
+    constexpr size_t HISTOGRAM_BUCKETS = (64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+    // percentiles reported by toString(), toCSV() and toJSON()
+    constexpr std::array<double, 6> HISTOGRAM_PERCENTILES = {50, 90, 99, 99.9, 99.99, 99.999};
+
+    constexpr auto histogramBucketIndex(uint64_t value) noexcept -> size_t{
+        if(value < HISTOGRAM_SUB_BUCKETS){
+            return value;
+        }
+        const size_t exponent = std::bit_width(value) - 1;
+        const size_t shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+        return (shift + 1) * HISTOGRAM_SUB_BUCKETS + ((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+    }
+
+    // Largest value that falls into bucket index
+    constexpr auto histogramBucketHighestValue(size_t index) noexcept -> uint64_t{
+        if(index < HISTOGRAM_SUB_BUCKETS){
+            return index;
+        }
+        const size_t shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+        const uint64_t sub_bucket = HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    // Plain copy of a histogram owned by whoever reads it: percentiles, merging and output all work on snapshots,
+    // so the recording thread is never held up by a reader.
+    class HistogramSnapshot final{
+    private:
+        std::array<uint64_t, HISTOGRAM_BUCKETS> counts_ = {};
+        uint64_t count_ = 0;
+        uint64_t sum_ = 0;
+        uint64_t min_ = std::numeric_limits<uint64_t>::max();
+        uint64_t max_ = 0;
+
+        friend class LatencyHistogram;
+
+        static auto toString(double value){
+            auto s = std::to_string(value);
+            s.erase(s.find_last_not_of('0') + 1);
+            if(s.back() == '.'){
+                s.pop_back();
+            }
+            return s;
+        }
+
+    public:
+        // e.g. to combine the histograms of several threads or runs
+        auto merge(const HistogramSnapshot &other) noexcept{
+            for(size_t i = 0; i < HISTOGRAM_BUCKETS; ++i){
+                counts_[i] += other.counts_[i];
+            }
+            count_ += other.count_;
+            sum_ += other.sum_;
+            min_ = std::min(min_, other.min_);
+            max_ = std::max(max_, other.max_);
+        }
+
+        auto count() const noexcept{
+            return count_;
+        }
+        auto min() const noexcept -> uint64_t{
+            return count_ ? min_ : 0;
+        }
+        auto max() const noexcept{
+            return max_;
+        }
+        auto mean() const noexcept -> double{
+            return count_ ? static_cast<double>(sum_) / count_ : 0;
+        }
+
+        // percentile in [0, 100], returns the highest value of the bucket holding that rank, capped at max()
+        auto percentile(double percentile) const noexcept -> uint64_t{
+            if(!count_){
+                return 0;
+            }
+            const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5));
+            uint64_t seen = 0;
+            for(size_t i = 0; i < HISTOGRAM_BUCKETS; ++i){
+                seen += counts_[i];
+                if(seen >= rank){
+                    return std::min(histogramBucketHighestValue(i), max_);
+                }
+            }
+            return max_;
+        }
+
+        // "count:1000 min:80 p50:120 p90:200 ... max:1200 mean:130.5"
+        auto toString() const{
+            std::string s = "count:" + std::to_string(count()) + " min:" + std::to_string(min());
+            for(const auto p : HISTOGRAM_PERCENTILES){
+                s += " p" + toString(p) + ":" + std::to_string(percentile(p));
+            }
+            return s + " max:" + std::to_string(max()) + " mean:" + toString(mean());
+        }
+
+        // Matches the columns of toCSV()
+        static auto csvHeader(){
+            std::string s = "name,count,min";
+            for(const auto p : HISTOGRAM_PERCENTILES){
+                s += ",p" + toString(p);
+            }
+            return s + ",max,mean\n";
+        }
+
+        auto toCSV(const std::string &name) const{
+            std::string s = name + "," + std::to_string(count()) + "," + std::to_string(min());
+            for(const auto p : HISTOGRAM_PERCENTILES){
+                s += "," + std::to_string(percentile(p));
+            }
+            return s + "," + std::to_string(max()) + "," + toString(mean()) + "\n";
+        }
+
+        // {"name":"...","count":1000,"min":80,"p50":120,...,"max":1200,"mean":130.5,"buckets":[[highest_value,count],...]}
+        // Only non-empty buckets are listed.
+        auto toJSON(const std::string &name) const{
+            std::string s = "{\"name\":\"" + name + "\",\"count\":" + std::to_string(count()) + ",\"min\":" + std::to_string(min());
+            for(const auto p : HISTOGRAM_PERCENTILES){
+                s += ",\"p" + toString(p) + "\":" + std::to_string(percentile(p));
+            }
+            s += ",\"max\":" + std::to_string(max()) + ",\"mean\":" + toString(mean()) + ",\"buckets\":[";
+            bool first = true;
+            for(size_t i = 0; i < HISTOGRAM_BUCKETS; ++i){
+                if(counts_[i]){
+                    s += (first ? "[" : ",[") + std::to_string(histogramBucketHighestValue(i)) + "," + std::to_string(counts_[i]) + "]";
+                    first = false;
+                }
+            }
+            return s + "]}";
+        }
+    };
+
+    // Fixed size, allocation free histogram of non-negative values, typically nanoseconds.
+    // One thread records; any other thread may take a snapshot() at the same time. Counters are relaxed atomics
+    // written with plain load + store, so record() is a handful of instructions and never waits.
+    class LatencyHistogram final{
+    private:
+        std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> counts_ = {};
+        std::atomic<uint64_t> sum_ = {0};
+        std::atomic<uint64_t> min_ = {std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> max_ = {0};
+
+        static auto increment(std::atomic<uint64_t> &counter, uint64_t n) noexcept{
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+    public:
+        LatencyHistogram() = default;
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram(LatencyHistogram&&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+
+        // Writer only. Negative values, e.g. from two clocks a few ticks apart, are counted as 0.
+        auto record(int64_t value) noexcept{
+            const auto v = static_cast<uint64_t>(std::max<int64_t>(value, 0));
+            increment(counts_[histogramBucketIndex(v)], 1);
+            increment(sum_, v);
+            if(UNLIKELY(v < min_.load(std::memory_order_relaxed))){
+                min_.store(v, std::memory_order_relaxed);
+            }
+            if(UNLIKELY(v > max_.load(std::memory_order_relaxed))){
+                max_.store(v, std::memory_order_relaxed);
+            }
+        }
+
+        // Any thread. The count is summed from the buckets so percentiles stay consistent with it while the writer runs.
+        auto snapshot() const noexcept{
+            HistogramSnapshot snapshot;
+            for(size_t i = 0; i < HISTOGRAM_BUCKETS; ++i){
+                snapshot.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+                snapshot.count_ += snapshot.counts_[i];
+            }
+            snapshot.sum_ = sum_.load(std::memory_order_relaxed);
+            snapshot.min_ = min_.load(std::memory_order_relaxed);
+            snapshot.max_ = max_.load(std::memory_order_relaxed);
+            return snapshot;
+        }
+
+        auto toString() const{
+            return snapshot().toString();
+        }
+    };
+}
+
+#endif
@@ -4,19 +4,100 @@
 #include <iostream>
 #include <vector>
 #include <atomic>
+#include <algorithm>
+#include <bit>
+#include <span>
 #include "macros.h"
 
 namespace thu{
-    template<typename T>
+    // What the producer does when getNextToWriteTo() finds the ring full
+    enum class OverflowPolicy : int8_t{
+        SPIN = 0,        // wait for the consumer to free a slot
+        DROP_NEWEST = 1, // discard the element being written
+        DROP_OLDEST = 2, // reclaim the oldest unread slot, consumer must use tryPop()
+        FAIL_FAST = 3    // FATAL
+    };
+
+    inline auto overflowPolicyToString(OverflowPolicy policy) -> std::string{
+        switch (policy)
+        {
+        case OverflowPolicy::SPIN:
+            return "SPIN";
+        case OverflowPolicy::DROP_NEWEST:
+            return "DROP_NEWEST";
+        case OverflowPolicy::DROP_OLDEST:
+            return "DROP_OLDEST";
+        case OverflowPolicy::FAIL_FAST:
+            return "FAIL_FAST";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    // Single-producer / single-consumer ring buffer.
+    // Cursors only ever increase and are masked into a power-of-two store, so there is no '%' and no shared counter.
+    // Each side keeps a private copy of the other side's cursor and only reloads the shared one
+    // when that copy says the ring looks full (producer) or empty (consumer).
+    // overflows() and highWaterMark() can be read from any thread.
+    template<typename T, OverflowPolicy Policy = OverflowPolicy::SPIN>
     class LFQueue final{
     private:
         std::vector<T> store_;
-        std::atomic<size_t> next_write_index_ = {0};
-        std::atomic<size_t> next_read_index_ = {0};
-        std::atomic<size_t> num_elements_ = {0};
+        const size_t mask_;
+
+        // written by the producer, read by the consumer
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> next_write_index_ = {0};
+        std::atomic<size_t> overflows_ = {0};
+        // producer only
+        alignas(CACHE_LINE_SIZE) size_t cached_read_index_ = 0;
+        bool drop_pending_ = false;
+        T overflow_slot_ = T(); // DROP_NEWEST writes land here when the ring is full
+
+        // written by the consumer, read by the producer
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> next_read_index_ = {0};
+        std::atomic<size_t> high_water_mark_ = {0};
+        // consumer only
+        alignas(CACHE_LINE_SIZE) size_t cached_write_index_ = 0;
+
+        static_assert(std::atomic<size_t>::is_always_lock_free);
+
+        // Consumer: reload the producer cursor and sample the backlog seen at that moment
+        auto refreshWriteIndex(size_t read_index) noexcept{
+            cached_write_index_ = next_write_index_.load(std::memory_order_acquire);
+            const auto depth = cached_write_index_ - read_index;
+            if(UNLIKELY(depth > high_water_mark_.load(std::memory_order_relaxed))){
+                high_water_mark_.store(depth, std::memory_order_relaxed);
+            }
+        }
+
+        auto onFull(size_t write_index) noexcept -> T*{
+            overflows_.store(overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if constexpr (Policy == OverflowPolicy::SPIN){
+                while(write_index - cached_read_index_ >= capacity()){
+                    cached_read_index_ = next_read_index_.load(std::memory_order_acquire);
+                }
+            }
+            else if constexpr (Policy == OverflowPolicy::DROP_NEWEST){
+                drop_pending_ = true;
+                return &overflow_slot_;
+            }
+            else if constexpr (Policy == OverflowPolicy::DROP_OLDEST){
+                // On failure the consumer moved on by itself and cached_read_index_ picks up its cursor.
+                auto expected = cached_read_index_;
+                if(next_read_index_.compare_exchange_strong(expected, expected + 1, std::memory_order_acq_rel, std::memory_order_acquire)){
+                    ++expected;
+                }
+                cached_read_index_ = expected;
+            }
+            else{
+                FATAL("LFQueue full, capacity:" + std::to_string(capacity()));
+            }
+            return &store_[write_index & mask_];
+        }
 
     public:
-        LFQueue(std::size_t num_elems) : store_(num_elems, T())
+        // capacity is rounded up to the next power of two
+        LFQueue(std::size_t num_elems) : store_(std::bit_ceil(num_elems), T()), mask_(store_.size() - 1)
         {}
         LFQueue() = delete;
         LFQueue(const LFQueue&) = delete;
@@ -24,29 +105,137 @@ namespace thu{
         LFQueue& operator=(const LFQueue&) = delete;
         LFQueue& operator=(LFQueue&&) = delete;
 
-        auto getNextToWriteTo() noexcept{
-            return &store_[next_write_index_];
+        // Producer: single element, applies Policy when the ring is full
+        auto getNextToWriteTo() noexcept -> T*{
+            const auto write_index = next_write_index_.load(std::memory_order_relaxed);
+            if(UNLIKELY(write_index - cached_read_index_ >= capacity())){
+                cached_read_index_ = next_read_index_.load(std::memory_order_acquire);
+                if(write_index - cached_read_index_ >= capacity()){
+                    return onFull(write_index);
+                }
+            }
+            return &store_[write_index & mask_];
         }
 
         auto updateWriteIndex() noexcept{
-            next_write_index_ = (next_write_index_ + 1) % store_.size();
-            num_elements_++;
+            if constexpr (Policy == OverflowPolicy::DROP_NEWEST){
+                if(UNLIKELY(drop_pending_)){
+                    drop_pending_ = false;
+                    return;
+                }
+            }
+            next_write_index_.store(next_write_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Producer: batch
+        // Reserve up to n contiguous slots. Fewer are returned at the wrap point or when the consumer lags behind,
+        // never blocks and never drops regardless of Policy.
+        auto tryReserve(size_t n) noexcept -> std::span<T>{
+            const auto write_index = next_write_index_.load(std::memory_order_relaxed);
+            if(write_index - cached_read_index_ + n > capacity()){
+                cached_read_index_ = next_read_index_.load(std::memory_order_acquire);
+            }
+            const auto free_slots = capacity() - (write_index - cached_read_index_);
+            const auto offset = write_index & mask_;
+            return {store_.data() + offset, std::min({n, free_slots, capacity() - offset})};
+        }
+
+        // Publish n slots previously handed out by tryReserve()
+        auto commit(size_t n) noexcept{
+            next_write_index_.store(next_write_index_.load(std::memory_order_relaxed) + n, std::memory_order_release);
         }
 
-        auto getNextToRead() const noexcept -> const T*{
-            return (next_read_index_ == next_write_index_) ? nullptr : &store_[next_read_index_];
+        // Consumer: single element, in place
+        // Not available with DROP_OLDEST since the producer may reclaim the slot while it is being read.
+        auto getNextToRead() noexcept -> const T* requires (Policy != OverflowPolicy::DROP_OLDEST){
+            const auto read_index = next_read_index_.load(std::memory_order_relaxed);
+            if(read_index == cached_write_index_){
+                refreshWriteIndex(read_index);
+                if(read_index == cached_write_index_){
+                    return nullptr;
+                }
+            }
+            return &store_[read_index & mask_];
         }
 
-        auto updateReadIndex() noexcept{
-            next_read_index_ = (next_read_index_ + 1) % store_.size();
-            ASSERT(num_elements_ != 0, "Read an invalid element in: " + std::to_string(pthread_self()));
-            num_elements_--;
+        auto updateReadIndex() noexcept requires (Policy != OverflowPolicy::DROP_OLDEST){
+            const auto read_index = next_read_index_.load(std::memory_order_relaxed);
+            if(UNLIKELY(read_index == cached_write_index_)){
+                FATAL("Read an invalid element in: " + std::to_string(pthread_self()));
+            }
+            next_read_index_.store(read_index + 1, std::memory_order_release);
         }
 
+        // Consumer: single element, copied out. Works with every Policy.
+        // With DROP_OLDEST the cursor is advanced by CAS; failing it means the producer reclaimed the slot
+        // mid-copy, so the copy is discarded and the next oldest element is tried.
+        auto tryPop(T &out) noexcept -> bool{
+            auto read_index = next_read_index_.load(Policy == OverflowPolicy::DROP_OLDEST ? std::memory_order_acquire : std::memory_order_relaxed);
+            while(true){
+                if(read_index >= cached_write_index_){
+                    refreshWriteIndex(read_index);
+                    if(read_index >= cached_write_index_){
+                        return false;
+                    }
+                }
+                out = store_[read_index & mask_];
+                if constexpr (Policy == OverflowPolicy::DROP_OLDEST){
+                    if(next_read_index_.compare_exchange_strong(read_index, read_index + 1, std::memory_order_acq_rel, std::memory_order_acquire)){
+                        return true;
+                    }
+                }
+                else{
+                    next_read_index_.store(read_index + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+
+        // Consumer: batch
+        // Look at up to n contiguous readable elements without consuming them.
+        auto peek(size_t n) noexcept -> std::span<const T> requires (Policy != OverflowPolicy::DROP_OLDEST){
+            const auto read_index = next_read_index_.load(std::memory_order_relaxed);
+            if(cached_write_index_ - read_index < n){
+                refreshWriteIndex(read_index);
+            }
+            const auto available = cached_write_index_ - read_index;
+            const auto offset = read_index & mask_;
+            return {store_.data() + offset, std::min({n, available, capacity() - offset})};
+        }
+
+        // Hand n elements previously returned by peek() back to the producer
+        auto release(size_t n) noexcept requires (Policy != OverflowPolicy::DROP_OLDEST){
+            const auto read_index = next_read_index_.load(std::memory_order_relaxed);
+            if(UNLIKELY(read_index + n > cached_write_index_)){
+                FATAL("Released more elements than were peeked in: " + std::to_string(pthread_self()));
+            }
+            next_read_index_.store(read_index + n, std::memory_order_release);
+        }
+
+        // Safe from any thread; touches both cursors so keep it off the hot path.
         auto size() const noexcept{
-            return num_elements_.load();
+            const auto read_index = next_read_index_.load(std::memory_order_acquire);
+            return next_write_index_.load(std::memory_order_acquire) - read_index;
+        }
+
+        auto capacity() const noexcept{
+            return store_.size();
+        }
+
+        // Number of writes that found the ring full: waits for SPIN, discarded elements for the DROP policies.
+        auto overflows() const noexcept{
+            return overflows_.load(std::memory_order_relaxed);
+        }
+
+        // Deepest backlog the consumer has observed when it went back to the producer cursor.
+        auto highWaterMark() const noexcept{
+            return high_water_mark_.load(std::memory_order_relaxed);
+        }
+
+        static constexpr auto policy() noexcept{
+            return Policy;
         }
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,119 @@
+#ifndef LOG_SEGMENT_H
+#define LOG_SEGMENT_H
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "macros.h"
+
+namespace thu{
+    constexpr size_t LOG_SEGMENT_SIZE = 64 * 1024 * 1024;
+    constexpr size_t LOG_SEGMENT_ASYNC_FLUSH_BYTES = 1024 * 1024;
+    constexpr size_t LOG_SEGMENT_GROW_BYTES = 1024 * 1024;
+
+    // Append only log output into mmap'd files of up to LOG_SEGMENT_SIZE bytes.
+    // The first segment is file_name, the following ones file_name.1, file_name.2, ...
+    // Blocks for the whole segment are reserved up front without changing the file size, the size grows by
+    // LOG_SEGMENT_GROW_BYTES ahead of the writes so tail -f sees at most that much zero padding.
+    // A full segment is truncated to what was written and unmapped before the next one is opened.
+    // Writes are memcpy's into the page cache, msync(MS_ASYNC) hands every LOG_SEGMENT_ASYNC_FLUSH_BYTES to the kernel.
+    class LogSegmentWriter final{
+    private:
+        const std::string file_name_;
+        size_t segment_index_ = 0;
+        int fd_ = -1;
+        char *data_ = nullptr;
+        size_t size_ = 0;
+        size_t file_size_ = 0;
+        size_t synced_size_ = 0;
+
+        auto segmentName() const{
+            return segment_index_ ? file_name_ + "." + std::to_string(segment_index_) : file_name_;
+        }
+
+        auto open() noexcept{
+            const auto name = segmentName();
+            fd_ = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            ASSERT(fd_ >= 0, "Could not open log file: " + name + " error:" + std::string(strerror(errno)));
+            // only a hint, file systems without FALLOC_FL_KEEP_SIZE allocate as the file grows
+            fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, LOG_SEGMENT_SIZE);
+            data_ = static_cast<char*>(mmap(nullptr, LOG_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+            ASSERT(data_ != MAP_FAILED, "Could not mmap log file: " + name + " error:" + std::string(strerror(errno)));
+            madvise(data_, LOG_SEGMENT_SIZE, MADV_SEQUENTIAL);
+            size_ = 0;
+            file_size_ = 0;
+            synced_size_ = 0;
+        }
+
+        // Pages of the mapping past the end of the file must not be touched, extend it before writing to them.
+        auto grow(size_t end) noexcept{
+            const auto file_size = std::min((end + LOG_SEGMENT_GROW_BYTES - 1) / LOG_SEGMENT_GROW_BYTES * LOG_SEGMENT_GROW_BYTES, LOG_SEGMENT_SIZE);
+            ASSERT(ftruncate(fd_, file_size) == 0, "Could not extend log file: " + segmentName() + " error:" + std::string(strerror(errno)));
+            file_size_ = file_size;
+        }
+
+        // Drop the unused preallocated tail so readers only see what was logged.
+        auto close() noexcept{
+            if(fd_ < 0){
+                return;
+            }
+            munmap(data_, LOG_SEGMENT_SIZE);
+            if(ftruncate(fd_, size_) != 0){
+                std::cerr << "Could not truncate log file: " << segmentName() << std::endl;
+            }
+            ::close(fd_);
+            fd_ = -1;
+            data_ = nullptr;
+        }
+
+    public:
+        explicit LogSegmentWriter(const std::string &file_name) : file_name_(file_name){
+            open();
+        }
+
+        ~LogSegmentWriter(){
+            close();
+        }
+
+        LogSegmentWriter() = delete;
+        LogSegmentWriter(const LogSegmentWriter&) = delete;
+        LogSegmentWriter(LogSegmentWriter&&) = delete;
+        LogSegmentWriter& operator=(const LogSegmentWriter&) = delete;
+        LogSegmentWriter& operator=(LogSegmentWriter&&) = delete;
+
+        // Writes larger than a segment are split across segments.
+        auto write(const char *data, size_t len) noexcept{
+            while(len){
+                if(UNLIKELY(size_ == LOG_SEGMENT_SIZE)){
+                    close();
+                    ++segment_index_;
+                    open();
+                }
+                const auto n = std::min(len, LOG_SEGMENT_SIZE - size_);
+                if(UNLIKELY(size_ + n > file_size_)){
+                    grow(size_ + n);
+                }
+                memcpy(data_ + size_, data, n);
+                size_ += n;
+                data += n;
+                len -= n;
+            }
+        }
+
+        // Called after every batch, only starts writeback once enough has accumulated.
+        auto flush() noexcept{
+            if(size_ - synced_size_ >= LOG_SEGMENT_ASYNC_FLUSH_BYTES){
+                const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                const auto begin = synced_size_ / page_size * page_size;
+                msync(data_ + begin, size_ - begin, MS_ASYNC);
+                synced_size_ = size_;
+            }
+        }
+    };
+}
+
+#endif
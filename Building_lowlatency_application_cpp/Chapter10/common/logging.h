@@ -1,183 +1,382 @@
 #ifndef LOGGING_H
 #define LOGGING_H
 #include <string>
-#include <fstream>
+#include <string_view>
 #include <cstdio>
+#include <charconv>
+#include <concepts>
+#include <type_traits>
 #include "macros.h"
-#include "lockfree_queue.h"
+#include "mirrored_buffer.h"
+#include "log_segment.h"
 #include "thread_utils.h"
 #include "time_utils.h"
 #include "types.h"
 namespace thu{
-// constexpr size_t LOG_QUEUE_SIZE = 8*1024*1024;
-enum class LogType : int8_t {
-    CHAR = 0,
-    INTEGER = 1,
-    LONG_INTEGER = 2,
-    LONG_LONG_INTEGER = 3,
-    UNSIGNED_INTEGER = 4,
-    UNSIGNED_LONG_INTEGER = 5,
-    UNSIGNED_LONG_LONG_INTEGER = 6,
-    FLOAT = 7,
-    DOUBLE = 8
+// Build time threshold, LOG_* statements below it are compiled out together with their arguments.
+// 0 keeps everything, 2 keeps WARN and above, set with -DTHU_LOG_LEVEL=<n> (cmake -DTHU_LOG_LEVEL=<n>).
+#ifndef THU_LOG_LEVEL
+#define THU_LOG_LEVEL 0
+#endif
+
+enum class LogLevel : int {
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3,
+    AUDIT = 4,
+    MAX = 5
 };
 
-struct LogElement {
-    LogType type_ = LogType::CHAR;
-    union{
-        char c;
-        int i;
-        long l;
-        long long ll;
-        unsigned u;
-        unsigned long ul;
-        unsigned long long ull;
-        float f;
-        double d;
-    } u_;
+// Every class that logs declares static constexpr LogComponent LOG_COMPONENT, free functions a file scope one.
+enum class LogComponent : uint8_t {
+    MAIN = 0,
+    SOCKET = 1,
+    ORDER_SERVER = 2,
+    MATCHER = 3,
+    MD_PUBLISHER = 4,
+    MD_CONSUMER = 5,
+    ORDER_GATEWAY = 6,
+    TRADE_ENGINE = 7,
+    STRATEGY = 8,
+    MAX = 9
 };
 
-class Logger final{
-private:
-    const std::string file_name_;
-    std::ofstream file_;
-    LFQueue<LogElement> queue_;
-    std::atomic<bool> running_ = true;
-    std::thread *logger_thread_ = nullptr;
-public:
-    auto flushQueue() noexcept{
-        while(running_){
-            for(auto next = queue_.getNextToRead(); queue_.size() && next; next=queue_.getNextToRead()){
-                switch (next->type_)
-                {
-                case LogType::CHAR: file_ << next->u_.c; break;
-                case LogType::INTEGER: file_ << next->u_.i; break;
-                case LogType::LONG_INTEGER: file_ << next->u_.l; break;
-                case LogType::LONG_LONG_INTEGER: file_ << next->u_.ll; break;
-                case LogType::UNSIGNED_INTEGER: file_ << next->u_.u; break;
-                case LogType::UNSIGNED_LONG_INTEGER: file_ << next->u_.ul; break;
-                case LogType::UNSIGNED_LONG_LONG_INTEGER: file_ << next->u_.ull; break;
-                case LogType::FLOAT: file_ << next->u_.f; break;
-                case LogType::DOUBLE: file_ << next->u_.d; break;
-                default:
-                    break;
-                }
-                queue_.updateReadIndex();
-            }
-            file_.flush();
-            using namespace std::literals::chrono_literals;
-            std::this_thread::sleep_for(1ms);
-        }
+inline auto logLevelToString(LogLevel level) -> std::string{
+    switch (level)
+    {
+    case LogLevel::DEBUG: return "DEBUG";
+    case LogLevel::INFO: return "INFO";
+    case LogLevel::WARN: return "WARN";
+    case LogLevel::ERROR: return "ERROR";
+    case LogLevel::AUDIT: return "AUDIT";
+    default: return "UNKNOWN";
     }
+}
 
-    explicit Logger(const std::string &file_name) : file_name_(file_name), queue_(LOG_QUEUE_SIZE){
-        file_.open(file_name);
-        ASSERT(file_.is_open(), "Could not open log file: " + file_name);
-        logger_thread_ = createAndStartThread(-1, "Common/Logger "+ file_name_, [this](){flushQueue();});
-        ASSERT(logger_thread_ != nullptr, "Failed to start Logger thread.");
+inline auto logComponentToString(LogComponent component) -> std::string{
+    switch (component)
+    {
+    case LogComponent::MAIN: return "MAIN";
+    case LogComponent::SOCKET: return "SOCKET";
+    case LogComponent::ORDER_SERVER: return "ORDER_SERVER";
+    case LogComponent::MATCHER: return "MATCHER";
+    case LogComponent::MD_PUBLISHER: return "MD_PUBLISHER";
+    case LogComponent::MD_CONSUMER: return "MD_CONSUMER";
+    case LogComponent::ORDER_GATEWAY: return "ORDER_GATEWAY";
+    case LogComponent::TRADE_ENGINE: return "TRADE_ENGINE";
+    case LogComponent::STRATEGY: return "STRATEGY";
+    default: return "UNKNOWN";
     }
+}
 
-    ~Logger(){
-        std::cerr << "Flushing and closing Logger for " << file_name_ << std::endl;
-        while(queue_.size()){
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
-        running_ = false;
-        logger_thread_->join();
-        file_.close();
-    }
+// Runtime switches for all components in one word: bit (level * LOG_MASK_STRIDE + component).
+constexpr size_t LOG_MASK_STRIDE = 12;
+static_assert(static_cast<size_t>(LogComponent::MAX) <= LOG_MASK_STRIDE && static_cast<size_t>(LogLevel::MAX) * LOG_MASK_STRIDE <= 64);
+alignas(CACHE_LINE_SIZE) inline std::atomic<uint64_t> log_mask = {~0ull};
 
-    Logger() = delete;
-    Logger(const Logger&) = delete;
-    Logger(Logger&&) = delete;
-    Logger& operator=(const Logger&) = delete;
-    Logger& operator=(Logger&&) = delete;
+constexpr auto logMaskBit(LogLevel level, LogComponent component) noexcept -> uint64_t{
+    return 1ull << (static_cast<size_t>(level) * LOG_MASK_STRIDE + static_cast<size_t>(component));
+}
 
-    // Adding pushing data to the logger queue
-    auto pushValue(const LogElement& log_element) noexcept{
-        *(queue_.getNextToWriteTo()) = log_element;
-        queue_.updateWriteIndex();
-    }
-    auto pushValue(const char value) noexcept {
-      pushValue(LogElement{LogType::CHAR, {.c = value}});
-    }
+constexpr auto logCompiledIn(LogLevel level) noexcept{
+    return static_cast<int>(level) >= THU_LOG_LEVEL;
+}
 
-    auto pushValue(const int value) noexcept {
-      pushValue(LogElement{LogType::INTEGER, {.i = value}});
-    }
+inline auto logEnabled(LogLevel level, LogComponent component) noexcept{
+    return (log_mask.load(std::memory_order_relaxed) & logMaskBit(level, component)) != 0;
+}
 
-    auto pushValue(const long value) noexcept {
-      pushValue(LogElement{LogType::LONG_INTEGER, {.l = value}});
+// Enable min_level and everything above it for component, disable the levels below.
+inline auto setLogLevel(LogComponent component, LogLevel min_level) noexcept{
+    auto mask = log_mask.load(std::memory_order_relaxed);
+    for(auto level = 0; level < static_cast<int>(LogLevel::MAX); ++level){
+        const auto bit = logMaskBit(static_cast<LogLevel>(level), component);
+        mask = (level >= static_cast<int>(min_level)) ? (mask | bit) : (mask & ~bit);
     }
+    log_mask.store(mask, std::memory_order_relaxed);
+}
 
-    auto pushValue(const long long value) noexcept {
-      pushValue(LogElement{LogType::LONG_LONG_INTEGER, {.ll = value}});
+// Applies a spec like "WARN,MATCHER=DEBUG,SOCKET=ERROR": a bare level applies to every component.
+// Unknown names are reported and skipped. Typically fed from the THU_LOG_LEVELS environment variable.
+inline auto setLogLevels(const char *spec) -> void{
+    if(!spec){
+        return;
     }
+    const auto toLevel = [](const std::string &name){
+        for(auto level = 0; level < static_cast<int>(LogLevel::MAX); ++level){
+            if(logLevelToString(static_cast<LogLevel>(level)) == name){
+                return static_cast<LogLevel>(level);
+            }
+        }
+        return LogLevel::MAX;
+    };
+    std::string_view rest(spec);
+    while(!rest.empty()){
+        const auto comma = rest.find(',');
+        const std::string item(rest.substr(0, comma));
+        rest = (comma == std::string_view::npos) ? std::string_view() : rest.substr(comma + 1);
 
-    auto pushValue(const unsigned value) noexcept {
-      pushValue(LogElement{LogType::UNSIGNED_INTEGER, {.u = value}});
+        const auto equals = item.find('=');
+        const auto level = toLevel(equals == std::string::npos ? item : item.substr(equals + 1));
+        if(level == LogLevel::MAX){
+            std::cerr << "Ignoring unknown log level in:" << item << std::endl;
+            continue;
+        }
+        bool found = false;
+        for(auto component = 0; component < static_cast<int>(LogComponent::MAX); ++component){
+            if(equals == std::string::npos || logComponentToString(static_cast<LogComponent>(component)) == item.substr(0, equals)){
+                setLogLevel(static_cast<LogComponent>(component), level);
+                found = true;
+            }
+        }
+        if(!found){
+            std::cerr << "Ignoring unknown log component in:" << item << std::endl;
+        }
     }
+}
 
-    auto pushValue(const unsigned long value) noexcept {
-      pushValue(LogElement{LogType::UNSIGNED_LONG_INTEGER, {.ul = value}});
-    }
+// Every log() call appends one variable length binary record: LogRecordHeader followed by the raw bytes of its arguments.
+// The format string is not copied, its address is the id of the call site, and decoder_ is generated for the exact
+// argument types of the call so the logger thread can format the record later. Format strings must be string literals.
+typedef void (*LogDecoder)(const char *fmt, const char *args, std::string &out);
 
-    auto pushValue(const unsigned long long value) noexcept {
-      pushValue(LogElement{LogType::UNSIGNED_LONG_LONG_INTEGER, {.ull = value}});
-    }
+struct LogRecordHeader{
+    uint32_t size_ = 0; // header, arguments and padding to the next record
+    LogDecoder decoder_ = nullptr;
+    const char *fmt_ = nullptr;
+    Nanos time_ = 0;
+};
 
-    auto pushValue(const float value) noexcept {
-      pushValue(LogElement{LogType::FLOAT, {.f = value}});
-    }
+// Flat structs with a toString(), e.g. MEClientRequest, are copied as is and only stringified on the logger thread.
+template<typename T>
+concept LogStruct = std::is_class_v<T> && std::is_trivially_copyable_v<T> && requires(const T &t){
+    { t.toString() } -> std::convertible_to<std::string>;
+};
 
-    auto pushValue(const double value) noexcept {
-      pushValue(LogElement{LogType::DOUBLE, {.d = value}});
+// size(), encode() and decode() of a single argument, encode() and decode() return the position after the argument.
+template<typename T>
+struct LogCodec{
+    static_assert(sizeof(T) == 0, "Type cannot be logged, pass a string instead.");
+};
+
+template<typename T>
+requires std::is_arithmetic_v<T>
+struct LogCodec<T>{
+    static constexpr auto size(T) noexcept -> size_t{
+        return sizeof(T);
+    }
+    static auto encode(char *p, T value) noexcept{
+        memcpy(p, &value, sizeof(T));
+        return p + sizeof(T);
     }
+    static auto decode(const char *p, std::string &out){
+        T value;
+        memcpy(&value, p, sizeof(T));
+        if constexpr (std::is_same_v<T, char>){
+            out += value;
+        }
+        else{
+            char buf[64];
+            if constexpr (std::is_floating_point_v<T>){
+                out.append(buf, std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6).ptr);
+            }
+            else if constexpr (std::is_same_v<T, bool>){
+                out += (value ? '1' : '0');
+            }
+            else{
+                out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+            }
+        }
+        return p + sizeof(T);
+    }
+};
 
-    auto pushValue(const char *value) noexcept {
-      while (*value) {
-        pushValue(*value);
-        ++value;
-      }
+template<>
+struct LogCodec<std::string_view>{
+    static auto size(std::string_view value) noexcept -> size_t{
+        return sizeof(uint32_t) + value.size();
     }
+    static auto encode(char *p, std::string_view value) noexcept{
+        const auto len = static_cast<uint32_t>(value.size());
+        memcpy(p, &len, sizeof(len));
+        memcpy(p + sizeof(len), value.data(), len);
+        return p + sizeof(len) + len;
+    }
+    static auto decode(const char *p, std::string &out){
+        uint32_t len;
+        memcpy(&len, p, sizeof(len));
+        out.append(p + sizeof(len), len);
+        return p + sizeof(len) + len;
+    }
+};
+template<> struct LogCodec<const char*> : LogCodec<std::string_view>{};
+template<> struct LogCodec<char*> : LogCodec<std::string_view>{};
+template<> struct LogCodec<std::string> : LogCodec<std::string_view>{};
 
-    auto pushValue(const std::string &value) noexcept {
-      pushValue(value.c_str());
+template<LogStruct T>
+struct LogCodec<T>{
+    static constexpr auto size(const T&) noexcept -> size_t{
+        return sizeof(T);
+    }
+    static auto encode(char *p, const T &value) noexcept{
+        memcpy(p, &value, sizeof(T));
+        return p + sizeof(T);
     }
+    static auto decode(const char *p, std::string &out){
+        alignas(T) char value[sizeof(T)];
+        memcpy(value, p, sizeof(T));
+        out += reinterpret_cast<const T*>(value)->toString();
+        return p + sizeof(T);
+    }
+};
 
-    // Adding a useful and generic log function
-    template<typename T, typename... A>
-    auto log(const char* s, const T& value, A... args) noexcept{
-        while(*s){
-            if(*s == '%'){
-                if(UNLIKELY(*(s+1) == '%')){
-                    ++s;
+// Logger thread side: '%' is replaced by the next argument, '%%' prints '%'.
+template<typename... A>
+auto formatLogRecord(const char *s, const char *args, std::string &out) -> void{
+    while(*s){
+        if(*s == '%'){
+            if(UNLIKELY(*(s+1) == '%')){
+                ++s;
+            }
+            else{
+                if constexpr (sizeof...(A) == 0){
+                    FATAL("missing arguments to log()");
                 }
                 else{
-                    pushValue(value);
-                    log(s+1, args...);
+                    [&]<typename T, typename... Rest>(){
+                        args = LogCodec<T>::decode(args, out);
+                        formatLogRecord<Rest...>(s + 1, args, out);
+                    }.template operator()<A...>();
                     return;
                 }
             }
-            pushValue(*s++);
         }
+        out += *s++;
+    }
+    if constexpr (sizeof...(A) != 0){
         FATAL("extra arguments provided to log()");
     }
+}
 
-    auto log(const char *s) noexcept{
-        while(*s){
-            if(*s == '%'){
-                if(UNLIKELY(*(s+1) == '%')){
-                    ++s;
-                }
-                else{
-                    FATAL("missing arguments to log()");
-                }
+// Compile time side of the same rule, LOG_AT checks every call site with these.
+consteval auto logPlaceholders(std::string_view fmt) -> size_t{
+    size_t count = 0;
+    for(size_t i = 0; i < fmt.size(); ++i){
+        if(fmt[i] == '%'){
+            if(i + 1 < fmt.size() && fmt[i + 1] == '%'){
+                ++i;
+            }
+            else{
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+template<typename... A>
+auto logArgCount(const A&...) -> std::integral_constant<size_t, sizeof...(A)>; // only used in decltype
+
+class Logger final{
+private:
+    const std::string file_name_;
+    LogSegmentWriter segment_;
+    // never stall the hot path on logging: when the logger thread falls behind new records are dropped and counted
+    MirroredRing ring_;
+    std::atomic<size_t> dropped_ = {0};
+    std::atomic<bool> running_ = true;
+    std::thread *logger_thread_ = nullptr;
+    std::string batch_;
+
+    // Decodes everything published so far into one batch and appends it to the segment in a single copy.
+    auto drainRing() noexcept{
+        const auto available = ring_.readable();
+        if(!available){
+            return false;
+        }
+        batch_.clear();
+        for(auto record = ring_.readPtr(), end = record + available; record < end;){
+            const auto header = reinterpret_cast<const LogRecordHeader*>(record);
+            header->decoder_(header->fmt_, record + sizeof(LogRecordHeader), batch_);
+            record += header->size_;
+        }
+        ring_.release(available);
+        segment_.write(batch_.data(), batch_.size());
+        segment_.flush();
+        return true;
+    }
+
+public:
+    // Only sleeps when the ring was found empty, so a burst is written back to back.
+    // running_ is read before draining: whatever was logged before the destructor ran is on disk when the loop exits.
+    auto flushQueue() noexcept{
+        for(auto running = true; running;){
+            running = running_.load(std::memory_order_acquire);
+            if(!drainRing() && running){
+                using namespace std::literals::chrono_literals;
+                std::this_thread::sleep_for(1ms);
             }
-            pushValue(*s++);
         }
     }
+
+    explicit Logger(const std::string &file_name) : file_name_(file_name), segment_(file_name), ring_(LOG_QUEUE_SIZE){
+        batch_.reserve(LOG_SEGMENT_ASYNC_FLUSH_BYTES);
+        logger_thread_ = createAndStartThread(-1, "Common/Logger "+ file_name_, [this](){flushQueue();});
+        ASSERT(logger_thread_ != nullptr, "Failed to start Logger thread.");
+    }
+
+    ~Logger(){
+        std::cerr << "Flushing and closing Logger for " << file_name_ << std::endl;
+        running_.store(false, std::memory_order_release);
+        logger_thread_->join();
+        if(dropped_){
+            std::cerr << "Logger for " << file_name_ << " dropped " << dropped_ << " records." << std::endl;
+        }
+    }
+
+    Logger() = delete;
+    Logger(const Logger&) = delete;
+    Logger(Logger&&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    Logger& operator=(Logger&&) = delete;
+
+    // Copies the arguments into one record, all formatting happens on the logger thread.
+    template<typename... A>
+    auto log(const char *fmt, const A&... args) noexcept{
+        const size_t size = (sizeof(LogRecordHeader) + ... + LogCodec<std::decay_t<A>>::size(args));
+        const auto padded_size = (size + alignof(LogRecordHeader) - 1) & ~(alignof(LogRecordHeader) - 1);
+        auto record = ring_.tryReserve(padded_size);
+        if(UNLIKELY(!record)){
+            dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        new(record) LogRecordHeader{static_cast<uint32_t>(padded_size), &formatLogRecord<std::decay_t<A>...>, fmt, getCurrentNanos()};
+        auto p = record + sizeof(LogRecordHeader);
+        ((p = LogCodec<std::decay_t<A>>::encode(p, args)), ...);
+        ring_.commit(padded_size);
+    }
 };
 
 }
+
+// Arguments are only evaluated when the statement is both compiled in and switched on for LOG_COMPONENT,
+// the number of '%' placeholders is checked against them in every build.
+#define LOG_AT(level, logger, fmt, ...)                                                 \
+    do{                                                                                 \
+        static_assert(thu::logPlaceholders(fmt) ==                                      \
+                      decltype(thu::logArgCount(__VA_ARGS__))::value,                   \
+                      "log() placeholders and arguments differ");                       \
+        if constexpr (thu::logCompiledIn(level)){                                       \
+            if(thu::logEnabled(level, LOG_COMPONENT)){                                  \
+                (logger).log(fmt __VA_OPT__(,) __VA_ARGS__);                            \
+            }                                                                           \
+        }                                                                               \
+    }while(false)
+
+#define LOG_DEBUG(logger, fmt, ...) LOG_AT(thu::LogLevel::DEBUG, logger, fmt __VA_OPT__(,) __VA_ARGS__)
+#define LOG_INFO(logger, fmt, ...) LOG_AT(thu::LogLevel::INFO, logger, fmt __VA_OPT__(,) __VA_ARGS__)
+#define LOG_WARN(logger, fmt, ...) LOG_AT(thu::LogLevel::WARN, logger, fmt __VA_OPT__(,) __VA_ARGS__)
+#define LOG_ERROR(logger, fmt, ...) LOG_AT(thu::LogLevel::ERROR, logger, fmt __VA_OPT__(,) __VA_ARGS__)
+#define LOG_AUDIT(logger, fmt, ...) LOG_AT(thu::LogLevel::AUDIT, logger, fmt __VA_OPT__(,) __VA_ARGS__)
+
 #endif
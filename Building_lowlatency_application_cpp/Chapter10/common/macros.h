@@ -1,12 +1,16 @@
 #ifndef MACROS_H
 #define MACROS_H
 
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
 #define LIKELY(x) __builtin_expect(!!(x), 1)
 #define UNLIKELY(x) __builtin_expect(!!(x), 0)
 
+// x86-64 cache line, used to keep state written by different threads on separate lines
+constexpr size_t CACHE_LINE_SIZE = 64;
+
 inline auto ASSERT(bool cond, const std::string& msg) noexcept
 {
     if(UNLIKELY(!cond)){
@@ -21,4 +25,12 @@ inline auto FATAL(const std::string& msg) noexcept
     exit(EXIT_FAILURE);
 }
 
+namespace thu{
+    // true when the environment variable is set to anything other than "" or "0"
+    inline auto envFlag(const char *name) noexcept{
+        const auto value = getenv(name);
+        return value && *value && strcmp(value, "0") != 0;
+    }
+}
+
 #endif
\ No newline at end of file
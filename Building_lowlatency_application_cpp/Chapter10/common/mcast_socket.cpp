@@ -2,7 +2,8 @@
 namespace thu{
     auto McastSocket::init(const std::string &ip, const std::string &iface, int port, bool is_listening) -> int
     {
-        const SocketCfg socket_cfg{ip, iface, port, true, is_listening, false};
+        // subscribers get kernel receive timestamps for tick-to-trade measurements
+        const SocketCfg socket_cfg{ip, iface, port, true, is_listening, is_listening};
         socket_fd_ = createSocket(logger_, socket_cfg);
         return socket_fd_;
     }
@@ -21,17 +22,25 @@ namespace thu{
     auto McastSocket::sendAndRecv() noexcept-> bool
     {
         // read data and dispatch callbacks if data is available - non blocking
-        const ssize_t n_rcv = ::recv(socket_fd_, inbound_data_.data()+next_rcv_valid_index_, McastBufferSize-next_rcv_valid_index_, MSG_DONTWAIT);
+        RxTimestampControl ctrl;
+        iovec iov{inbound_data_.writePtr(), inbound_data_.writable()};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl.data();
+        msg.msg_controllen = ctrl.size();
+        const ssize_t n_rcv = ::recvmsg(socket_fd_, &msg, MSG_DONTWAIT);
         if(n_rcv > 0){
-            next_rcv_valid_index_ += n_rcv;
-            logger_.log("%:% %() % read socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket_fd_,
-                        next_rcv_valid_index_);
-            recv_callback_(this);
+            inbound_data_.commit(n_rcv);
+            const auto kernel_time = kernelRxTime(msg);
+            LOG_DEBUG(logger_, "%:% %() % read socket:% len:% ktime:%\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket_fd_,
+                        inbound_data_.readable(), kernel_time);
+            recv_callback_(this, kernel_time);
         }
         // publish market data in the send buffer to the multicast stream
         if(next_send_valid_index_ > 0){
             ssize_t n = ::send(socket_fd_, outbound_data_.data(), next_send_valid_index_, MSG_DONTWAIT | MSG_NOSIGNAL);
-            logger_.log("%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket_fd_, n);
+            LOG_DEBUG(logger_, "%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket_fd_, n);
         }
         next_send_valid_index_ = 0;
         return n_rcv > 0;
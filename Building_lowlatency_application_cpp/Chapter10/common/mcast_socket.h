@@ -2,12 +2,13 @@
 #include <functional>
 #include "socket_utils.h"
 #include "logging.h"
+#include "mirrored_buffer.h"
 namespace thu{
     constexpr size_t McastBufferSize = 64 * 1024 * 1024;
     struct McastSocket{
-        McastSocket(Logger &logger) : logger_(logger){
+        static constexpr auto LOG_COMPONENT = thu::LogComponent::SOCKET;
+        McastSocket(Logger &logger) : inbound_data_(McastBufferSize), logger_(logger){
             outbound_data_.resize(McastBufferSize);
-            inbound_data_.resize(McastBufferSize);
         }
 
         // initialize multicast socket to read from or publish to a stream
@@ -31,11 +32,10 @@ namespace thu{
         // send and receive buffers, typically only one or the other is needed, not both
         std::vector<char> outbound_data_;
         size_t next_send_valid_index_ = 0;
-        std::vector<char> inbound_data_;
-        size_t next_rcv_valid_index_ = 0;
+        MirroredBuffer inbound_data_;
 
-        // function wrapper for the method to call when data is read
-        std::function<void(McastSocket *)> recv_callback_ = nullptr;
+        // function wrapper for the method to call when data is read, rx_time is the kernel receive time of the datagram
+        std::function<void(McastSocket *, Nanos rx_time)> recv_callback_ = nullptr;
 
         std::string time_str_;
         Logger &logger_;
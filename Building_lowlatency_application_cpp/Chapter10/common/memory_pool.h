@@ -2,38 +2,97 @@
 #define MEMORY_POOL_H
 
 #include <cstdint>
-#include <vector>
+#include <cstddef>
 #include <string>
+#include <new>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "macros.h"
 
 namespace thu{
+    constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    // How the backing storage of a MemPool is obtained, can be combined with '|'
+    enum MemPoolFlags : uint8_t{
+        MEMPOOL_DEFAULT = 0,
+        MEMPOOL_HUGEPAGES = 1 << 0, // 2MB pages from the hugetlb pool, falls back to transparent huge pages
+        MEMPOOL_PREFAULT = 1 << 1,  // touch every page at construction so the first allocations do not page fault
+        MEMPOOL_MLOCK = 1 << 2      // keep the storage resident, only warns if RLIMIT_MEMLOCK is too small
+    };
+
+    constexpr auto operator|(MemPoolFlags lhs, MemPoolFlags rhs) noexcept{
+        return static_cast<MemPoolFlags>(static_cast<uint8_t>(lhs) | static_cast<uint8_t>(rhs));
+    }
+
+    // Anonymous mapping of at least bytes, rounded up to the page size in use. Returns the address and the mapped length.
+    inline auto mapPoolMemory(size_t bytes, MemPoolFlags flags) noexcept -> std::pair<void*, size_t>{
+        const size_t page_size = (flags & MEMPOOL_HUGEPAGES) ? HUGE_PAGE_SIZE : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t mapped_bytes = (bytes + page_size - 1) / page_size * page_size;
+
+        void *mem = MAP_FAILED;
+        if(flags & MEMPOOL_HUGEPAGES){
+            mem = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        if(mem == MAP_FAILED){
+            mem = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            ASSERT(mem != MAP_FAILED, "MemPool mmap of " + std::to_string(mapped_bytes) + " bytes failed: " + std::string(strerror(errno)));
+            if(flags & MEMPOOL_HUGEPAGES){
+                madvise(mem, mapped_bytes, MADV_HUGEPAGE);
+            }
+        }
+
+        if(flags & MEMPOOL_PREFAULT){
+            for(size_t offset = 0; offset < mapped_bytes; offset += page_size){
+                static_cast<volatile std::byte*>(mem)[offset] = std::byte{0};
+            }
+        }
+        if((flags & MEMPOOL_MLOCK) && mlock(mem, mapped_bytes) != 0){
+            std::cerr << "MemPool mlock of " << mapped_bytes << " bytes failed: " << strerror(errno) << std::endl;
+        }
+        return {mem, mapped_bytes};
+    }
+
+    // Fixed capacity object pool with O(1) allocate() and deallocate().
+    // Unused slots hold the next pointer of an intrusive free list, so there is no per object bookkeeping.
+    // Slots that were never handed out are taken from the end of a bump index, which keeps construction cheap.
     template<typename T>
     class MemPool final{
     private:
-        struct ObjectBlock{
-            T object_;
-            bool is_free_ = true;
+        union Slot{
+            Slot *next_free_;
+            alignas(T) std::byte storage_[sizeof(T)];
         };
-        std::vector<ObjectBlock> store_;
-        size_t next_free_index_ = 0;
-
-        auto updateNextFreeIndex()noexcept{
-            const auto initial_free_index = next_free_index_;
-            while(!store_[next_free_index_].is_free_){
-                ++next_free_index_;
-                if(UNLIKELY(next_free_index_ == store_.size())){
-                    // HW branch predictor should almost predict this to be false any ways
-                    next_free_index_ = 0;
-                }
-                if(UNLIKELY(initial_free_index == next_free_index_)){
-                    ASSERT(initial_free_index != next_free_index_, "Memory pool out of space.");
-                }
-            }
-        }
+
+        Slot *store_ = nullptr;
+        const size_t num_elems_;
+        size_t mapped_bytes_ = 0;
+
+        Slot *free_list_ = nullptr;
+        size_t next_unused_index_ = 0;
+
+        size_t size_ = 0;
+        size_t high_water_mark_ = 0;
+
+#ifndef NDEBUG
+        // one bit per slot, set while the slot is on the free list, to catch a double free at its call site
+        std::vector<bool> is_free_;
+#endif
 
     public:
-        explicit MemPool(std::size_t num_elems) : store_(num_elems, {T(), true}){
-            ASSERT(reinterpret_cast<const ObjectBlock *>(&store_[0].object_) == &(store_[0]), "T object should be first member of ObjectBlock.");
+        explicit MemPool(std::size_t num_elems, MemPoolFlags flags = MEMPOOL_PREFAULT) : num_elems_(num_elems){
+            ASSERT(num_elems_ > 0, "MemPool needs at least one element.");
+            const auto [mem, mapped_bytes] = mapPoolMemory(num_elems_ * sizeof(Slot), flags);
+            store_ = static_cast<Slot*>(mem);
+            mapped_bytes_ = mapped_bytes;
+#ifndef NDEBUG
+            is_free_.resize(num_elems_, false);
+#endif
+        }
+
+        ~MemPool(){
+            munmap(store_, mapped_bytes_);
         }
 
         MemPool() = delete;
@@ -45,20 +104,49 @@ namespace thu{
 
         template<typename... Args>
         T* allocate(Args... args) noexcept{
-            auto obj_block = &(store_[next_free_index_]);
-            ASSERT(obj_block->is_free_, "Expected free ObjectBlock at index: " + std::to_string(next_free_index_));
-            T *ret = &(obj_block->object_);
-            ret = new(ret) T(args...); // placement new
-            obj_block->is_free_ = false;
-            updateNextFreeIndex();
-            return ret;
+            Slot *slot = free_list_;
+            if(LIKELY(slot)){
+                free_list_ = slot->next_free_;
+            }
+            else{
+                ASSERT(next_unused_index_ < num_elems_, "Memory pool out of space.");
+                slot = &store_[next_unused_index_++];
+            }
+            if(++size_ > high_water_mark_){
+                high_water_mark_ = size_;
+            }
+#ifndef NDEBUG
+            is_free_[slot - store_] = false;
+#endif
+            return new(slot->storage_) T(args...); // placement new
         }
 
         auto deallocate(const T *elem) noexcept{
-            const auto elem_index = (reinterpret_cast<const ObjectBlock*>(elem)- &store_[0]);
-            ASSERT(elem_index >= 0 && static_cast<size_t>(elem_index) < store_.size(), "Element being deallocated does not belong to this Memory pool.");
-            ASSERT(!store_[elem_index].is_free_, "Expected ObjectBlock at index: " + std::to_string(elem_index));
-            store_[elem_index].is_free_ = true;
+            const auto offset = reinterpret_cast<uintptr_t>(elem) - reinterpret_cast<uintptr_t>(store_);
+            ASSERT(offset < next_unused_index_ * sizeof(Slot) && offset % sizeof(Slot) == 0, "Element being deallocated does not belong to this Memory pool.");
+            auto slot = reinterpret_cast<Slot*>(const_cast<T*>(elem));
+#ifndef NDEBUG
+            ASSERT(!is_free_[slot - store_], "Element being deallocated is already free.");
+            is_free_[slot - store_] = true;
+#endif
+            elem->~T();
+            slot->next_free_ = free_list_;
+            free_list_ = slot;
+            --size_;
+        }
+
+        // Number of objects currently allocated
+        auto size() const noexcept{
+            return size_;
+        }
+
+        auto capacity() const noexcept{
+            return num_elems_;
+        }
+
+        // Largest size() seen since construction
+        auto highWaterMark() const noexcept{
+            return high_water_mark_;
         }
     };
 
@@ -66,4 +154,4 @@ namespace thu{
 
 
 
-#endif
\ No newline at end of file
+#endif
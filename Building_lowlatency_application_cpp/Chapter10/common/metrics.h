@@ -0,0 +1,170 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "macros.h"
+
+namespace thu{
+    constexpr uint64_t METRICS_MAGIC = 0x5448554d45545231ULL;
+    constexpr uint32_t METRICS_VERSION = 1;
+    constexpr size_t METRICS_MAX = 255;
+    constexpr size_t METRIC_NAME_SIZE = 48;
+    constexpr auto METRICS_SHM_PREFIX = "/dev/shm/chapter10_";
+
+    enum class MetricType : uint8_t{
+        COUNTER = 0,    // only goes up, a reader derives rates from it
+        GAUGE = 1       // current level, e.g. a queue depth
+    };
+
+    // One cache line per metric so hot threads updating different metrics never share a line.
+    // Each metric has a single writer: updates are relaxed load + store, not read-modify-write.
+    struct alignas(CACHE_LINE_SIZE) Metric{
+        char name_[METRIC_NAME_SIZE] = {};
+        MetricType type_ = MetricType::COUNTER;
+        std::atomic<int64_t> value_ = {0};
+
+        auto add(int64_t n = 1) noexcept{
+            value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        auto set(int64_t v) noexcept{
+            value_.store(v, std::memory_order_relaxed);
+        }
+        auto value() const noexcept{
+            return value_.load(std::memory_order_relaxed);
+        }
+    };
+    static_assert(sizeof(Metric) == CACHE_LINE_SIZE);
+
+    // Layout of the shared memory file: this header, then METRICS_MAX metrics.
+    struct alignas(CACHE_LINE_SIZE) MetricsHeader{
+        uint64_t magic_ = METRICS_MAGIC;
+        uint32_t version_ = METRICS_VERSION;
+        int32_t pid_ = 0;
+        // a metric's name and type are written before it is counted here
+        std::atomic<uint32_t> num_metrics_ = {0};
+        char process_[32] = {};
+    };
+
+    struct MetricsFile{
+        MetricsHeader header_;
+        Metric metrics_[METRICS_MAX];
+    };
+
+    // Metrics of this process, mapped from /dev/shm/chapter10_<program>_<pid> so chapter10_stat can watch them live.
+    // Registration is for start-up and takes a lock; the returned Metric stays valid for the life of the registry.
+    // A registry constructed with publish false lives in private memory, for components that run many copies side by side.
+    class MetricsRegistry final{
+    private:
+        MetricsFile *file_ = nullptr;
+        std::mutex mutex_;
+        const std::string path_;
+
+        // The mapping stays valid, metrics updated after this are simply no longer visible to readers.
+        static auto unlinkAtExit() -> void;
+
+    public:
+        explicit MetricsRegistry(bool publish = true)
+            : path_(publish ? METRICS_SHM_PREFIX + std::string(program_invocation_short_name) + "_" + std::to_string(getpid()) : ""){
+            const std::string process = program_invocation_short_name;
+            if(!publish){
+                auto mem = mmap(nullptr, sizeof(MetricsFile), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                ASSERT(mem != MAP_FAILED, "Could not mmap private metrics, error:" + std::string(strerror(errno)));
+                file_ = new(mem) MetricsFile();
+                return;
+            }
+            const int fd = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            ASSERT(fd >= 0, "Could not open metrics file: " + path_ + " error:" + std::string(strerror(errno)));
+            ASSERT(ftruncate(fd, sizeof(MetricsFile)) == 0, "Could not size metrics file: " + path_);
+            auto mem = mmap(nullptr, sizeof(MetricsFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ASSERT(mem != MAP_FAILED, "Could not mmap metrics file: " + path_ + " error:" + std::string(strerror(errno)));
+            close(fd);
+            file_ = new(mem) MetricsFile();
+            file_->header_.pid_ = getpid();
+            strncpy(file_->header_.process_, process.c_str(), sizeof(file_->header_.process_) - 1);
+            std::atexit(&MetricsRegistry::unlinkAtExit);
+        }
+
+        ~MetricsRegistry(){
+            munmap(file_, sizeof(MetricsFile));
+        }
+
+        MetricsRegistry(const MetricsRegistry&) = delete;
+        MetricsRegistry(MetricsRegistry&&) = delete;
+        MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+        MetricsRegistry& operator=(MetricsRegistry&&) = delete;
+
+        // Names longer than METRIC_NAME_SIZE - 1 are cut. Registering a name twice returns the same metric.
+        auto add(const std::string &name, MetricType type) -> Metric*{
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto n = file_->header_.num_metrics_.load(std::memory_order_relaxed);
+            for(uint32_t i = 0; i < n; ++i){
+                if(!strncmp(file_->metrics_[i].name_, name.c_str(), METRIC_NAME_SIZE - 1)){
+                    return &file_->metrics_[i];
+                }
+            }
+            ASSERT(n < METRICS_MAX, "Too many metrics, cannot add " + name);
+            auto metric = &file_->metrics_[n];
+            strncpy(metric->name_, name.c_str(), METRIC_NAME_SIZE - 1);
+            metric->type_ = type;
+            file_->header_.num_metrics_.store(n + 1, std::memory_order_release);
+            return metric;
+        }
+
+        auto counter(const std::string &name){
+            return add(name, MetricType::COUNTER);
+        }
+        auto gauge(const std::string &name){
+            return add(name, MetricType::GAUGE);
+        }
+
+        auto path() const noexcept -> const std::string&{
+            return path_;
+        }
+    };
+
+    // Created on first use and never destroyed, threads may still update their metrics during static destruction.
+    // The file is removed at normal exit, chapter10_stat removes the ones left behind by processes that were killed.
+    inline auto processMetrics() -> MetricsRegistry&{
+        static auto registry = new MetricsRegistry();
+        return *registry;
+    }
+
+    inline thread_local MetricsRegistry *thread_metrics = nullptr;
+
+    // Where components register their metrics: the registry installed on this thread by ScopedThreadMetrics, if any,
+    // otherwise the published one of the process.
+    inline auto metrics() -> MetricsRegistry&{
+        return thread_metrics ? *thread_metrics : processMetrics();
+    }
+
+    // Everything constructed on this thread while it is in scope registers its metrics in registry.
+    class ScopedThreadMetrics final{
+    private:
+        MetricsRegistry *previous_;
+
+    public:
+        explicit ScopedThreadMetrics(MetricsRegistry *registry) noexcept : previous_(thread_metrics){
+            thread_metrics = registry;
+        }
+        ~ScopedThreadMetrics(){
+            thread_metrics = previous_;
+        }
+
+        ScopedThreadMetrics(const ScopedThreadMetrics&) = delete;
+        ScopedThreadMetrics& operator=(const ScopedThreadMetrics&) = delete;
+    };
+
+    inline auto MetricsRegistry::unlinkAtExit() -> void{
+        unlink(processMetrics().path().c_str());
+    }
+}
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef MIRRORED_BUFFER_H
+#define MIRRORED_BUFFER_H
+
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "macros.h"
+
+namespace thu{
+    // Maps capacity bytes twice, back to back, and returns the start of the first copy.
+    // capacity is rounded up in place to a power of two multiple of the page size, unmap 2 * capacity bytes.
+    inline auto mapMirroredMemory(size_t &capacity) -> char*{
+        const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        auto rounded = page_size;
+        while(rounded < capacity){
+            rounded <<= 1;
+        }
+        capacity = rounded;
+
+        const int fd = memfd_create("thu_mirrored_buffer", MFD_CLOEXEC);
+        ASSERT(fd >= 0, "memfd_create() failed: " + std::string(strerror(errno)));
+        ASSERT(ftruncate(fd, capacity) == 0, "ftruncate() failed: " + std::string(strerror(errno)));
+
+        // reserve both halves first so nothing else can be mapped in between
+        auto base = static_cast<char*>(mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        ASSERT(base != MAP_FAILED, "mmap() reserve failed: " + std::string(strerror(errno)));
+        ASSERT(mmap(base, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == base,
+               "mmap() first half failed: " + std::string(strerror(errno)));
+        ASSERT(mmap(base + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == base + capacity,
+               "mmap() second half failed: " + std::string(strerror(errno)));
+        close(fd);
+        return base;
+    }
+
+    // Byte ring buffer whose physical pages are mapped twice, back to back, in virtual memory.
+    // Any readable or writable region is therefore contiguous even when it wraps past the end of the ring,
+    // so records can be parsed in place with a reinterpret_cast and consumed by moving a cursor - nothing is ever compacted.
+    // Single threaded, the writer and the reader are expected to be the same socket owner.
+    class MirroredBuffer final{
+    private:
+        char *data_ = nullptr;
+        size_t capacity_ = 0;
+        size_t mask_ = 0;
+        size_t read_index_ = 0;
+        size_t write_index_ = 0;
+
+    public:
+        // capacity is rounded up to a power of two multiple of the page size
+        explicit MirroredBuffer(size_t capacity) : data_(mapMirroredMemory(capacity)), capacity_(capacity), mask_(capacity - 1){
+        }
+
+        ~MirroredBuffer(){
+            munmap(data_, 2 * capacity_);
+        }
+
+        MirroredBuffer() = delete;
+        MirroredBuffer(const MirroredBuffer&) = delete;
+        MirroredBuffer(MirroredBuffer&&) = delete;
+        MirroredBuffer& operator=(const MirroredBuffer&) = delete;
+        MirroredBuffer& operator=(MirroredBuffer&&) = delete;
+
+        // Writer: recv() straight into writePtr() for up to writable() bytes, then commit what was received.
+        auto writePtr() noexcept{
+            return data_ + (write_index_ & mask_);
+        }
+        auto writable() const noexcept{
+            return capacity_ - (write_index_ - read_index_);
+        }
+        auto commit(size_t n) noexcept{
+            write_index_ += n;
+        }
+
+        // Reader: the readable() bytes at readPtr() are contiguous, consume() hands them back.
+        auto readPtr() const noexcept -> const char*{
+            return data_ + (read_index_ & mask_);
+        }
+        auto readable() const noexcept{
+            return write_index_ - read_index_;
+        }
+        auto consume(size_t n) noexcept{
+            read_index_ += n;
+        }
+
+        // Drop everything that is buffered
+        auto clear() noexcept{
+            read_index_ = write_index_;
+        }
+
+        auto capacity() const noexcept{
+            return capacity_;
+        }
+    };
+
+    // Single-producer / single-consumer variant for variable length records handed between two threads.
+    // Same cursor scheme as LFQueue: monotonic indices, the producer caching the consumer cursor on its own cache line.
+    class MirroredRing final{
+    private:
+        char *data_ = nullptr;
+        size_t capacity_ = 0;
+        size_t mask_ = 0;
+
+        // written by the producer, read by the consumer
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> write_index_ = {0};
+        // producer only
+        alignas(CACHE_LINE_SIZE) size_t cached_read_index_ = 0;
+
+        // written by the consumer, read by the producer
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> read_index_ = {0};
+
+    public:
+        // pages are touched up front so the producer never takes a page fault in tryReserve()
+        explicit MirroredRing(size_t capacity) : data_(mapMirroredMemory(capacity)), capacity_(capacity), mask_(capacity - 1){
+            const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            for(size_t offset = 0; offset < capacity_; offset += page_size){
+                data_[offset] = 0;
+            }
+        }
+
+        ~MirroredRing(){
+            munmap(data_, 2 * capacity_);
+        }
+
+        MirroredRing() = delete;
+        MirroredRing(const MirroredRing&) = delete;
+        MirroredRing(MirroredRing&&) = delete;
+        MirroredRing& operator=(const MirroredRing&) = delete;
+        MirroredRing& operator=(MirroredRing&&) = delete;
+
+        // Producer: n contiguous bytes to fill in, or nullptr when the consumer has not freed enough yet.
+        auto tryReserve(size_t n) noexcept -> char*{
+            const auto write_index = write_index_.load(std::memory_order_relaxed);
+            if(UNLIKELY(write_index - cached_read_index_ + n > capacity_)){
+                cached_read_index_ = read_index_.load(std::memory_order_acquire);
+                if(write_index - cached_read_index_ + n > capacity_){
+                    return nullptr;
+                }
+            }
+            return data_ + (write_index & mask_);
+        }
+
+        // Publish n bytes previously handed out by tryReserve()
+        auto commit(size_t n) noexcept{
+            write_index_.store(write_index_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+
+        // Consumer: everything published so far is contiguous from readPtr().
+        auto readable() const noexcept{
+            return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_relaxed);
+        }
+
+        auto readPtr() const noexcept -> const char*{
+            return data_ + (read_index_.load(std::memory_order_relaxed) & mask_);
+        }
+
+        auto release(size_t n) noexcept{
+            read_index_.store(read_index_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+
+        // Safe from any thread
+        auto empty() const noexcept{
+            return read_index_.load(std::memory_order_acquire) == write_index_.load(std::memory_order_acquire);
+        }
+
+        auto capacity() const noexcept{
+            return capacity_;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef PIPELINE_TRACE_H
+#define PIPELINE_TRACE_H
+
+#include <array>
+#include <string>
+#include "latency_histogram.h"
+#include "time_utils.h"
+
+namespace thu{
+#ifdef THU_PIPELINE_TRACE
+    constexpr bool PIPELINE_TRACE = true;
+#else
+    constexpr bool PIPELINE_TRACE = false;
+#endif
+    constexpr size_t TRACE_MAX_HOPS = 8;
+    constexpr Nanos TRACE_REPORT_INTERVAL = 10 * NANOS_TO_SECS;
+
+    // readTsc() at each hop a message passed, indexed by a per-pipeline hop enum. 0 means not stamped.
+    // Compiled down to an empty struct unless THU_PIPELINE_TRACE is defined.
+    struct TraceStamps{
+#ifdef THU_PIPELINE_TRACE
+        std::array<uint64_t, TRACE_MAX_HOPS> tsc_ = {};
+
+        template<typename Hop>
+        auto stamp(Hop hop) noexcept{
+            tsc_[static_cast<size_t>(hop)] = readTsc();
+        }
+        template<typename Hop>
+        auto set(Hop hop, uint64_t tsc) noexcept{
+            tsc_[static_cast<size_t>(hop)] = tsc;
+        }
+        template<typename Hop>
+        auto at(Hop hop) const noexcept -> uint64_t{
+            return tsc_[static_cast<size_t>(hop)];
+        }
+#else
+        template<typename Hop>
+        auto stamp(Hop) noexcept{}
+        template<typename Hop>
+        auto set(Hop, uint64_t) noexcept{}
+        template<typename Hop>
+        auto at(Hop) const noexcept -> uint64_t{
+            return 0;
+        }
+#endif
+    };
+
+    // Internal queue element: the message exactly as it goes on the wire plus the stamps it collected so far.
+    // Converting from a bare T starts a fresh trace, and the T base is what gets sent.
+    template<typename T>
+    struct Traced : T{
+        [[no_unique_address]] TraceStamps trace_;
+
+        Traced() = default;
+        Traced(const T &msg) : T(msg){}
+
+        auto msg() const noexcept -> const T&{
+            return *this;
+        }
+    };
+
+    // A latency between two hops of the same trace
+    template<typename Hop>
+    struct TraceSpan{
+        const char *name_;
+        Hop from_;
+        Hop to_;
+    };
+
+    // Histograms for the spans completed by one pipeline stage. record() and report() belong to the stage thread,
+    // toString() can also be called from elsewhere, e.g. once more at shutdown.
+    template<typename Hop, size_t N>
+    class TraceSpans final{
+    private:
+        const std::array<TraceSpan<Hop>, N> spans_;
+        std::array<LatencyHistogram, N> histograms_;
+        Nanos next_report_ = 0;
+
+    public:
+        explicit TraceSpans(const std::array<TraceSpan<Hop>, N> &spans) : spans_(spans){}
+
+        // Spans with an unstamped end are skipped
+        auto record(const TraceStamps &trace) noexcept{
+            for(size_t i = 0; i < N; ++i){
+                const auto from = trace.at(spans_[i].from_), to = trace.at(spans_[i].to_);
+                if(from && to){
+                    histograms_[i].record(ticksToNanos(static_cast<int64_t>(to - from)));
+                }
+            }
+        }
+
+        // True once every TRACE_REPORT_INTERVAL
+        auto reportDue() noexcept{
+            const auto now = getCurrentNanos();
+            if(now < next_report_){
+                return false;
+            }
+            next_report_ = now + TRACE_REPORT_INTERVAL;
+            return true;
+        }
+
+        auto histogram(size_t i) const noexcept -> const LatencyHistogram&{
+            return histograms_[i];
+        }
+
+        // One line per span, in nanoseconds
+        auto toString() const{
+            std::string s;
+            for(size_t i = 0; i < N; ++i){
+                s += std::string(spans_[i].name_) + " ns " + histograms_[i].toString() + "\n";
+            }
+            return s;
+        }
+
+        // Same as toString() in HistogramSnapshot::toCSV() format, header line included
+        auto toCSV() const{
+            auto s = HistogramSnapshot::csvHeader();
+            for(size_t i = 0; i < N; ++i){
+                s += histograms_[i].snapshot().toCSV(spans_[i].name_);
+            }
+            return s;
+        }
+    };
+}
+
+#endif
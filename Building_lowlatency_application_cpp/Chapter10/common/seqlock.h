@@ -0,0 +1,52 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include "macros.h"
+
+namespace thu{
+    // Single writer, many readers. The writer never waits; readers retry while a store is in progress,
+    // so a load is a couple of plain loads plus a copy of T when there is no concurrent store.
+    template<typename T>
+    class SeqLock final{
+    private:
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> sequence_ = {0};
+        T value_{};
+
+    public:
+        SeqLock() = default;
+        explicit SeqLock(const T &value) : value_(value){}
+
+        SeqLock(const SeqLock&) = delete;
+        SeqLock(SeqLock&&) = delete;
+        SeqLock& operator=(const SeqLock&) = delete;
+        SeqLock& operator=(SeqLock&&) = delete;
+
+        // Writer only
+        auto store(const T &value) noexcept{
+            const auto sequence = sequence_.load(std::memory_order_relaxed);
+            sequence_.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(static_cast<void*>(&value_), &value, sizeof(T));
+            sequence_.store(sequence + 2, std::memory_order_release);
+        }
+
+        auto load() const noexcept -> T{
+            T value;
+            uint64_t before, after;
+            do{
+                before = sequence_.load(std::memory_order_acquire);
+                memcpy(static_cast<void*>(&value), &value_, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = sequence_.load(std::memory_order_relaxed);
+            } while(UNLIKELY((before & 1) || before != after));
+            return value;
+        }
+    };
+}
+
+#endif
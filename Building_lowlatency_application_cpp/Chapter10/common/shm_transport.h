@@ -0,0 +1,235 @@
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "macros.h"
+
+namespace thu{
+    constexpr uint64_t SHM_TRANSPORT_MAGIC = 0x31304d4853554854ULL; // "THUSHM01"
+    constexpr auto SHM_TRANSPORT_PREFIX = "/dev/shm/chapter10-shm_";
+
+    // A T shared between processes through SHM_TRANSPORT_PREFIX + name. The creating side constructs T in a new file and
+    // removes it again when it goes away, the attaching side only sees T once it is fully constructed and while its
+    // creator is running. T must not own memory outside the mapping, i.e. fixed size arrays and atomics only.
+    template<typename T>
+    class ShmMapping final{
+    private:
+        struct Layout{
+            std::atomic<uint64_t> magic_ = {0};     // stored last by the creator
+            uint64_t size_ = sizeof(Layout);
+            pid_t creator_pid_ = getpid();
+            alignas(CACHE_LINE_SIZE) T object_;
+        };
+        static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+        const std::string path_;
+        const bool owner_;
+        Layout *layout_ = nullptr;
+        ino_t inode_ = 0;
+
+    public:
+        // create: replaces any leftover file of that name with a new one, so whoever is still attached to the old one
+        // keeps it to itself. Otherwise attaches, and get() is nullptr if the creator has not finished yet, has exited
+        // without removing the file or the file is from an incompatible build.
+        ShmMapping(const std::string &name, bool create) : path_(SHM_TRANSPORT_PREFIX + name), owner_(create){
+            if(create){
+                unlink(path_.c_str());
+            }
+            const int fd = open(path_.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC) : (O_RDWR | O_CLOEXEC), 0644);
+            if(fd < 0){
+                ASSERT(!create, "Could not create shared memory file: " + path_ + " error:" + std::string(strerror(errno)));
+                return;
+            }
+            if(create){
+                ASSERT(ftruncate(fd, sizeof(Layout)) == 0, "Could not size shared memory file: " + path_);
+            }
+            struct stat st;
+            if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != sizeof(Layout)){
+                close(fd);
+                return;
+            }
+            inode_ = st.st_ino;
+            auto mem = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            ASSERT(mem != MAP_FAILED, "Could not mmap shared memory file: " + path_ + " error:" + std::string(strerror(errno)));
+            if(create){
+                layout_ = new(mem) Layout();
+                layout_->magic_.store(SHM_TRANSPORT_MAGIC, std::memory_order_release);
+            }
+            else{
+                layout_ = static_cast<Layout*>(mem);
+                if(layout_->magic_.load(std::memory_order_acquire) != SHM_TRANSPORT_MAGIC || layout_->size_ != sizeof(Layout) || !live()){
+                    munmap(mem, sizeof(Layout));
+                    layout_ = nullptr;
+                }
+            }
+        }
+
+        ~ShmMapping(){
+            if(layout_){
+                munmap(layout_, sizeof(Layout));
+            }
+            struct stat st;
+            if(owner_ && stat(path_.c_str(), &st) == 0 && st.st_ino == inode_){
+                unlink(path_.c_str());
+            }
+        }
+
+        ShmMapping(const ShmMapping&) = delete;
+        ShmMapping(ShmMapping&&) = delete;
+        ShmMapping& operator=(const ShmMapping&) = delete;
+        ShmMapping& operator=(ShmMapping&&) = delete;
+
+        auto get() const noexcept -> T*{
+            return layout_ ? &layout_->object_ : nullptr;
+        }
+        auto path() const noexcept -> const std::string&{
+            return path_;
+        }
+
+        // Whether the creator is still running and its file has not been replaced since. A system call, not for the
+        // fast path.
+        auto live() const noexcept -> bool{
+            struct stat st;
+            return layout_ && (kill(layout_->creator_pid_, 0) == 0 || errno == EPERM) &&
+                   stat(path_.c_str(), &st) == 0 && st.st_ino == inode_;
+        }
+    };
+
+    // LFQueue's cursor scheme with the store inline, so one producer process and one consumer process can share it
+    // through a ShmMapping. A full ring is reported instead of waited on, the other process may be gone.
+    template<typename T, size_t N>
+    class ShmSpscRing final{
+    private:
+        static_assert(std::has_single_bit(N), "ShmSpscRing capacity must be a power of two");
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        // written by the producer, read by the consumer
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> next_write_index_ = {0};
+        // producer only
+        alignas(CACHE_LINE_SIZE) uint64_t cached_read_index_ = 0;
+        // written by the consumer, read by the producer
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> next_read_index_ = {0};
+        // consumer only
+        alignas(CACHE_LINE_SIZE) uint64_t cached_write_index_ = 0;
+        alignas(CACHE_LINE_SIZE) T store_[N];
+
+    public:
+        // Producer: the next free slot, nullptr while the ring is full
+        auto getNextToWriteTo() noexcept -> T*{
+            const auto write_index = next_write_index_.load(std::memory_order_relaxed);
+            if(UNLIKELY(write_index - cached_read_index_ >= N)){
+                cached_read_index_ = next_read_index_.load(std::memory_order_acquire);
+                if(write_index - cached_read_index_ >= N){
+                    return nullptr;
+                }
+            }
+            return &store_[write_index & (N - 1)];
+        }
+        auto updateWriteIndex() noexcept{
+            next_write_index_.store(next_write_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Consumer: the oldest unread element, nullptr if there is none
+        auto getNextToRead() noexcept -> const T*{
+            const auto read_index = next_read_index_.load(std::memory_order_relaxed);
+            if(read_index == cached_write_index_){
+                cached_write_index_ = next_write_index_.load(std::memory_order_acquire);
+                if(read_index == cached_write_index_){
+                    return nullptr;
+                }
+            }
+            return &store_[read_index & (N - 1)];
+        }
+        auto updateReadIndex() noexcept{
+            next_read_index_.store(next_read_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        auto size() const noexcept{
+            return next_write_index_.load(std::memory_order_acquire) - next_read_index_.load(std::memory_order_acquire);
+        }
+    };
+
+    template<typename T, size_t N> class ShmBroadcastReader;
+
+    // One writer, any number of readers in any process, no back pressure: the writer never waits and a reader that
+    // falls more than N behind is told it was lapped. Each slot carries a sequence like SeqLock's, 2 * index + 1 while
+    // the element for index is being written and 2 * index + 2 once it is complete.
+    template<typename T, size_t N>
+    class ShmBroadcastRing final{
+    private:
+        static_assert(std::has_single_bit(N), "ShmBroadcastRing capacity must be a power of two");
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        struct Slot{
+            std::atomic<uint64_t> sequence_ = {0};
+            T value_;
+        };
+
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> next_write_index_ = {0};
+        alignas(CACHE_LINE_SIZE) Slot slots_[N];
+
+        friend class ShmBroadcastReader<T, N>;
+
+    public:
+        // Writer only
+        auto publish(const T &value) noexcept{
+            const auto index = next_write_index_.load(std::memory_order_relaxed);
+            auto &slot = slots_[index & (N - 1)];
+            slot.sequence_.store(2 * index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(static_cast<void*>(&slot.value_), &value, sizeof(T));
+            slot.sequence_.store(2 * index + 2, std::memory_order_release);
+            next_write_index_.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    enum class ShmReadResult : uint8_t{
+        EMPTY = 0,  // nothing new
+        READ = 1,   // the next element was copied out
+        LAPPED = 2  // the writer overwrote what was to be read next, the reader skipped ahead to the newest element
+    };
+
+    // A reader's position in a ShmBroadcastRing, private to the reader. Starts at whatever is published next.
+    template<typename T, size_t N>
+    class ShmBroadcastReader final{
+    private:
+        const ShmBroadcastRing<T, N> *ring_ = nullptr;
+        uint64_t next_index_ = 0;
+
+    public:
+        explicit ShmBroadcastReader(const ShmBroadcastRing<T, N> *ring) : ring_(ring), next_index_(ring->next_write_index_.load(std::memory_order_acquire)){}
+
+        auto tryRead(T *value) noexcept -> ShmReadResult{
+            const auto &slot = ring_->slots_[next_index_ & (N - 1)];
+            const auto expected = 2 * next_index_ + 2;
+            const auto before = slot.sequence_.load(std::memory_order_acquire);
+            if(before < expected){
+                return ShmReadResult::EMPTY;
+            }
+            if(before == expected){
+                memcpy(static_cast<void*>(value), &slot.value_, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(LIKELY(slot.sequence_.load(std::memory_order_relaxed) == expected)){
+                    ++next_index_;
+                    return ShmReadResult::READ;
+                }
+            }
+            next_index_ = ring_->next_write_index_.load(std::memory_order_acquire);
+            return ShmReadResult::LAPPED;
+        }
+    };
+}
+
+#endif
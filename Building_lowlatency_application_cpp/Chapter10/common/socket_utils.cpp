@@ -1,5 +1,6 @@
 #include "socket_utils.h"
 namespace thu{
+static constexpr auto LOG_COMPONENT = LogComponent::SOCKET;
 
 // Getting interface information
 auto getIfaceIP(const std::string &iface)->std::string{
@@ -58,7 +59,7 @@ auto setMcastTTL(int fd, int mcast_ttl) noexcept -> bool
 
 auto setSOTimestamp(int fd)->bool{
     int one = 1;
-    return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, reinterpret_cast<void*>(&one), sizeof(one)) != -1);
+    return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, reinterpret_cast<void*>(&one), sizeof(one)) != -1);
 }
 
 // Creating the socket
@@ -74,7 +75,7 @@ auto createSocket(Logger& logger
 
     std::string time_str;
     const auto ip = t_ip.empty() ? getIfaceIP(iface) : t_ip;
-    logger.log("%:% %() % ip:% iface:% port:% is_udp:% \
+    LOG_INFO(logger, "%:% %() % ip:% iface:% port:% is_udp:% \
                    is_blocking : % \
                    is_listening : % ttl : % SO_time : %\n ",
                    __FILE__,
@@ -97,7 +98,7 @@ auto createSocket(Logger& logger
     addrinfo *result = nullptr;
     const auto rc = getaddrinfo(ip.c_str(), std::to_string(port).c_str(), &hints, &result);
     if(rc){
-        logger.log("getaddrinfo() failed. error: % errno: %\n", gai_strerror(rc), strerror(errno));
+        LOG_ERROR(logger, "getaddrinfo() failed. error: % errno: %\n", gai_strerror(rc), strerror(errno));
         return -1;
     }
 
@@ -106,46 +107,46 @@ auto createSocket(Logger& logger
     for(addrinfo *rp = result; rp; rp = rp->ai_next){
         fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
         if(fd == -1){
-            logger.log("socket() failed. errno:%\n", strerror(errno));
+            LOG_ERROR(logger, "socket() failed. errno:%\n", strerror(errno));
             return -1;
         }
     }
 
     if(!is_blocking){
         if(!setNonBlocking(fd)){
-            logger.log("setNonBlocking() failed. errno:%\n", strerror(errno));
+            LOG_ERROR(logger, "setNonBlocking() failed. errno:%\n", strerror(errno));
             return -1;
         }
         if(!is_udp && !setNoDelay(fd)){
-            logger.log("setNoDelay() failed. errno:%\n", strerror(errno));
+            LOG_ERROR(logger, "setNoDelay() failed. errno:%\n", strerror(errno));
             return -1;
         }
     }
 
     if(is_listening && setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one)) == -1){
-        logger.log("setsockopt() SO_REUSEADDR failed. errno:%\n", strerror(errno));
+        LOG_ERROR(logger, "setsockopt() SO_REUSEADDR failed. errno:%\n", strerror(errno));
         return -1;
     }
 
     if(!is_udp && is_listening && listen(fd, MaxTCPServerBacklog) == -1){
-        logger.log("listen() failed. errno:%", strerror(errno));
+        LOG_ERROR(logger, "listen() failed. errno:%", strerror(errno));
         return -1;
     }
 
     if(is_udp && ttl){
         const bool is_multicast = atoi(ip.c_str()) &0xe0;
         if(is_multicast && !setMcastTTL(fd, ttl)){
-            logger.log("setMcastTTL() failed. errno:%", strerror(errno));
+            LOG_ERROR(logger, "setMcastTTL() failed. errno:%", strerror(errno));
             return -1;
         }
         if (!is_multicast && !setTTL(fd, ttl))
         {
-            logger.log("setTTL() failed. errno:%", strerror(errno));
+            LOG_ERROR(logger, "setTTL() failed. errno:%", strerror(errno));
             return -1;
         }
     }
     if(needs_so_timestamp && !setSOTimestamp(fd)){
-        logger.log("setSOTimestamp() failed. errno:%", strerror(errno));
+        LOG_ERROR(logger, "setSOTimestamp() failed. errno:%", strerror(errno));
         return -1;
     }
     
@@ -160,7 +161,7 @@ auto createSocket(Logger &logger, const SocketCfg &socket_cfg) -> int
 {
     std::string time_str;
     const auto ip = socket_cfg.ip_.empty() ? getIfaceIP(socket_cfg.iface_) : socket_cfg.ip_;
-    logger.log("%:% %() % cfg:%\n", __FILE__, __LINE__, __FUNCTION__,
+    LOG_INFO(logger, "%:% %() % cfg:%\n", __FILE__, __LINE__, __FUNCTION__,
                thu::getCurrentTimeStr(&time_str), socket_cfg.toString());
     
     const int input_flags = (socket_cfg.is_listening_ ? AI_PASSIVE : 0) | (AI_NUMERICHOST | AI_NUMERICSERV);
@@ -1,5 +1,6 @@
 #ifndef SOCKET_UTILS_H
 #define SOCKET_UTILS_H
+#include <array>
 #include <iostream>
 #include <string>
 #include <unordered_set>
@@ -22,7 +23,7 @@ namespace thu{
     auto getIfaceIP(const std::string &iface) -> std::string;
     auto setNonBlocking(int fd) -> bool;
     auto setNoDelay(int fd) -> bool;
-    auto setSOTimestamp(int fd) -> bool;
+    auto setSOTimestamp(int fd) -> bool; // nanosecond software receive timestamps, SO_TIMESTAMPNS
     auto disableNagle(int fd) -> bool; // disbale Nagle's algorithm and associated delays
     auto wouldBlock() -> bool;
     auto setMcastTTL(int fd, int ttl) noexcept -> bool;
@@ -52,6 +53,30 @@ namespace thu{
         }
     };
 
+    // Control buffer to pass to recvmsg() on a socket with setSOTimestamp(), aligned for the cmsghdr CMSG_FIRSTHDR() points into it
+    struct RxTimestampControl{
+        alignas(cmsghdr) char buf_[CMSG_SPACE(sizeof(timespec))];
+
+        auto data() noexcept{
+            return buf_;
+        }
+        static constexpr auto size() noexcept{
+            return sizeof(buf_);
+        }
+    };
+
+    // Kernel receive time in nanoseconds since the epoch from the control messages recvmsg() returned, 0 if there is none.
+    inline auto kernelRxTime(msghdr &msg) noexcept -> Nanos{
+        for(auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+            if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS && cmsg->cmsg_len == CMSG_LEN(sizeof(timespec))){
+                timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                return ts.tv_sec * NANOS_TO_SECS + ts.tv_nsec;
+            }
+        }
+        return 0;
+    }
+
     // Create a TCP/UDP socket to either connect to or listen for data on or listen for connections on the specified interface and IP:port information
     auto createSocket(Logger &logger, const SocketCfg &socket_cfg) -> int;
 }
@@ -2,15 +2,15 @@
 namespace thu
 {
     auto TCPServer::defaultRecvCallback(TCPSocket *socket, Nanos rx_time) noexcept->void{
-        logger_.log("%:% %() %\
+        LOG_DEBUG(logger_, "%:% %() %\
             TCPServer::defaultRecvCallback() socket:% len:% rx:%\n", __FILE__, __LINE__, __FUNCTION__,
-            thu::getCurrentTimeStr(&time_str_), socket->fd_, socket->next_rcv_valid_index_, rx_time
+            thu::getCurrentTimeStr(&time_str_), socket->fd_, socket->rcv_buffer_.readable(), rx_time
         );
     }
 
     auto TCPServer::defaultRecvFinishedCallback() noexcept->void
     {
-        logger_.log("%:% %() %\
+        LOG_DEBUG(logger_, "%:% %() %\
             TCPServer::defaultRecvFinishedCallback()\n", __FILE__, __LINE__, __FUNCTION__,
             thu::getCurrentTimeStr(&time_str_)
         );
@@ -67,12 +67,12 @@ namespace thu
             auto socket = reinterpret_cast<TCPSocket*>(event.data.ptr);
             if(event.events & EPOLLIN){
                 if(socket == &listener_socket_){
-                    logger_.log("%:% %() %\
+                    LOG_DEBUG(logger_, "%:% %() %\
                             listener_socket_:% \n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket->fd_);
                     have_new_connection = true;
                     continue;
                 }
-                logger_.log("%:% %() %\
+                LOG_DEBUG(logger_, "%:% %() %\
                             EPOLLIN socket:% \n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket->fd_);
                 if(std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end()){
                     receive_sockets_.push_back(socket);
@@ -80,7 +80,7 @@ namespace thu
             }
 
             if(event.events & (EPOLLERR | EPOLLHUP)){
-                logger_.log("%:% %() %\
+                LOG_ERROR(logger_, "%:% %() %\
                             EPOLLERR socket:% \n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket->fd_);
                 if(std::find(disconnected_sockets_.begin(), disconnected_sockets_.end(), socket) == disconnected_sockets_.end()){
                     disconnected_sockets_.push_back(socket);
@@ -89,7 +89,7 @@ namespace thu
         }
 
         while(have_new_connection){
-            logger_.log("%:% %() %\
+            LOG_INFO(logger_, "%:% %() %\
                             have new connection\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
             sockaddr_storage addr;
             socklen_t addr_len = sizeof(addr);
@@ -98,7 +98,7 @@ namespace thu
                 break;
             }
             ASSERT(setNonBlocking(fd) && setNoDelay(fd), "Failed to set non-blocking or no-delay on socket:"+std::to_string(fd));
-            logger_.log("%:% %() %\
+            LOG_INFO(logger_, "%:% %() %\
                             accepted socket:%\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), fd);
                 
             TCPSocket *socket = new TCPSocket(logger_);
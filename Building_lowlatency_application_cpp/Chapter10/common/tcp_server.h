@@ -3,6 +3,7 @@
 namespace thu{
 struct TCPServer{
 public:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::SOCKET;
     int efd_ = -1;
     TCPSocket listener_socket_;
     epoll_event events_[1024];
@@ -9,8 +9,8 @@ namespace thu{
 
     auto TCPSocket::defaultRecvCallback(TCPSocket *socket, Nanos rx_time) noexcept->void
     {
-        logger_.log("%:% %() % TCPSocket::defaultRecvCallback() socket:% len:% rx:%\n",
-                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket->fd_, socket->next_rcv_valid_index_, rx_time);
+        LOG_DEBUG(logger_, "%:% %() % TCPSocket::defaultRecvCallback() socket:% len:% rx:%\n",
+                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket->fd_, socket->rcv_buffer_.readable(), rx_time);
     }
 
     auto TCPSocket::connect(const std::string &ip, const std::string &iface, int port, bool is_listening) -> int
@@ -33,14 +33,13 @@ namespace thu{
 
     auto TCPSocket::sendAndRecv() noexcept -> bool
     {
-        char ctrl[CMSG_SPACE(sizeof(struct timeval))];
-        struct cmsghdr *cmsg = (struct cmsghdr *)&ctrl;
+        RxTimestampControl ctrl;
         struct iovec iov;
-        iov.iov_base = rcv_buffer_ + next_rcv_valid_index_;
-        iov.iov_len = TCPBufferSize - next_rcv_valid_index_;
+        iov.iov_base = rcv_buffer_.writePtr();
+        iov.iov_len = rcv_buffer_.writable();
         msghdr msg;
-        msg.msg_control = ctrl;
-        msg.msg_controllen = sizeof(ctrl);
+        msg.msg_control = ctrl.data();
+        msg.msg_controllen = ctrl.size();
         msg.msg_name = &inInAddr;
         msg.msg_namelen = sizeof(inInAddr);
         msg.msg_iov = &iov;
@@ -48,19 +47,11 @@ namespace thu{
         const auto n_rcv = recvmsg(fd_, &msg, MSG_DONTWAIT);
         if (n_rcv > 0)
         {
-            next_rcv_valid_index_ += n_rcv;
-            Nanos kernel_time = 0;
-            struct timeval time_kernel;
-            if (cmsg->cmsg_level == SOL_SOCKET &&
-                cmsg->cmsg_type == SCM_TIMESTAMP &&
-                cmsg->cmsg_len == CMSG_LEN(sizeof(time_kernel)))
-            {
-                memcpy(&time_kernel, CMSG_DATA(cmsg), sizeof(time_kernel));
-                kernel_time = time_kernel.tv_sec * NANOS_TO_SECS + time_kernel.tv_usec * NANOS_TO_MICROS;
-            }
+            rcv_buffer_.commit(n_rcv);
+            const auto kernel_time = kernelRxTime(msg);
             const auto user_time = getCurrentNanos();
-            logger_.log("%:% %() % read socket:% len:% utime:% ktime:% diff:%\n",
-                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), fd_, next_rcv_valid_index_, user_time, kernel_time, (user_time - kernel_time));
+            LOG_DEBUG(logger_, "%:% %() % read socket:% len:% utime:% ktime:% diff:%\n",
+                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), fd_, rcv_buffer_.readable(), user_time, kernel_time, (user_time - kernel_time));
             recv_callback_(this, kernel_time);
         }
 
@@ -78,7 +69,7 @@ namespace thu{
                 }
                 break;
             }
-            logger_.log("%:% %() % send socket:% len:%\n",
+            LOG_DEBUG(logger_, "%:% %() % send socket:% len:%\n",
                         __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), fd_, n);
             n_send -= n;
             ASSERT(n == n_send_this_msg, "Dont support partial send lengths yet.");
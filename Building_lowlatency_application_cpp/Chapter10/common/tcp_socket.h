@@ -2,15 +2,16 @@
 #include <functional>
 #include "socket_utils.h"
 #include "logging.h"
+#include "mirrored_buffer.h"
 
 namespace thu{
 constexpr size_t TCPBufferSize = 64 * 1024 * 1024;
 
 struct TCPSocket
 {
-    explicit TCPSocket(Logger &logger) : logger_(logger){
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::SOCKET;
+    explicit TCPSocket(Logger &logger) : rcv_buffer_(TCPBufferSize), logger_(logger){
         send_buffer_ = new char[TCPBufferSize];
-        rcv_buffer_ = new char[TCPBufferSize];
         recv_callback_ = [this](auto socket, auto rx_time){
             defaultRecvCallback(socket, rx_time);
         };
@@ -25,7 +26,6 @@ struct TCPSocket
     ~TCPSocket(){
         destroy();
         delete[] send_buffer_; send_buffer_ = nullptr;
-        delete[] rcv_buffer_; rcv_buffer_ = nullptr;
     }
 
 
@@ -39,8 +39,8 @@ struct TCPSocket
     int fd_ = -1;
     char *send_buffer_ = nullptr;
     size_t next_send_valid_index_ = 0;
-    char *rcv_buffer_ = nullptr;
-    size_t next_rcv_valid_index_ = 0;
+    // parse records in place at rcv_buffer_.readPtr() and consume() them, no compaction needed
+    MirroredBuffer rcv_buffer_;
     bool send_disconnected_ = false;
     bool recv_disconnected_ = false;
     struct sockaddr_in inInAddr;
@@ -0,0 +1,137 @@
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "cpu_topology.h"
+
+namespace thu{
+    // Where each named thread runs, read from the file named by $THU_THREAD_PLACEMENT. One line per entry:
+    //     <cpu list> <thread name prefix>      e.g. "2 MatchingEngine" or "0-1 Common/Logger"
+    // A thread takes the entry with the longest prefix of its name; threads without one are not pinned.
+    // An entry of a single cpu is treated as a dedicated, hot thread; wider entries are shared housekeeping cpus.
+    class ThreadPlacement final{
+    private:
+        std::map<std::string, std::vector<int>> entries_;
+        std::map<int, std::string> dedicated_owners_;   // cpu -> thread that claimed it
+        std::mutex mutex_;
+        CpuTopology topology_;
+
+        auto warn(const std::string &message) const{
+            std::cerr << "ThreadPlacement WARNING " << message << std::endl;
+        }
+
+        auto validate() const{
+            std::vector<std::pair<std::string, int>> dedicated;
+            for(const auto &[prefix, cpus] : entries_){
+                for(const auto cpu : cpus){
+                    if(!topology_.find(cpu)){
+                        warn(prefix + " cpu " + std::to_string(cpu) + " is not online.");
+                    }
+                }
+                if(cpus.size() == 1){
+                    dedicated.emplace_back(prefix, cpus[0]);
+                }
+            }
+            std::set<int> nodes, llcs;
+            for(size_t i = 0; i < dedicated.size(); ++i){
+                const auto &[prefix, cpu] = dedicated[i];
+                for(size_t j = i + 1; j < dedicated.size(); ++j){
+                    const auto &[other_prefix, other_cpu] = dedicated[j];
+                    if(cpu == other_cpu){
+                        warn(prefix + " and " + other_prefix + " are both pinned to cpu " + std::to_string(cpu) + ".");
+                    }
+                    else if(topology_.smtSiblings(cpu, other_cpu)){
+                        warn(prefix + " on cpu " + std::to_string(cpu) + " and " + other_prefix + " on cpu " + std::to_string(other_cpu)
+                                + " are SMT siblings sharing one physical core.");
+                    }
+                }
+                if(const auto info = topology_.find(cpu)){
+                    nodes.insert(info->numa_node_);
+                    llcs.insert(info->llc_id_);
+                }
+            }
+            if(nodes.size() > 1){
+                warn("dedicated threads span " + std::to_string(nodes.size()) + " NUMA nodes, their queues cross the interconnect.");
+            }
+            else if(llcs.size() > 1){
+                warn("dedicated threads span " + std::to_string(llcs.size()) + " last level caches.");
+            }
+        }
+
+    public:
+        explicit ThreadPlacement(const char *file_name){
+            if(!file_name || !*file_name){
+                return;
+            }
+            std::ifstream file(file_name);
+            if(!file){
+                warn(std::string("could not open ") + file_name + ", threads are not pinned.");
+                return;
+            }
+            std::string line;
+            while(std::getline(file, line)){
+                line = line.substr(0, line.find('#'));
+                const auto start = line.find_first_not_of(" \t");
+                if(start == std::string::npos){
+                    continue;
+                }
+                const auto cpus_end = line.find_first_of(" \t", start);
+                const auto name_start = cpus_end == std::string::npos ? std::string::npos : line.find_first_not_of(" \t", cpus_end);
+                const auto cpus = parseCpuList(line.substr(start, cpus_end - start));
+                if(cpus.empty() || name_start == std::string::npos){
+                    warn("ignoring malformed line: " + line);
+                    continue;
+                }
+                const auto name_end = line.find_last_not_of(" \t\r");
+                entries_[line.substr(name_start, name_end + 1 - name_start)] = cpus;
+            }
+            std::cout << "ThreadPlacement " << file_name << " " << entries_.size() << " entries, topology:\n" << topology_.toString();
+            validate();
+        }
+
+        ThreadPlacement(const ThreadPlacement&) = delete;
+        ThreadPlacement& operator=(const ThreadPlacement&) = delete;
+
+        // Cpus the thread should run on, empty for no pinning. Warns when a second thread lands on a dedicated cpu.
+        auto claim(const std::string &thread_name) -> std::vector<int>{
+            std::lock_guard<std::mutex> lock(mutex_);
+            const std::vector<int> *match = nullptr;
+            size_t match_size = 0;
+            for(const auto &[prefix, cpus] : entries_){
+                if(thread_name.starts_with(prefix) && (!match || prefix.size() > match_size)){
+                    match = &cpus;
+                    match_size = prefix.size();
+                }
+            }
+            if(!match){
+                return {};
+            }
+            if(match->size() == 1){
+                const auto [owner, inserted] = dedicated_owners_.emplace(match->front(), thread_name);
+                if(!inserted){
+                    warn(thread_name + " shares dedicated cpu " + std::to_string(match->front()) + " with " + owner->second + ".");
+                }
+            }
+            return *match;
+        }
+
+        auto topology() const noexcept -> const CpuTopology&{
+            return topology_;
+        }
+    };
+
+    // Loaded on first use and kept for the life of the process
+    inline auto threadPlacement() -> ThreadPlacement&{
+        static auto placement = new ThreadPlacement(getenv("THU_THREAD_PLACEMENT"));
+        return *placement;
+    }
+}
+
+#endif
@@ -4,40 +4,59 @@
 #include <iostream>
 #include <atomic>
 #include <thread>
+#include <vector>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include "thread_placement.h"
 
-inline auto setThreadCore(int core_id) noexcept
+inline auto setThreadCores(const std::vector<int> &core_ids) noexcept
 {
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
-    CPU_SET(core_id, &cpuset);
+    for(const auto core_id : core_ids){
+        CPU_SET(core_id, &cpuset);
+    }
     return (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0);
 }
 
+inline auto setThreadCore(int core_id) noexcept
+{
+    return setThreadCores({core_id});
+}
+
+// core_id >= 0 pins the thread to that core, -1 places it as configured in thu::threadPlacement() by name.
+// Returns once the thread has been pinned and is about to run func, or nullptr if pinning failed.
 template<typename T, typename... A>
 inline auto createAndStartThread(int core_id, const std::string& name, T&& func, A&& ...args) noexcept
 {
-    std::atomic<bool> running(false), failed(false);
-    
-    auto thread_body = [&]{
-        if(core_id >= 0 && !setThreadCore(core_id)){
-            std::cerr << "Failed to set core affinity for " << name << " " << pthread_self() << " to " << core_id << std::endl;
-            failed = true;
+    const auto core_ids = core_id >= 0 ? std::vector<int>{core_id} : thu::threadPlacement().claim(name);
+    enum : int {STARTING, RUNNING, FAILED};
+    std::atomic<int> state(STARTING);
+
+    // func and args are moved into the thread, they must not refer back to this frame once state is set
+    auto thread_body = [&state, name, core_ids, func = std::forward<T>(func), ...args = std::forward<A>(args)]() mutable{
+        if(!core_ids.empty() && !setThreadCores(core_ids)){
+            std::cerr << "Failed to set core affinity for " << name << " " << pthread_self() << std::endl;
+            state.store(FAILED, std::memory_order_release);
             return;
         }
-        std::cout << "Set core affinity for " << name << " "  << pthread_self() << " to " << core_id << std::endl;
-        running = true;
-        std::forward<T>(func)((std::forward<A>(args))...);
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        std::cout << "Set core affinity for " << name << " " << pthread_self() << " to";
+        for(const auto id : core_ids){
+            std::cout << " " << id;
+        }
+        std::cout << (core_ids.empty() ? " any\n" : "\n") << std::flush;
+        state.store(RUNNING, std::memory_order_release);
+        func(args...);
     };
 
-    auto t = new std::thread(thread_body);
-    while(!running && !failed){
-        using namespace std::literals::chrono_literals;
-        std::this_thread::sleep_for(1s);
+    auto t = new std::thread(std::move(thread_body));
+    // thread start-up is tens of microseconds, yielding also lets it run on a busy or single cpu
+    while(state.load(std::memory_order_acquire) == STARTING){
+        std::this_thread::yield();
     }
 
-    if(failed){
+    if(state.load(std::memory_order_acquire) == FAILED){
         t->join();
         delete t;
         t = nullptr;
@@ -45,4 +64,4 @@ inline auto createAndStartThread(int core_id, const std::string& name, T&& func,
     return t;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,8 +1,18 @@
 #ifndef TIME_UTILS_H
 #define TIME_UTILS_H
+#include <algorithm>
 #include <chrono>
 #include <ctime>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "seqlock.h"
+#include "thread_utils.h"
+
 namespace thu{
     typedef int64_t Nanos;
     constexpr Nanos NANOS_TO_MICROS = 1000;
@@ -11,19 +21,180 @@ namespace thu{
     constexpr Nanos NANOS_TO_MILLIS = NANOS_TO_MICROS * MICROS_TO_MILLIS;
     constexpr Nanos NANOS_TO_SECS = NANOS_TO_MILLIS * MILLIS_TO_SECS;
 
-    inline auto getCurrentNanos() noexcept {
-        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    inline auto getRealtimeNanos() noexcept -> Nanos{
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return ts.tv_sec * NANOS_TO_SECS + ts.tv_nsec;
     }
 
-    inline auto& getCurrentTimeStr(std::string* time_str){
-        const auto time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-        time_str->assign(ctime(&time));
-        if(!time_str->empty()){
-            time_str->at(time_str->length() -1) = '\0';
+    inline auto readTsc() noexcept -> uint64_t{
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(getRealtimeNanos());
+#endif
+    }
+
+    // Wall clock from the TSC: nanos = base_nanos_ + (tsc - base_tsc_) * mult_ / 2^32.
+    // The background thread of TimeService replaces the parameters once a second against CLOCK_REALTIME,
+    // each new line starts where the previous one is at that moment so the clock never jumps back.
+    struct TscCalibration{
+        uint64_t base_tsc_ = 0;
+        Nanos base_nanos_ = 0;
+        uint64_t mult_ = 0;
+    };
+
+    // ctime() style "Sun Oct 18 09:30:00 2026", refreshed once a second
+    struct TimeStr{
+        char str_[32] = {};
+        uint32_t len_ = 0;
+    };
+
+    class TimeService final{
+    private:
+        __extension__ typedef unsigned __int128 uint128_t;
+        __extension__ typedef __int128 int128_t;
+        static constexpr auto SYNC_INTERVAL = std::chrono::seconds(1);
+        static constexpr auto INITIAL_CALIBRATION = std::chrono::milliseconds(10);
+        static constexpr Nanos SYNC_INTERVAL_NANOS = std::chrono::duration_cast<std::chrono::nanoseconds>(SYNC_INTERVAL).count();
+        // Offset to CLOCK_REALTIME closed per interval by running faster or slower, 5%.
+        // A larger lead of CLOCK_REALTIME is stepped over at once, a larger lag takes several intervals.
+        static constexpr Nanos MAX_SLEW = SYNC_INTERVAL_NANOS / 20;
+
+        SeqLock<TscCalibration> calibration_;
+        SeqLock<TimeStr> time_str_;
+
+        // first sample, the multiplier is refined over the whole time since then
+        uint64_t start_tsc_ = 0;
+        Nanos start_nanos_ = 0;
+
+        std::atomic<bool> running_ = true;
+        std::thread *thread_ = nullptr;
+
+        // Bracket the CLOCK_REALTIME read with two TSC reads to keep the pair tight.
+        static auto sample(uint64_t &tsc, Nanos &nanos) noexcept{
+            const auto tsc_before = readTsc();
+            nanos = getRealtimeNanos();
+            tsc = tsc_before + (readTsc() - tsc_before) / 2;
+        }
+
+        static auto toNanos(const TscCalibration &calibration, uint64_t tsc) noexcept -> Nanos{
+            // signed so a core whose TSC is a few ticks behind the syncing one does not wrap around
+            const auto ticks = static_cast<int64_t>(tsc - calibration.base_tsc_);
+            return calibration.base_nanos_ + static_cast<Nanos>((static_cast<int128_t>(ticks) * calibration.mult_) >> 32);
+        }
+
+        // The TSC rate is averaged since start_tsc_. Rather than re-basing on the sample, which moves the clock back
+        // whenever it ran ahead, the new line continues from the current reading with its rate adjusted to meet
+        // CLOCK_REALTIME by the next sync.
+        auto sync() noexcept{
+            uint64_t tsc;
+            Nanos nanos;
+            sample(tsc, nanos);
+            if(tsc > start_tsc_ && nanos > start_nanos_){
+                const auto mult = static_cast<uint64_t>((static_cast<uint128_t>(nanos - start_nanos_) << 32) / (tsc - start_tsc_));
+                const auto current = calibration_.load();
+                if(!current.mult_){
+                    calibration_.store({tsc, nanos, mult});
+                }
+                else{
+                    const auto base_tsc = readTsc();
+                    const auto base_nanos = toNanos(current, base_tsc);
+                    const auto offset = toNanos({tsc, nanos, mult}, base_tsc) - base_nanos;
+                    if(offset > MAX_SLEW){
+                        calibration_.store({base_tsc, base_nanos + offset, mult});
+                    }
+                    else{
+                        const auto slew = std::clamp(offset, -MAX_SLEW, MAX_SLEW);
+                        calibration_.store({base_tsc, base_nanos,
+                                            static_cast<uint64_t>(static_cast<uint128_t>(mult) * (SYNC_INTERVAL_NANOS + slew) / SYNC_INTERVAL_NANOS)});
+                    }
+                }
+            }
+
+            TimeStr time_str;
+            const time_t secs = nanos / NANOS_TO_SECS;
+            ctime_r(&secs, time_str.str_);
+            time_str.len_ = static_cast<uint32_t>(strnlen(time_str.str_, sizeof(time_str.str_)));
+            if(time_str.len_ && time_str.str_[time_str.len_ - 1] == '\n'){
+                --time_str.len_;
+            }
+            time_str_.store(time_str);
+        }
+
+        auto run() noexcept{
+            while(running_){
+                std::this_thread::sleep_for(SYNC_INTERVAL);
+                sync();
+            }
+        }
+
+    public:
+        TimeService(){
+            sample(start_tsc_, start_nanos_);
+            std::this_thread::sleep_for(INITIAL_CALIBRATION);
+            sync();
+            thread_ = createAndStartThread(-1, "Common/TimeSync", [this](){run();});
+            ASSERT(thread_ != nullptr, "Failed to start TimeService thread.");
+        }
+
+        ~TimeService(){
+            running_ = false;
+            thread_->join();
+            delete thread_;
+        }
+
+        TimeService(const TimeService&) = delete;
+        TimeService(TimeService&&) = delete;
+        TimeService& operator=(const TimeService&) = delete;
+        TimeService& operator=(TimeService&&) = delete;
+
+        auto nanos() const noexcept -> Nanos{
+            return toNanos(calibration_.load(), readTsc());
+        }
+
+        auto timeStr() const noexcept{
+            return time_str_.load();
+        }
+
+        // TSC value the clock would have read at nanos, e.g. to line a kernel timestamp up with readTsc() stamps.
+        auto nanosToTsc(Nanos nanos) const noexcept -> uint64_t{
+            const auto calibration = calibration_.load();
+            return calibration.base_tsc_ + static_cast<uint64_t>((static_cast<int128_t>(nanos - calibration.base_nanos_) << 32) / calibration.mult_);
+        }
+
+        // Length of a TSC interval, for latencies measured as the difference of two readTsc() values.
+        auto ticksToNanos(int64_t ticks) const noexcept -> Nanos{
+            return static_cast<Nanos>((static_cast<int128_t>(ticks) * calibration_.load().mult_) >> 32);
         }
+    };
+
+    // Started on first use: calibrates for a few milliseconds, then keeps a thread that re-syncs every second.
+    // Never destroyed, so threads that log during static destruction still have a clock.
+    inline auto timeService() noexcept -> TimeService&{
+        static auto time_service = new TimeService();
+        return *time_service;
+    }
+
+    inline auto getCurrentNanos() noexcept -> Nanos{
+        return timeService().nanos();
+    }
+
+    inline auto nanosToTsc(Nanos nanos) noexcept -> uint64_t{
+        return timeService().nanosToTsc(nanos);
+    }
+
+    inline auto ticksToNanos(int64_t ticks) noexcept -> Nanos{
+        return timeService().ticksToNanos(ticks);
+    }
+
+    // Copies the cached string, resolution is one second as it always was with ctime().
+    inline auto& getCurrentTimeStr(std::string* time_str){
+        const auto cached = timeService().timeStr();
+        time_str->assign(cached.str_, cached.len_);
         return *time_str;
     }
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,7 @@
 #ifndef TYPES_H
 #define TYPES_H
 #include <cstdint>
+#include <array>
 #include <limits>
 #include <sstream>
 #include "macros.h"
@@ -86,11 +87,13 @@ struct TradeEngineCfg{
     Qty clip_ = 0;
     double threshold_ = 0;
     RiskCfg risk_cfg_;
+    size_t layers_ = 1;     // price levels quoted per side, one tick apart
     auto toString() const{
         std::stringstream ss;
         ss << "TradeEngineCfg{"
            << "clip:" << qtyToString(clip_) << " "
            << "threshold:" << threshold_ << " "
+           << "layers:" << layers_ << " "
            << "risk:" << risk_cfg_.toString()
            << "}";
         return ss.str();
@@ -163,7 +166,7 @@ inline auto stringToAlgoType(const std::string &str) -> AlgoType{
 }
 
 // Limits and Constraints
-constexpr size_t LOG_QUEUE_SIZE = 8 * 1024 * 1024;
+constexpr size_t LOG_QUEUE_SIZE = 8 * 1024 * 1024; // bytes of binary log records per Logger
 constexpr size_t ME_MAX_TICKERS = 8;
 constexpr size_t ME_MAX_CLIENT_UPDATES = 256 * 1024;
 constexpr size_t ME_MAX_MARKET_UPDATES = 256 * 1024;
@@ -0,0 +1,92 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "macros.h"
+#include "thread_utils.h"
+
+namespace thu{
+    // Runs tasks 0..N-1 on a fixed number of threads, for batches of long independent jobs such as backtests. Each worker
+    // starts with a contiguous block of the task indices, takes the next one from the back of its own deque and, once that
+    // is empty, steals from the front of another worker's, so a few slow tasks do not leave the other threads idle.
+    // A task runs for seconds, so each deque is guarded by a plain mutex.
+    class WorkStealingPool final{
+    private:
+        struct alignas(CACHE_LINE_SIZE) WorkerQueue{
+            std::mutex mutex_;
+            std::deque<size_t> tasks_;
+        };
+
+        const std::string name_;
+        const size_t num_workers_;
+        std::unique_ptr<WorkerQueue[]> queues_;
+
+        auto next(size_t worker, size_t *task) noexcept{
+            {
+                auto &own = queues_[worker];
+                std::lock_guard<std::mutex> lock(own.mutex_);
+                if(!own.tasks_.empty()){
+                    *task = own.tasks_.back();
+                    own.tasks_.pop_back();
+                    return true;
+                }
+            }
+            for(size_t i = 1; i < num_workers_; ++i){
+                auto &victim = queues_[(worker + i) % num_workers_];
+                std::lock_guard<std::mutex> lock(victim.mutex_);
+                if(!victim.tasks_.empty()){
+                    *task = victim.tasks_.front();
+                    victim.tasks_.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        // Threads are named name + worker index and placed by createAndStartThread(-1, ...)
+        WorkStealingPool(size_t num_workers, const std::string &name)
+            : name_(name), num_workers_(num_workers), queues_(std::make_unique<WorkerQueue[]>(num_workers)){
+            ASSERT(num_workers_ > 0, "WorkStealingPool " + name_ + " needs at least one worker.");
+        }
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        auto numWorkers() const noexcept{
+            return num_workers_;
+        }
+
+        // Calls func(task, worker) once for every task < num_tasks and returns when all have run
+        template<typename F>
+        auto run(size_t num_tasks, F &&func) -> void{
+            for(size_t worker = 0; worker < num_workers_; ++worker){
+                auto &queue = queues_[worker];
+                for(size_t task = num_tasks * worker / num_workers_; task < num_tasks * (worker + 1) / num_workers_; ++task){
+                    queue.tasks_.push_front(task);  // lowest index at the back, so each worker starts at its block's beginning
+                }
+            }
+
+            std::vector<std::thread*> threads;
+            for(size_t worker = 0; worker < num_workers_; ++worker){
+                auto thread = createAndStartThread(-1, name_ + std::to_string(worker), [this, worker, &func](){
+                    for(size_t task; next(worker, &task);){
+                        func(task, worker);
+                    }
+                });
+                ASSERT(thread != nullptr, "Failed to start " + name_ + std::to_string(worker) + " thread.");
+                threads.push_back(thread);
+            }
+            for(auto thread : threads){
+                thread->join();
+                delete thread;
+            }
+        }
+    };
+}
+
+#endif
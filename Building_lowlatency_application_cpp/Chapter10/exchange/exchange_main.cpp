@@ -2,6 +2,7 @@
 #include "matcher/matching_engine.h"
 #include "market_data/market_data_publisher.h"
 #include "order_server/order_server.h"
+static constexpr auto LOG_COMPONENT = thu::LogComponent::MAIN;
 thu::Logger *logger = nullptr;
 Exchange::MatchingEngine *matching_engine = nullptr;
 Exchange::MarketDataPublisher *market_data_publisher = nullptr;
@@ -22,6 +23,7 @@ void signal_handler(int){
 }
 
 int main(){
+    thu::setLogLevels(getenv("THU_LOG_LEVELS"));
     logger = new thu::Logger("exchange_main.log");
     std::signal(SIGINT, signal_handler);
     const int sleep_time = 100 * 1000;
@@ -30,28 +32,31 @@ int main(){
     Exchange::MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
 
     std::string time_str;
-    logger->log("%:% %() % Starting Matching Engine...\n",
+    LOG_INFO(*logger, "%:% %() % Starting Matching Engine...\n",
                 __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str));
     matching_engine = new Exchange::MatchingEngine(&client_requests, &client_responses, &market_updates);
     matching_engine->start();
 
+    // THU_SHM_TRANSPORT=1 also offers order sessions and incremental market data over shared memory to clients on this host
+    const bool use_shm = thu::envFlag("THU_SHM_TRANSPORT");
+
     const std::string mkt_pub_iface = "lo";
     const std::string snap_pub_ip = "233.252.14.1", inc_pub_ip = "233.252.14.3";
     const int snap_pub_port = 20000, inc_pub_port = 20001;
-    logger->log("%:% %() % Starting Market Data Publisher...\n",
+    LOG_INFO(*logger, "%:% %() % Starting Market Data Publisher...\n",
                 __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str));
-    market_data_publisher = new Exchange::MarketDataPublisher(&market_updates, mkt_pub_iface, snap_pub_ip, snap_pub_port, inc_pub_ip, inc_pub_port);
+    market_data_publisher = new Exchange::MarketDataPublisher(&market_updates, mkt_pub_iface, snap_pub_ip, snap_pub_port, inc_pub_ip, inc_pub_port, use_shm);
     market_data_publisher->start();
 
     const std::string order_gw_iface = "lo";
     const int order_gw_port = 12345;
-    logger->log("%:% %() % Starting Order Server...\n",
+    LOG_INFO(*logger, "%:% %() % Starting Order Server...\n",
                 __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str));
-    order_server = new Exchange::OrderServer(&client_requests, &client_responses, order_gw_iface, order_gw_port);
+    order_server = new Exchange::OrderServer(&client_requests, &client_responses, order_gw_iface, order_gw_port, use_shm);
     order_server->start();
 
     while(true){
-        logger->log("%:% %() % Sleeping for a few milliseconds...\n",
+        LOG_INFO(*logger, "%:% %() % Sleeping for a few milliseconds...\n",
                     __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str));
         usleep(sleep_time * 1000);
     }
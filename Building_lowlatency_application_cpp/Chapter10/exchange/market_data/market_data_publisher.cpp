@@ -1,20 +1,40 @@
 #include "market_data_publisher.h"
 namespace Exchange{
     auto MarketDataPublisher::run() noexcept ->void{
-        logger_.log("%:% %() %\n",
+        LOG_INFO(logger_, "%:% %() %\n",
                 __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
         while(run_){
-            for(auto market_update = outgoing_md_updates_->getNextToRead(); outgoing_md_updates_->size() && market_update; market_update = outgoing_md_updates_->getNextToRead()){
-                logger_.log("%:% %() % Sending seq:% %\n",
-                            __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), next_inc_seq_num_, market_update->toString());
+            metric_loops_->add();
+            size_t num_updates = 0;
+            for(auto market_update = outgoing_md_updates_->getNextToRead(); market_update; market_update = outgoing_md_updates_->getNextToRead()){
+                LOG_DEBUG(logger_, "%:% %() % Sending seq:% %\n",
+                            __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), next_inc_seq_num_, *market_update);
                 incremental_socket_.send(&next_inc_seq_num_, sizeof(next_inc_seq_num_));
-                incremental_socket_.send(market_update, sizeof(MEMarketUpdate));
+                incremental_socket_.send(&market_update->msg(), sizeof(MEMarketUpdate));
+                if(shm_ring_){
+                    shm_ring_->get()->publish(MDPMarketUpdate{next_inc_seq_num_, market_update->msg()});
+                }
+                if constexpr (PIPELINE_TRACE){
+                    auto trace = market_update->trace_;
+                    trace.stamp(ExchangeHop::MD_SENT);
+                    md_spans_.record(trace);
+                    if(UNLIKELY(md_spans_.reportDue())){
+                        LOG_INFO(logger_, "%:% %() % Order to market data latencies:\n%",
+                                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), md_spans_.toString());
+                    }
+                }
                 outgoing_md_updates_->updateReadIndex();
                 auto next_write = snapshot_md_updates_.getNextToWriteTo();
                 next_write->seq_num_ = next_inc_seq_num_;
-                next_write->me_market_update_ = *market_update;
+                next_write->me_market_update_ = market_update->msg();
                 snapshot_md_updates_.updateWriteIndex();
                 ++next_inc_seq_num_;
+                ++num_updates;
+            }
+            // size() reads the producer's cursor too, so the depth is sampled once per drain
+            if(num_updates){
+                metric_updates_->add(num_updates);
+                metric_update_queue_depth_->set(outgoing_md_updates_->size());
             }
             incremental_socket_.sendAndRecv();
         }
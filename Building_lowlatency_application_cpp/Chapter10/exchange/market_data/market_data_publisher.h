@@ -2,11 +2,15 @@
 #include <functional>
 #include "snapshot_synthesizer.h"
 #include "market_update.h"
+#include "shm_market_data.h"
+#include "order_server/client_request.h"
 #include "common/thread_utils.h"
+#include "common/metrics.h"
 
 namespace Exchange{
 class MarketDataPublisher{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::MD_PUBLISHER;
     size_t next_inc_seq_num_ = 1;
     MEMarketUpdateLFQueue *outgoing_md_updates_ = nullptr;
     MDPMarketUpdateLFQueue snapshot_md_updates_;
@@ -15,9 +19,19 @@ private:
     Logger logger_;
     thu::McastSocket incremental_socket_;
     SnapshotSynthesizer *snapshot_synthesizer_ = nullptr;
+    // incremental stream for co-located clients, next to the multicast one
+    thu::ShmMapping<ShmMarketDataRing> *shm_ring_ = nullptr;
+    // live values for chapter10_stat
+    Metric *metric_loops_ = metrics().counter("md_publisher.loops");
+    Metric *metric_updates_ = metrics().counter("md_publisher.updates");
+    Metric *metric_update_queue_depth_ = metrics().gauge("md_publisher.update_queue_depth");
+    // per update, recorded when it is handed to the multicast socket
+    TraceSpans<ExchangeHop, 2> md_spans_{{{
+        {"match_end->md_sent", ExchangeHop::MATCH_END, ExchangeHop::MD_SENT},
+        {"order_rx->md_sent", ExchangeHop::ORDER_RX, ExchangeHop::MD_SENT}}}};
 public:
     MarketDataPublisher(MEMarketUpdateLFQueue *market_updates, const std::string &iface, const std::string &snapshot_ip, int snapshot_port
-                        , const std::string &incremental_ip, int incremental_port)
+                        , const std::string &incremental_ip, int incremental_port, bool use_shm = false)
                         : outgoing_md_updates_(market_updates), snapshot_md_updates_(ME_MAX_MARKET_UPDATES)
                         , run_(false)
                         , logger_("exchange_market_data_publisher.log")
@@ -27,6 +41,9 @@ public:
                                     "Unable to create incremental mcast socket. error:"+std::string(std::strerror(errno)));
                         
                             snapshot_synthesizer_ = new SnapshotSynthesizer(&snapshot_md_updates_, iface, snapshot_ip, snapshot_port);
+                            if(use_shm){
+                                shm_ring_ = new thu::ShmMapping<ShmMarketDataRing>(SHM_MD_INCREMENTAL_NAME, true);
+                            }
                         }
     auto start(){
         run_ = true;
@@ -43,8 +60,14 @@ public:
         stop();
         using namespace std::literals::chrono_literals;
         std::this_thread::sleep_for(5s);
+        if constexpr (PIPELINE_TRACE){
+            LOG_INFO(logger_, "%:% %() % Order to market data latencies at shutdown:\n%",
+                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), md_spans_.toString());
+        }
         delete snapshot_synthesizer_;
         snapshot_synthesizer_ = nullptr;
+        delete shm_ring_;
+        shm_ring_ = nullptr;
     }
 };
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <sstream>
 #include "common/types.h"
 #include "common/lockfree_queue.h"
+#include "common/pipeline_trace.h"
 using namespace thu;
 namespace Exchange{
 
@@ -75,7 +76,7 @@ struct MDPMarketUpdate{
 };
 #pragma pack(pop)
 
-typedef LFQueue<MEMarketUpdate> MEMarketUpdateLFQueue;
-typedef LFQueue<MDPMarketUpdate> MDPMarketUpdateLFQueue;
+typedef LFQueue<Traced<MEMarketUpdate>, OverflowPolicy::SPIN> MEMarketUpdateLFQueue;
+typedef LFQueue<MDPMarketUpdate, OverflowPolicy::SPIN> MDPMarketUpdateLFQueue;
 
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+#include "common/shm_transport.h"
+#include "market_update.h"
+
+namespace Exchange{
+// The incremental stream for clients co-located with the exchange, in place of the incremental multicast group.
+// Same MDPMarketUpdate sequence numbers, so a reader that gets lapped recovers from the snapshot group as after a drop.
+typedef thu::ShmBroadcastRing<MDPMarketUpdate, ME_MAX_MARKET_UPDATES> ShmMarketDataRing;
+typedef thu::ShmBroadcastReader<MDPMarketUpdate, ME_MAX_MARKET_UPDATES> ShmMarketDataReader;
+constexpr auto SHM_MD_INCREMENTAL_NAME = "md_incremental";
+}
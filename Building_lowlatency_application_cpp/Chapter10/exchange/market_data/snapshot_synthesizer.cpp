@@ -62,8 +62,8 @@ auto SnapshotSynthesizer::publishSnapshot() -> void
 {
     size_t snapshot_size = 0;
     const MDPMarketUpdate start_market_update{snapshot_size++, {MarketUpdateType::SNAPSHOT_START, last_inc_seq_num_}};
-    logger_.log("%:% %() % %\n",
-                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), start_market_update.toString());
+    LOG_DEBUG(logger_, "%:% %() % %\n",
+                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), start_market_update);
     snapshot_socket_.send(&start_market_update, sizeof(MDPMarketUpdate));
 
     for(size_t ticker_id = 0; ticker_id < ticker_orders_.size(); ++ticker_id){
@@ -72,15 +72,15 @@ auto SnapshotSynthesizer::publishSnapshot() -> void
         me_market_update.type_ = MarketUpdateType::CLEAR;
         me_market_update.ticker_id_ = ticker_id;
         const MDPMarketUpdate clear_market_update{snapshot_size++, me_market_update};
-        logger_.log("%:% %() % %\n",
-                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), clear_market_update.toString());
+        LOG_DEBUG(logger_, "%:% %() % %\n",
+                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), clear_market_update);
         snapshot_socket_.send(&clear_market_update, sizeof(MDPMarketUpdate));
 
         for(const auto order : orders){
             if(order){
                 const MDPMarketUpdate market_update{snapshot_size++, *order};
-                logger_.log("%:% %() % %\n",
-                            __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), market_update.toString());
+                LOG_DEBUG(logger_, "%:% %() % %\n",
+                            __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), market_update);
                 snapshot_socket_.send(&market_update, sizeof(MDPMarketUpdate));
                 snapshot_socket_.sendAndRecv();
             }
@@ -88,11 +88,11 @@ auto SnapshotSynthesizer::publishSnapshot() -> void
     }
 
     const MDPMarketUpdate end_market_update{snapshot_size++, {MarketUpdateType::SNAPSHOT_END, last_inc_seq_num_}};
-    logger_.log("%:% %() % %\n",
-                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), end_market_update.toString());
+    LOG_DEBUG(logger_, "%:% %() % %\n",
+                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), end_market_update);
     snapshot_socket_.send(&end_market_update, sizeof(MDPMarketUpdate));
     snapshot_socket_.sendAndRecv();
-    logger_.log("%:% %() % Published snapshot of % orders.\n",
+    LOG_INFO(logger_, "%:% %() % Published snapshot of % orders.\n",
                 __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), snapshot_size-1);
 }
 
@@ -109,15 +109,15 @@ auto SnapshotSynthesizer::stop() -> void
 
 auto SnapshotSynthesizer::run() -> void
 {
-    logger_.log("%:% %() %\n",
+    LOG_INFO(logger_, "%:% %() %\n",
                 __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
     while (run_)
     {
         for (auto market_update = snapshot_md_updates_->getNextToRead();
-             snapshot_md_updates_->size() && market_update; market_update = snapshot_md_updates_->getNextToRead())
+             market_update; market_update = snapshot_md_updates_->getNextToRead())
         {
-            logger_.log("%:% %() % Processing %\n",
-                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), market_update->toString());
+            LOG_DEBUG(logger_, "%:% %() % Processing %\n",
+                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), *market_update);
             addToSnapshot(market_update);
             snapshot_md_updates_->updateReadIndex();
         }
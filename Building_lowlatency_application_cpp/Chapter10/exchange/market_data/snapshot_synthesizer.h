@@ -13,6 +13,7 @@ using namespace thu;
 namespace Exchange{
 class SnapshotSynthesizer{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::MD_PUBLISHER;
     MDPMarketUpdateLFQueue *snapshot_md_updates_ = nullptr;
     Logger logger_;
     volatile bool run_ = false;
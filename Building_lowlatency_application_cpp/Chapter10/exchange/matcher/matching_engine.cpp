@@ -1,10 +1,11 @@
 #include "matching_engine.h"
 namespace Exchange{
-MatchingEngine::MatchingEngine(ClientRequestLFQueue *client_request, ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates)
+MatchingEngine::MatchingEngine(ClientRequestLFQueue *client_request, ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates
+                                , const std::string &log_file_name)
 :   incoming_requests_ (client_request)
     , outgoing_ogw_responses_(client_responses)
     , outgoing_md_updates_(market_updates)
-    , logger_("exchange_matching_engine.log")
+    , logger_(log_file_name)
 {
     for(size_t i = 0; i < ticker_order_book_.size(); ++i){
         ticker_order_book_[i] = new MEOrderBook(i, this, &logger_);
@@ -14,8 +15,10 @@ MatchingEngine::MatchingEngine(ClientRequestLFQueue *client_request, ClientRespo
 MatchingEngine::~MatchingEngine()
 {
     run_ = false;
-    using namespace std::literals::chrono_literals;
-    std::this_thread::sleep_for(1s);
+    if(started_){
+        using namespace std::literals::chrono_literals;
+        std::this_thread::sleep_for(1s);
+    }
     incoming_requests_ = nullptr;
     outgoing_ogw_responses_ = nullptr;
     outgoing_md_updates_ = nullptr;
@@ -27,6 +30,7 @@ MatchingEngine::~MatchingEngine()
 auto MatchingEngine::start() -> void
 {
     run_ = true;
+    started_ = true;
     ASSERT(createAndStartThread(-1, "MatchingEngine", [this](){run();}) != nullptr, "Failed to start MatchingEngine thread.");
 }
 auto MatchingEngine::stop() -> void
@@ -35,23 +39,36 @@ auto MatchingEngine::stop() -> void
 }
 auto MatchingEngine::run() noexcept->void
 {
-    logger_.log("%:% %() %\n",
+    LOG_INFO(logger_, "%:% %() %\n",
                  __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
     while (run_)
     {
-        const auto me_client_request = incoming_requests_->getNextToRead();
-        if(LIKELY(me_client_request)){
-            logger_.log("%:% %() % Processing %\n",
-                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), me_client_request->toString());
-            processClientRequest(me_client_request);
+        metric_loops_->add();
+        size_t num_requests = 0;
+        for(auto me_client_request = incoming_requests_->getNextToRead(); me_client_request; me_client_request = incoming_requests_->getNextToRead()){
+            current_trace_ = me_client_request->trace_;
+            process(me_client_request);
             incoming_requests_->updateReadIndex();
+            ++num_requests;
+        }
+        // size() reads the producer's cursor too, so the depth is sampled once per drain
+        if(num_requests){
+            metric_requests_->add(num_requests);
+            metric_request_queue_depth_->set(incoming_requests_->size());
         }
     }
     
 }
+auto MatchingEngine::process(const MEClientRequest *client_request) noexcept -> void
+{
+    LOG_DEBUG(logger_, "%:% %() % Processing %\n",
+                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), *client_request);
+    current_trace_.stamp(ExchangeHop::MATCH_START);
+    processClientRequest(client_request);
+}
 auto MatchingEngine::processClientRequest(const MEClientRequest *client_request) noexcept -> void
 {
-    auto order_book = ticker_order_book_[client_request->client_id_];
+    auto order_book = ticker_order_book_[client_request->ticker_id_];
     switch (client_request->type_)
     {
     case ClientRequestType::NEW:
@@ -80,18 +97,24 @@ auto MatchingEngine::processClientRequest(const MEClientRequest *client_request)
 }
 auto MatchingEngine::sendClientResponse(const MEClientResponse *client_response) noexcept -> void
 {
-    logger_.log("%:% %() % Sending %\n",
-                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_response->toString());
+    LOG_DEBUG(logger_, "%:% %() % Sending %\n",
+                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), *client_response);
     auto next_write = outgoing_ogw_responses_->getNextToWriteTo();
-    *next_write = std::move(*client_response);
+    *next_write = *client_response;
+    next_write->trace_ = current_trace_;
+    next_write->trace_.stamp(ExchangeHop::MATCH_END);
     outgoing_ogw_responses_->updateWriteIndex();
+    metric_responses_->add();
 }
 auto MatchingEngine::sendMarketUpdate(const MEMarketUpdate *market_update) noexcept -> void
 {
-    logger_.log("%:% %() % Sending %\n",
-                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), market_update->toString());
+    LOG_DEBUG(logger_, "%:% %() % Sending %\n",
+                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), *market_update);
     auto next_write = outgoing_md_updates_->getNextToWriteTo();
     *next_write = *market_update;
+    next_write->trace_ = current_trace_;
+    next_write->trace_.stamp(ExchangeHop::MATCH_END);
     outgoing_md_updates_->updateWriteIndex();
+    metric_market_updates_->add();
 }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "common/lockfree_queue.h"
 #include "common/macros.h"
 #include "common/logging.h"
+#include "common/metrics.h"
 #include "order_server/client_request.h"
 #include "order_server/client_response.h"
 #include "market_data/market_update.h"
@@ -12,7 +13,9 @@ using namespace thu;
 namespace Exchange{
 class MatchingEngine final{
 public:
-    MatchingEngine(ClientRequestLFQueue *client_request, ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates);
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::MATCHER;
+    MatchingEngine(ClientRequestLFQueue *client_request, ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates
+                    , const std::string &log_file_name = "exchange_matching_engine.log");
     ~MatchingEngine();
     auto start()->void;
     auto stop()->void;
@@ -25,6 +28,12 @@ public:
 
     auto sendClientResponse(const MEClientResponse *client_response) noexcept -> void;
     auto sendMarketUpdate(const MEMarketUpdate *market_update) noexcept -> void;
+
+    // Matches one request on the caller's thread, e.g. a backtest driving the engine without start()
+    auto process(const MEClientRequest *client_request) noexcept -> void;
+    auto orderBook(TickerId ticker_id) noexcept{
+        return ticker_order_book_.at(ticker_id);
+    }
 private:
     auto run() noexcept->void;
     auto processClientRequest(const MEClientRequest *client_request) noexcept -> void;
@@ -35,7 +44,16 @@ private:
     ClientResponseLFQueue *outgoing_ogw_responses_ = nullptr;
     MEMarketUpdateLFQueue *outgoing_md_updates_ = nullptr;
     volatile bool run_ = false;
+    bool started_ = false;
     std::string time_str_;
     Logger logger_;
+    // trace of the request being processed, copied into every response and market update it causes
+    TraceStamps current_trace_;
+    // live values for chapter10_stat
+    Metric *metric_loops_ = metrics().counter("matcher.loops");
+    Metric *metric_requests_ = metrics().counter("matcher.requests");
+    Metric *metric_request_queue_depth_ = metrics().gauge("matcher.request_queue_depth");
+    Metric *metric_responses_ = metrics().counter("matcher.responses");
+    Metric *metric_market_updates_ = metrics().counter("matcher.market_updates");
 };
 }
\ No newline at end of file
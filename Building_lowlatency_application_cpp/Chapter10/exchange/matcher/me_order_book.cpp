@@ -2,20 +2,18 @@
 #include "matching_engine.h"
 namespace Exchange{
 MEOrderBook::MEOrderBook(TickerId ticker_id, MatchingEngine *matching_engine, Logger *logger)
-: ticker_id_(ticker_id), matching_engine_(matching_engine), orders_at_price_pool_(ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS), logger_(logger)
+: ticker_id_(ticker_id), matching_engine_(matching_engine), orders_at_price_pool_(ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS, MEMPOOL_HUGEPAGES | MEMPOOL_PREFAULT), logger_(logger)
+, metric_orders_(metrics().gauge("matcher.ticker" + std::to_string(ticker_id) + ".orders"))
 {
 
 }
 
 MEOrderBook::~MEOrderBook()
 {
-    logger_->log("%:% %() % MEOrderBook\n%\n",
+    LOG_DEBUG(*logger_, "%:% %() % MEOrderBook\n%\n",
                     __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), toString(false, true));
     matching_engine_ = nullptr;
     bids_by_price_ = asks_by_price_ = nullptr;
-    for(auto &itr : cid_oid_to_order_){
-        itr.fill(nullptr);
-    }
 }
 auto MEOrderBook::add(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void
 {
@@ -30,6 +28,7 @@ auto MEOrderBook::add(ClientId client_id, OrderId client_order_id, TickerId tick
         market_update_ = {MarketUpdateType::ADD, new_market_order_id, ticker_id, side, price, leaves_qty, priority};
         matching_engine_->sendMarketUpdate(&market_update_);
     }
+    metric_orders_->set(order_pool_.size());
 }
 auto MEOrderBook::addOrder(MEOrder *order) noexcept -> void
 {
@@ -58,7 +57,7 @@ auto MEOrderBook::addOrdersAtPrice(MEOrdersAtPrice *new_orders_at_price) noexcep
     }
     else{
         auto target = best_orders_by_price;
-        bool add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) || (new_orders_at_price->price_ < target->price_));
+        bool add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) || (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
         if(add_after){
             target = target->next_entry_;
             add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) || (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
@@ -111,6 +110,34 @@ auto MEOrderBook::cancel(ClientId client_id, OrderId order_id, TickerId ticker_i
         matching_engine_->sendMarketUpdate(&market_update_);
     }
     matching_engine_->sendClientResponse(&client_response_);
+    metric_orders_->set(order_pool_.size());
+}
+auto MEOrderBook::addImmediateOrCancel(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void
+{
+    const auto new_market_order_id = generateNewMarketOrderId();
+    client_response_ = {ClientResponseType::ACCEPTED, client_id, ticker_id, client_order_id, new_market_order_id, side, price, 0, qty};
+    matching_engine_->sendClientResponse(&client_response_);
+    const auto leaves_qty = checkForMatch(client_id, client_order_id, ticker_id, side, price, qty, new_market_order_id);
+    if(leaves_qty){
+        client_response_ = {ClientResponseType::CANCELED, client_id, ticker_id, client_order_id, new_market_order_id, side, price, Qty_INVALID, leaves_qty};
+        matching_engine_->sendClientResponse(&client_response_);
+    }
+    metric_orders_->set(order_pool_.size());
+}
+auto MEOrderBook::modify(ClientId client_id, OrderId order_id, Qty qty) noexcept -> void
+{
+    auto exchange_order = cid_oid_to_order_.at(client_id).at(order_id);
+    if(UNLIKELY(!exchange_order || exchange_order->qty_ == qty)){
+        return;
+    }
+    if(!qty){
+        cancel(client_id, order_id, exchange_order->ticker_id_);
+        return;
+    }
+    exchange_order->qty_ = qty;
+    market_update_ = {MarketUpdateType::MODIFY, exchange_order->market_order_id_, exchange_order->ticker_id_, exchange_order->side_,
+                        exchange_order->price_, qty, exchange_order->priority_};
+    matching_engine_->sendMarketUpdate(&market_update_);
 }
 auto MEOrderBook::removeOrder(MEOrder *order) noexcept -> void
 {
@@ -2,6 +2,7 @@
 #include "common/types.h"
 #include "common/memory_pool.h"
 #include "common/logging.h"
+#include "common/metrics.h"
 #include "order_server/client_response.h"
 #include "market_data/market_update.h"
 #include "me_order.h"
@@ -10,6 +11,7 @@ namespace Exchange{
 class MatchingEngine;
 class MEOrderBook final{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::MATCHER;
     TickerId ticker_id_ = TickerId_INVALID;
     MatchingEngine *matching_engine_ = nullptr;
     ClientOrderHashMap cid_oid_to_order_;
@@ -23,6 +25,8 @@ private:
     OrderId next_market_order_id_ = 1;
     std::string time_str_;
     Logger *logger_ = nullptr;
+    // orders resting in the book, i.e. order_pool_ occupancy
+    Metric *metric_orders_ = nullptr;
 public:
     MEOrderBook(TickerId ticker_id, MatchingEngine *matching_engine, Logger *logger);
     ~MEOrderBook();
@@ -33,8 +37,11 @@ public:
     MEOrderBook& operator=(const MEOrderBook&) = delete;
     MEOrderBook& operator=(MEOrderBook&&) = delete;
 private:
+    // Ids wrap around ME_MAX_ORDER_IDS, the size of the order id maps on the market data consumer side
     auto generateNewMarketOrderId() noexcept->OrderId{
-        return next_market_order_id_;
+        const auto order_id = next_market_order_id_;
+        next_market_order_id_ = (next_market_order_id_ + 1) % ME_MAX_ORDER_IDS;
+        return order_id;
     }
     auto priceToIndex(Price price) const noexcept{
         return (price % ME_MAX_PRICE_LEVELS);
@@ -54,6 +61,11 @@ public:
     auto addOrder(MEOrder *order) noexcept ->void;
     auto addOrdersAtPrice(MEOrdersAtPrice *new_orders_at_price) noexcept->void;
     auto cancel(ClientId client_id, OrderId order_id, TickerId ticker_id) noexcept -> void;
+    // Matches like add() but never rests, what is left is canceled right away
+    auto addImmediateOrCancel(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void;
+    // Sets the quantity of a resting order in place, keeping its priority. Only a MODIFY market update is published,
+    // it lets a simulator mirror recorded market data into the book.
+    auto modify(ClientId client_id, OrderId order_id, Qty qty) noexcept -> void;
     auto removeOrder(MEOrder *order) noexcept->void;
     auto removeOrdersAtPrice(Side side, Price price) noexcept -> void;
     auto checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, Qty new_market_order_id) noexcept -> Qty;
@@ -2,6 +2,7 @@
 #include <sstream>
 #include "common/types.h"
 #include "common/lockfree_queue.h"
+#include "common/pipeline_trace.h"
 using namespace thu;
 namespace Exchange{
     
@@ -66,5 +67,25 @@ struct OMClientRequest{
 };
 #pragma pack(pop)
 
-typedef LFQueue<MEClientRequest> ClientRequestLFQueue;
+// Hops stamped into an order's TraceStamps on its way through the exchange, see THU_PIPELINE_TRACE.
+// Responses and market updates inherit the trace of the request that caused them.
+enum class ExchangeHop : uint8_t{
+    ORDER_RX = 0,       // OrderServer read it off the TCP socket
+    ORDER_SEQUENCED = 1,// FIFOSequencer published it to the matching engine
+    MATCH_START = 2,    // MatchingEngine dequeued it
+    MATCH_END = 3,      // MatchingEngine enqueued a response or market update for it
+    ACK_SENT = 4,       // OrderServer handed the response to the client socket
+    MD_SENT = 5         // MarketDataPublisher handed the update to the multicast socket
+};
+
+// Hops stamped on the trading side, from the market data packet that triggered a decision to the order it produced.
+enum class TradingHop : uint8_t{
+    MD_KERNEL_RX = 0,   // kernel receive timestamp of the multicast packet, lined up with the TSC
+    MD_RX = 1,          // MarketDataConsumer parsed it
+    ENGINE_DEQUEUE = 2, // TradeEngine dequeued the update
+    DECISION = 3,       // the strategy decided to move its orders
+    ORDER_SENT = 4      // OrderGateway handed the request to the TCP socket
+};
+
+typedef LFQueue<Traced<MEClientRequest>, OverflowPolicy::SPIN> ClientRequestLFQueue;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <sstream>
 #include "common/types.h"
 #include "common/lockfree_queue.h"
+#include "common/pipeline_trace.h"
 using namespace thu;
 namespace Exchange{
 
@@ -75,5 +76,5 @@ struct OMClientResponse{
 };
 #pragma pack(pop)
 
-typedef LFQueue<MEClientResponse> ClientResponseLFQueue;
+typedef LFQueue<Traced<MEClientResponse>, OverflowPolicy::SPIN> ClientResponseLFQueue;
 }
\ No newline at end of file
@@ -6,12 +6,13 @@ namespace Exchange{
 constexpr size_t ME_MAX_PENDING_REQUESTS = 1024;
 class FIFOSequencer{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::ORDER_SERVER;
     ClientRequestLFQueue *incoming_requests_ = nullptr;
     std::string time_str_;
     Logger *logger_ = nullptr;
     struct RecvTimeClientRequest{
         Nanos recv_time_ = 0;
-        MEClientRequest request_;
+        Traced<MEClientRequest> request_;
         auto operator<(const RecvTimeClientRequest &rhs) const{
             return (recv_time_ < rhs.recv_time_);
         }
@@ -22,28 +23,50 @@ public:
     FIFOSequencer(ClientRequestLFQueue *client_requests, Logger *logger)
         : incoming_requests_(client_requests), logger_(logger)
         {}
-    auto addClientRequest(Nanos rx_time, const MEClientRequest &request){
+    // rx_tsc is only kept when THU_PIPELINE_TRACE is on
+    auto addClientRequest(Nanos rx_time, uint64_t rx_tsc, const MEClientRequest &request){
         if(pending_size_ >= pending_client_requests_.size()){
             FATAL("Too many pending requests");
         }
-        pending_client_requests_.at(pending_size_++) = std::move(RecvTimeClientRequest{rx_time, request});
+        auto &pending = pending_client_requests_.at(pending_size_++);
+        pending = RecvTimeClientRequest{rx_time, request};
+        pending.request_.trace_.set(ExchangeHop::ORDER_RX, rx_tsc);
     }
+    // Publishes as many pending requests as the matching engine queue has room for, oldest first.
+    // Whatever does not fit stays pending and is retried on the next call instead of spinning on the
+    // queue, so the OrderServer thread keeps draining responses and avoids a deadlock with the engine.
     auto sequenceAndPulish(){
         if(UNLIKELY(!pending_size_)){
             return ;
         }
-        logger_->log("%:% %() % Processing % requests.\n",
+        LOG_DEBUG(*logger_, "%:% %() % Processing % requests.\n",
                 __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), pending_size_);
         std::sort(pending_client_requests_.begin(), pending_client_requests_.begin() + pending_size_);
-        for(size_t i=0; i<pending_size_; ++i){
-            const auto &client_request = pending_client_requests_.at(i);
-            logger_->log("%:% %() % Writing RX: % REQ:% to FIFO.\n",
-                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_request.recv_time_, client_request.request_.toString());
-            auto next_write = incoming_requests_->getNextToWriteTo();
-            *next_write = std::move(client_request.request_);
-            incoming_requests_->updateWriteIndex();        
+        size_t published = 0;
+        while(published < pending_size_){
+            auto slots = incoming_requests_->tryReserve(pending_size_ - published);
+            if(slots.empty()){
+                break;
+            }
+            for(auto &slot : slots){
+                const auto &client_request = pending_client_requests_.at(published++);
+                LOG_DEBUG(*logger_, "%:% %() % Writing RX: % REQ:% to FIFO.\n",
+                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_request.recv_time_, client_request.request_);
+                slot = client_request.request_;
+                slot.trace_.stamp(ExchangeHop::ORDER_SEQUENCED);
+            }
+            incoming_requests_->commit(slots.size());
         }
-        pending_size_ = 0;
+        if(UNLIKELY(published < pending_size_)){
+            LOG_WARN(*logger_, "%:% %() % FIFO full, holding back % requests.\n",
+                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), pending_size_ - published);
+            std::move(pending_client_requests_.begin() + published, pending_client_requests_.begin() + pending_size_, pending_client_requests_.begin());
+        }
+        pending_size_ -= published;
+    }
+
+    auto pendingSize() const noexcept{
+        return pending_size_;
     }
 };
 }
\ No newline at end of file
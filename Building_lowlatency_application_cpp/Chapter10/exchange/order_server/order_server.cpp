@@ -2,13 +2,15 @@
 #include "order_server.h"
 
 namespace Exchange{
-OrderServer::OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, const std::string &iface, int port)
+OrderServer::OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, const std::string &iface, int port
+                        , bool use_shm)
 : iface_(iface), port_(port), outgoing_responses_(client_responses), logger_("exchange_order_server.log"), tcp_server_(logger_),
-fifo_sequencer_(client_requests, &logger_)
+fifo_sequencer_(client_requests, &logger_), use_shm_(use_shm)
 {
     cid_next_outgoing_seq_num_.fill(1);
     cid_next_exp_seq_num_.fill(1);
     cid_tcp_socket_.fill(nullptr);
+    cid_shm_session_.fill(nullptr);
     tcp_server_.recv_callback_ = [this](auto socket, auto rx_time){
         recvCallback(socket, rx_time);
     };
@@ -27,37 +29,36 @@ auto OrderServer::stop() -> void{
 
 auto OrderServer::recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void
 {
-    logger_.log("%:% %() % Received socket:% len:% rx:%\n",
-                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket->fd_, socket->next_rcv_valid_index_, rx_time);
+    LOG_DEBUG(logger_, "%:% %() % Received socket:% len:% rx:%\n",
+                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), socket->fd_, socket->rcv_buffer_.readable(), rx_time);
     
-    if(socket->next_rcv_valid_index_ >= sizeof(OMClientRequest)){
-        size_t i = 0;
-        for(; i+sizeof(OMClientRequest) <= socket->next_rcv_valid_index_; i += sizeof(OMClientRequest)){
-            auto request = reinterpret_cast<const OMClientRequest*>(socket->rcv_buffer_ + i);
-            logger_.log("%:% %() % Received %\n",
-                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
-            
-            if(UNLIKELY(cid_tcp_socket_[request->me_client_request_.client_id_] == nullptr)){
-                cid_tcp_socket_[request->me_client_request_.client_id_] = socket;
-            }
+    const auto rx_tsc = PIPELINE_TRACE ? readTsc() : 0;
+    // parse in place, consume() only moves the read cursor
+    auto &rcv_buffer = socket->rcv_buffer_;
+    for(; rcv_buffer.readable() >= sizeof(OMClientRequest); rcv_buffer.consume(sizeof(OMClientRequest))){
+        auto request = reinterpret_cast<const OMClientRequest*>(rcv_buffer.readPtr());
+        LOG_DEBUG(logger_, "%:% %() % Received %\n",
+                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), *request);
+        
+        if(UNLIKELY(cid_tcp_socket_[request->me_client_request_.client_id_] == nullptr)){
+            cid_tcp_socket_[request->me_client_request_.client_id_] = socket;
+        }
 
-            if(cid_tcp_socket_[request->me_client_request_.client_id_] != socket){
-                logger_.log("%:% %() % Received ClientRequest from ClientId:% on different socket:% expected:%\n",
-                            __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, socket->fd_, cid_tcp_socket_[request->me_client_request_.client_id_]->fd_);
-                continue;
-            }
+        if(cid_tcp_socket_[request->me_client_request_.client_id_] != socket){
+            LOG_ERROR(logger_, "%:% %() % Received ClientRequest from ClientId:% on different socket:% expected:%\n",
+                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, socket->fd_, cid_tcp_socket_[request->me_client_request_.client_id_]->fd_);
+            continue;
+        }
 
-            auto &next_exp_seq_num = cid_next_exp_seq_num_[request->me_client_request_.client_id_];
-            if(request->seq_num_ != next_exp_seq_num){
-                logger_.log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n",
-                            __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, next_exp_seq_num, request->seq_num_);
-                continue;
-            }
-            ++next_exp_seq_num;
-            fifo_sequencer_.addClientRequest(rx_time, request->me_client_request_);
+        auto &next_exp_seq_num = cid_next_exp_seq_num_[request->me_client_request_.client_id_];
+        if(request->seq_num_ != next_exp_seq_num){
+            LOG_ERROR(logger_, "%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n",
+                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), request->me_client_request_.client_id_, next_exp_seq_num, request->seq_num_);
+            continue;
         }
-        memcpy(socket->rcv_buffer_, socket->rcv_buffer_ + i, socket->next_rcv_valid_index_ - 1);
-        socket->next_rcv_valid_index_ -= i;
+        ++next_exp_seq_num;
+        metric_requests_->add();
+        fifo_sequencer_.addClientRequest(rx_time, rx_tsc, request->me_client_request_);
     }
 }
 
@@ -66,27 +67,150 @@ auto OrderServer::recvFinishedCallback() noexcept -> void
     fifo_sequencer_.sequenceAndPulish();
 }
 
+// Attaches at most one new session and detaches at most one whose client has gone per SHM_SESSION_SCAN_INTERVAL, then
+// hands the requests of all attached sessions to the FIFO sequencer, as many as it has room for.
+auto OrderServer::pollShmSessions(Nanos now) noexcept -> void
+{
+    if(UNLIKELY(now >= next_shm_scan_time_)){
+        next_shm_scan_time_ = now + SHM_SESSION_SCAN_INTERVAL;
+        const auto client_id = next_shm_scan_client_id_;
+        next_shm_scan_client_id_ = (next_shm_scan_client_id_ + 1) % ME_MAX_NUM_CLIENTS;
+        if(!cid_shm_session_[client_id] && !cid_tcp_socket_[client_id]){
+            auto session = new thu::ShmMapping<ShmOrderSession>(shmOrderSessionName(client_id), false);
+            if(session->get() && !session->get()->closed_.load(std::memory_order_acquire)){
+                session->get()->server_pid_.store(getpid(), std::memory_order_release);
+                cid_shm_session_[client_id] = session;
+                shm_sessions_.emplace_back(client_id, session->get());
+                metric_shm_sessions_->set(shm_sessions_.size());
+                LOG_INFO(logger_, "%:% %() % Attached ClientId:% on %\n", __FILE__, __LINE__, __FUNCTION__,
+                            thu::getCurrentTimeStr(&time_str_), client_id, session->path());
+            }
+            else{
+                delete session;
+            }
+        }
+        if(!shm_sessions_.empty()){
+            next_shm_check_index_ = (next_shm_check_index_ + 1) % shm_sessions_.size();
+            const auto client_id = shm_sessions_[next_shm_check_index_].first;
+            if(UNLIKELY(!cid_shm_session_[client_id]->live())){
+                detachShmSession(client_id, false);
+            }
+        }
+    }
+
+    const auto rx_tsc = PIPELINE_TRACE ? readTsc() : 0;
+    size_t num_requests = 0;
+    for(const auto &[client_id, session] : shm_sessions_){
+        auto &requests = session->requests_;
+        for(auto request = requests.getNextToRead(); request && fifo_sequencer_.pendingSize() < ME_MAX_PENDING_REQUESTS;
+            request = requests.getNextToRead()){
+            if(UNLIKELY(request->client_id_ != client_id)){
+                LOG_ERROR(logger_, "%:% %() % Received ClientRequest from ClientId:% on the session of ClientId:%\n",
+                            __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), request->client_id_, client_id);
+            }
+            else{
+                fifo_sequencer_.addClientRequest(now, rx_tsc, *request);
+                metric_requests_->add();
+                ++num_requests;
+            }
+            requests.updateReadIndex();
+        }
+    }
+    if(num_requests){
+        fifo_sequencer_.sequenceAndPulish();
+    }
+}
+
+// Stops serving client_id's session, close also marks it so neither this nor a later OrderServer attaches it again.
+auto OrderServer::detachShmSession(ClientId client_id, bool close) noexcept -> void
+{
+    auto session = cid_shm_session_[client_id];
+    LOG_INFO(logger_, "%:% %() % % ClientId:% on %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                (close ? "Closed" : "Detached"), client_id, session->path());
+    session->get()->closed_.store(close, std::memory_order_release);
+    session->get()->server_pid_.store(0, std::memory_order_release);
+    delete session;
+    cid_shm_session_[client_id] = nullptr;
+    const auto it = std::find_if(shm_sessions_.begin(), shm_sessions_.end(), [client_id](const auto &attached){ return attached.first == client_id; });
+    *it = shm_sessions_.back();
+    shm_sessions_.pop_back();
+    metric_shm_sessions_->set(shm_sessions_.size());
+}
+
+auto OrderServer::sendResponse(const Traced<MEClientResponse> &client_response) noexcept -> void
+{
+    const auto client_id = client_response.client_id_;
+    if(auto session = cid_shm_session_[client_id]){
+        auto &responses = session->get()->responses_;
+        if(auto next_write = responses.getNextToWriteTo(); LIKELY(next_write)){
+            *next_write = client_response.msg();
+            responses.updateWriteIndex();
+            return;
+        }
+        // The client stopped reading. Waiting for it would hold up every other client's responses, so like a TCP client
+        // whose send buffer overflowed it loses the session, and this response and the ones after it are dropped.
+        LOG_ERROR(logger_, "%:% %() % Response ring of ClientId:% full\n", __FILE__, __LINE__, __FUNCTION__,
+                    thu::getCurrentTimeStr(&time_str_), client_id);
+        metric_shm_full_->add();
+        detachShmSession(client_id, true);
+    }
+    if(UNLIKELY(use_shm_ && !cid_tcp_socket_[client_id])){
+        LOG_WARN(logger_, "%:% %() % Dropping response for detached ClientId:% %\n", __FILE__, __LINE__, __FUNCTION__,
+                    thu::getCurrentTimeStr(&time_str_), client_id, client_response.msg());
+        return;
+    }
+    auto &next_outgoing_seq_num = cid_next_outgoing_seq_num_[client_id];
+    ASSERT(cid_tcp_socket_[client_id] != nullptr, "Dont have a TCPSocket for ClientId:" + std::to_string(client_id));
+    cid_tcp_socket_[client_id]->send(&next_outgoing_seq_num, sizeof(next_outgoing_seq_num));
+    cid_tcp_socket_[client_id]->send(&client_response.msg(), sizeof(MEClientResponse));
+    ++next_outgoing_seq_num;
+}
+
 OrderServer::~OrderServer()
 {
     stop();
     using namespace std::literals::chrono_literals;
     std::this_thread::sleep_for(1s);
+    if constexpr (PIPELINE_TRACE){
+        LOG_INFO(logger_, "%:% %() % Order to ack latencies at shutdown:\n%",
+                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), ack_spans_.toString());
+    }
+    for(auto &session : cid_shm_session_){
+        if(session){
+            session->get()->server_pid_.store(0, std::memory_order_release);
+        }
+        delete session;
+        session = nullptr;
+    }
 }
 auto OrderServer::run()->void{
-    logger_.log("%:% %()  %\n",
+    LOG_DEBUG(logger_, "%:% %()  %\n",
                  __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
     while(run_){
+        metric_loops_->add();
         tcp_server_.poll();
         tcp_server_.sendAndRecv();
-        for(auto client_response = outgoing_responses_->getNextToRead(); outgoing_responses_->size() && client_response; client_response = outgoing_responses_->getNextToRead()){
-            auto &next_outgoing_seq_num = cid_next_outgoing_seq_num_[client_response->client_id_];
-            logger_.log("%:% %() Processing cid:% seq:% %\n",
-                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_response->client_id_, next_outgoing_seq_num, client_response->toString());
-            ASSERT(cid_tcp_socket_[client_response->client_id_] != nullptr, "Dont have a TCPSocket for ClientId:" + std::to_string(client_response->client_id_));
-            cid_tcp_socket_[client_response->client_id_]->send(&next_outgoing_seq_num, sizeof(next_outgoing_seq_num));
-            cid_tcp_socket_[client_response->client_id_]->send(client_response, sizeof(MEClientResponse));
+        if(use_shm_){
+            pollShmSessions(getCurrentNanos());
+        }
+        fifo_sequencer_.sequenceAndPulish(); // retry requests held back by a full FIFO
+        metric_pending_requests_->set(fifo_sequencer_.pendingSize());
+        for(auto client_response = outgoing_responses_->getNextToRead(); client_response; client_response = outgoing_responses_->getNextToRead()){
+            LOG_DEBUG(logger_, "%:% %() % Processing cid:% seq:% %\n",
+                        __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_response->client_id_,
+                        cid_next_outgoing_seq_num_[client_response->client_id_], *client_response);
+            sendResponse(*client_response);
+            if constexpr (PIPELINE_TRACE){
+                auto trace = client_response->trace_;
+                trace.stamp(ExchangeHop::ACK_SENT);
+                ack_spans_.record(trace);
+                if(UNLIKELY(ack_spans_.reportDue())){
+                    LOG_INFO(logger_, "%:% %() % Order to ack latencies:\n%",
+                                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), ack_spans_.toString());
+                }
+            }
             outgoing_responses_->updateReadIndex();
-            ++next_outgoing_seq_num;
+            metric_responses_->add();
         }
     }
 }
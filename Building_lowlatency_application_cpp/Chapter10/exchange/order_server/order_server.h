@@ -3,13 +3,20 @@
 #include "common/thread_utils.h"
 #include "common/macros.h"
 #include "common/tcp_server.h"
+#include "common/metrics.h"
 #include "client_request.h"
 #include "client_response.h"
 #include "fifo_sequencer.h"
+#include "shm_order_session.h"
 
 namespace Exchange{
+// How often the OrderServer looks for a new shared memory session and checks an attached one is still in use, one
+// client id of each per look
+constexpr Nanos SHM_SESSION_SCAN_INTERVAL = 1000 * 1000;
+
 class OrderServer{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::ORDER_SERVER;
     const std::string iface_;
     const int port_ = 0;
     ClientResponseLFQueue *outgoing_responses_ = nullptr;
@@ -21,14 +28,39 @@ private:
     std::array<thu::TCPSocket *, ME_MAX_NUM_CLIENTS> cid_tcp_socket_;
     thu::TCPServer tcp_server_;
     FIFOSequencer fifo_sequencer_;
+    // co-located clients on shared memory sessions, looked for when use_shm_ is set
+    const bool use_shm_;
+    std::array<thu::ShmMapping<ShmOrderSession> *, ME_MAX_NUM_CLIENTS> cid_shm_session_;
+    std::vector<std::pair<ClientId, ShmOrderSession*>> shm_sessions_;    // the attached ones, for polling
+    ClientId next_shm_scan_client_id_ = 0;
+    size_t next_shm_check_index_ = 0;
+    Nanos next_shm_scan_time_ = 0;
+    // live values for chapter10_stat
+    Metric *metric_loops_ = metrics().counter("order_server.loops");
+    Metric *metric_requests_ = metrics().counter("order_server.requests");
+    Metric *metric_responses_ = metrics().counter("order_server.responses");
+    Metric *metric_pending_requests_ = metrics().gauge("order_server.pending_requests");
+    Metric *metric_shm_sessions_ = metrics().gauge("order_server.shm_sessions");
+    Metric *metric_shm_full_ = metrics().counter("order_server.shm_full");  // sessions closed on a full response ring
+    // per response, recorded when it is handed to the client socket
+    TraceSpans<ExchangeHop, 5> ack_spans_{{{
+        {"order_rx->sequenced", ExchangeHop::ORDER_RX, ExchangeHop::ORDER_SEQUENCED},
+        {"sequenced->match_start", ExchangeHop::ORDER_SEQUENCED, ExchangeHop::MATCH_START},
+        {"match_start->match_end", ExchangeHop::MATCH_START, ExchangeHop::MATCH_END},
+        {"match_end->ack_sent", ExchangeHop::MATCH_END, ExchangeHop::ACK_SENT},
+        {"order_rx->ack_sent", ExchangeHop::ORDER_RX, ExchangeHop::ACK_SENT}}}};
 
 public:
-    OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, const std::string &iface, int port);
+    OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, const std::string &iface, int port
+                , bool use_shm = false);
     ~OrderServer();
     auto start() -> void;
     auto stop() -> void;
     auto recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void;
     auto recvFinishedCallback() noexcept -> void;
+    auto pollShmSessions(Nanos now) noexcept -> void;
+    auto detachShmSession(ClientId client_id, bool close) noexcept -> void;
+    auto sendResponse(const Traced<MEClientResponse> &client_response) noexcept -> void;
     auto run() -> void;
 };
 }
\ No newline at end of file
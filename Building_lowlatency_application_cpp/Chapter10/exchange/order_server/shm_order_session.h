@@ -0,0 +1,24 @@
+#pragma once
+#include "common/shm_transport.h"
+#include "client_request.h"
+#include "client_response.h"
+
+namespace Exchange{
+constexpr size_t SHM_SESSION_RING_SIZE = 64 * 1024;
+
+// Order flow of one client co-located with the exchange, in place of its TCP connection. The OrderGateway creates it
+// and writes requests, the OrderServer attaches and writes responses. Both rings are reliable and in order, so unlike
+// OMClientRequest / OMClientResponse the messages carry no sequence numbers.
+// The OrderServer keeps its pid in server_pid_ while it serves the session. It sets closed_ when it gives the session
+// up for good because the client stopped reading responses, and it never attaches a closed session again.
+struct ShmOrderSession{
+    thu::ShmSpscRing<MEClientRequest, SHM_SESSION_RING_SIZE> requests_;
+    thu::ShmSpscRing<MEClientResponse, SHM_SESSION_RING_SIZE> responses_;
+    alignas(CACHE_LINE_SIZE) std::atomic<pid_t> server_pid_ = {0};
+    std::atomic<bool> closed_ = {false};
+};
+
+inline auto shmOrderSessionName(ClientId client_id){
+    return "order_session_" + std::to_string(client_id);
+}
+}
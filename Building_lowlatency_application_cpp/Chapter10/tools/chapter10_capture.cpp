@@ -0,0 +1,103 @@
+#include <iostream>
+#include "exchange/market_data/market_update.h"
+#include "trading/backtest/market_data_file.h"
+#include "trading/market_data/md_capture_file.h"
+
+using namespace thu;
+
+// Reads what recorder_main captured, straight from the mapped capture files.
+// usage: chapter10_capture CAPTURE_FILE                      summary per stream, sequence gaps on the incremental stream
+//        chapter10_capture CAPTURE_FILE dump [FROM_NS] [N]   the decoded updates of N records received at or after FROM_NS
+//        chapter10_capture CAPTURE_FILE md MD_FILE           the incremental stream in sequence order as a backtest_main market data file
+namespace{
+    // Calls func on every market update in the datagram of record
+    template<typename F>
+    auto forEachUpdate(const Trading::MDCaptureRecord &record, F &&func){
+        for(size_t offset = 0; offset + sizeof(Exchange::MDPMarketUpdate) <= record.length_; offset += sizeof(Exchange::MDPMarketUpdate)){
+            Exchange::MDPMarketUpdate update;
+            memcpy(&update, record.data() + offset, sizeof(update));   // datagrams are not padded to the update's alignment
+            func(update);
+        }
+    }
+
+    auto summary(const Trading::MDCaptureReader &reader){
+        std::array<size_t, 2> records = {}, updates = {};
+        size_t bytes = 0, gaps = 0, duplicates = 0, next_seq_num = 0;
+        Nanos first_time = 0, last_time = 0;
+        for(const auto &record : reader){
+            const auto stream = static_cast<size_t>(record.stream_);
+            ++records[stream];
+            bytes += record.length_;
+            first_time = first_time ? first_time : record.rx_time_;
+            last_time = record.rx_time_;
+            forEachUpdate(record, [&](const auto &update){
+                ++updates[stream];
+                if(record.stream_ != Trading::MDCaptureStream::INCREMENTAL){
+                    return;
+                }
+                if(next_seq_num && update.seq_num_ < next_seq_num){
+                    ++duplicates;
+                    return;
+                }
+                gaps += (next_seq_num && update.seq_num_ > next_seq_num);
+                next_seq_num = update.seq_num_ + 1;
+            });
+        }
+        for(const auto stream : {Trading::MDCaptureStream::INCREMENTAL, Trading::MDCaptureStream::SNAPSHOT}){
+            std::cout << Trading::mdCaptureStreamToString(stream) << " datagrams:" << records[static_cast<size_t>(stream)]
+                      << " updates:" << updates[static_cast<size_t>(stream)] << "\n";
+        }
+        std::cout << "segments:" << reader.numSegments() << " bytes:" << bytes << " secs:"
+                  << static_cast<double>(last_time - first_time) / NANOS_TO_SECS << " incremental-gaps:" << gaps
+                  << " incremental-duplicates:" << duplicates << std::endl;
+    }
+
+    auto dump(const Trading::MDCaptureReader &reader, Nanos from, size_t count){
+        for(auto it = reader.seek(from); it != reader.end() && count; ++it, --count){
+            std::cout << it->rx_time_ << " " << Trading::mdCaptureStreamToString(it->stream_) << " len:" << it->length_ << "\n";
+            forEachUpdate(*it, [](const auto &update){
+                std::cout << "    " << update.toString() << "\n";
+            });
+        }
+        std::cout << std::flush;
+    }
+
+    // Sequenced incremental updates only; what the snapshot stream would have recovered across a gap is skipped
+    auto toMarketDataFile(const Trading::MDCaptureReader &reader, const std::string &md_file_name){
+        Trading::MarketDataFileWriter writer(md_file_name);
+        size_t num_updates = 0, next_seq_num = 0;
+        for(const auto &record : reader){
+            if(record.stream_ != Trading::MDCaptureStream::INCREMENTAL){
+                continue;
+            }
+            forEachUpdate(record, [&](const auto &update){
+                if(next_seq_num && update.seq_num_ < next_seq_num){
+                    return;
+                }
+                next_seq_num = update.seq_num_ + 1;
+                writer.write(record.rx_time_, update.me_market_update_);
+                ++num_updates;
+            });
+        }
+        std::cout << "Wrote " << num_updates << " market updates to " << md_file_name << std::endl;
+    }
+}
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "usage: " << argv[0] << " CAPTURE_FILE [dump [FROM_NS] [N] | md MD_FILE]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    const Trading::MDCaptureReader reader(argv[1]);
+    const std::string command = argc > 2 ? argv[2] : "";
+    if(command == "dump"){
+        dump(reader, argc > 3 ? std::atoll(argv[3]) : 0, argc > 4 ? std::atoll(argv[4]) : std::numeric_limits<size_t>::max());
+    }
+    else if(command == "md" && argc > 3){
+        toMarketDataFile(reader, argv[3]);
+    }
+    else{
+        summary(reader);
+    }
+    return EXIT_SUCCESS; // not exit(), the market data file writer flushes when it goes out of scope
+}
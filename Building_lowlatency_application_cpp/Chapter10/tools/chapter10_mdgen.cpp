@@ -0,0 +1,93 @@
+#include <deque>
+#include <iostream>
+#include <random>
+#include "common/logging.h"
+#include "exchange/matcher/matching_engine.h"
+#include "trading/backtest/market_data_file.h"
+
+using namespace thu;
+
+// Writes a synthetic market data file for backtest_main: random clients quote around a random walk fair price per ticker
+// and now and then cross the spread, all matched by an in-process MatchingEngine whose market data is recorded.
+// usage: chapter10_mdgen FILE [num_requests=1000000] [mean_gap_ns=10000] [seed=1]
+namespace{
+    constexpr size_t MDGEN_NUM_CLIENTS = 16;
+    constexpr size_t MDGEN_ORDERS_PER_TICKER = 200;   // resting orders per ticker before the oldest is canceled
+    constexpr Price MDGEN_MIN_PRICE = 50, MDGEN_MAX_PRICE = 200;
+
+    struct RestingOrder{
+        ClientId client_id_;
+        OrderId order_id_;
+    };
+}
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "usage: " << argv[0] << " FILE [num_requests=1000000] [mean_gap_ns=10000] [seed=1]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    setLogLevels("WARN");
+    const std::string file_name = argv[1];
+    const size_t num_requests = argc > 2 ? std::atoll(argv[2]) : 1000000;
+    const double mean_gap = argc > 3 ? std::atof(argv[3]) : 10000;
+    std::mt19937_64 rng(argc > 4 ? std::atoll(argv[4]) : 1);
+
+    Exchange::ClientRequestLFQueue requests(1);
+    Exchange::ClientResponseLFQueue responses(ME_MAX_CLIENT_UPDATES);
+    Exchange::MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+    auto matching_engine = new Exchange::MatchingEngine(&requests, &responses, &market_updates);
+    Trading::MarketDataFileWriter writer(file_name);
+
+    std::array<Price, ME_MAX_TICKERS> fair_price;
+    fair_price.fill((MDGEN_MIN_PRICE + MDGEN_MAX_PRICE) / 2);
+    std::array<std::deque<RestingOrder>, ME_MAX_TICKERS> resting;
+    std::array<OrderId, MDGEN_NUM_CLIENTS> next_order_id = {};
+    std::exponential_distribution<double> gap(1.0 / mean_gap);
+    std::geometric_distribution<int> depth(0.3);
+    std::uniform_real_distribution<double> uniform;
+
+    Nanos now = 0;
+    size_t num_updates = 0;
+    for(size_t i = 0; i < num_requests; ++i){
+        now += static_cast<Nanos>(gap(rng)) + 1;
+        const TickerId ticker_id = rng() % ME_MAX_TICKERS;
+        auto &price = fair_price[ticker_id];
+        if(uniform(rng) < 0.05){
+            price = std::clamp<Price>(price + (rng() % 2 ? 1 : -1), MDGEN_MIN_PRICE + 20, MDGEN_MAX_PRICE - 20);
+        }
+
+        Exchange::MEClientRequest request;
+        if(resting[ticker_id].size() >= MDGEN_ORDERS_PER_TICKER){
+            const auto order = resting[ticker_id].front();
+            resting[ticker_id].pop_front();
+            request = {Exchange::ClientRequestType::CANCEL, order.client_id_, ticker_id, order.order_id_, Side::INVALID, Price_INVALID, Qty_INVALID};
+        }
+        else{
+            const ClientId client_id = rng() % MDGEN_NUM_CLIENTS;
+            const auto side = rng() % 2 ? Side::BUY : Side::SELL;
+            const bool aggressive = uniform(rng) < 0.1;
+            const auto offset = static_cast<Price>(aggressive ? rng() % 3 : depth(rng) + 1);
+            const auto order_price = std::clamp<Price>(side == Side::BUY ? (aggressive ? price + offset : price - offset)
+                                                                         : (aggressive ? price - offset : price + offset),
+                                                       MDGEN_MIN_PRICE, MDGEN_MAX_PRICE);
+            const OrderId order_id = next_order_id[client_id];
+            next_order_id[client_id] = (order_id + 1) % ME_MAX_ORDER_IDS;
+            request = {Exchange::ClientRequestType::NEW, client_id, ticker_id, order_id, side, order_price, static_cast<Qty>(1 + rng() % 100)};
+            resting[ticker_id].push_back({client_id, order_id});
+        }
+        matching_engine->process(&request);
+
+        for(auto response = responses.getNextToRead(); response; response = responses.getNextToRead()){
+            responses.updateReadIndex();
+        }
+        for(auto market_update = market_updates.getNextToRead(); market_update; market_update = market_updates.getNextToRead()){
+            writer.write(now, *market_update);
+            market_updates.updateReadIndex();
+            ++num_updates;
+        }
+    }
+    std::cout << "Wrote " << num_updates << " market updates over " << static_cast<double>(now) / NANOS_TO_SECS << " seconds to "
+              << file_name << std::endl;
+    delete matching_engine;
+    return EXIT_SUCCESS; // not exit(), writer flushes the file when it goes out of scope
+}
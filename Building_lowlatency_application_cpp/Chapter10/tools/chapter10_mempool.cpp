@@ -0,0 +1,111 @@
+#include <iostream>
+#include <thread>
+#include "common/concurrent_memory_pool.h"
+#include "common/lockfree_queue.h"
+#include "common/thread_utils.h"
+#include "common/time_utils.h"
+
+using namespace thu;
+
+// Hands ConcurrentMemPool objects between two threads and checks them on the way: the main thread allocates and the
+// free thread releases, and every 8th object the free thread allocates one itself and sends it back to be freed by the
+// main thread. The pool is far smaller than the number of objects, so slots have to come back through the remote lists,
+// and a slot handed out twice while still live shows up as a sequence mismatch.
+// usage: chapter10_mempool [num_objects=1000000] [pool_size=8192, at least MEMPOOL_MIN_POOL_SIZE=2176]
+namespace{
+    constexpr size_t MEMPOOL_QUEUE_SIZE = 1024;
+    // objects in flight in both queues, plus the magazine each thread may have carved but not handed out yet
+    constexpr size_t MEMPOOL_MIN_POOL_SIZE = 2 * MEMPOOL_QUEUE_SIZE + 2 * CMP_MAGAZINE_SIZE;
+    constexpr uint64_t MEMPOOL_LIVE = 0x4c495645;
+    constexpr uint64_t MEMPOOL_FREED = 0x46524545;
+
+    struct Payload{
+        uint64_t seq_ = 0;
+        uint64_t state_ = 0;
+        char pad_[48] = {};
+
+        Payload(uint64_t seq) : seq_(seq), state_(MEMPOOL_LIVE){}
+    };
+
+    using PayloadPool = ConcurrentMemPool<Payload>;
+    using PayloadQueue = LFQueue<Payload*>;
+
+    auto checkAndFree(PayloadPool &pool, PayloadPool::ThreadCache *cache, Payload *payload, uint64_t expected_seq, const char *who){
+        if(UNLIKELY(payload->state_ != MEMPOOL_LIVE || payload->seq_ != expected_seq)){
+            FATAL(std::string(who) + " got seq:" + std::to_string(payload->seq_) + " state:" + std::to_string(payload->state_) +
+                  " expected seq:" + std::to_string(expected_seq));
+        }
+        payload->state_ = MEMPOOL_FREED;
+        pool.deallocate(cache, payload);
+    }
+}
+
+int main(int argc, char **argv){
+    const uint64_t num_objects = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    const size_t pool_size = argc > 2 ? std::atoll(argv[2]) : 8192;
+    ASSERT(pool_size >= MEMPOOL_MIN_POOL_SIZE, "pool_size must be at least " + std::to_string(MEMPOOL_MIN_POOL_SIZE) +
+                                               " to hold the objects that can be in flight.");
+
+    PayloadPool pool(pool_size);
+    PayloadQueue to_free_thread(MEMPOOL_QUEUE_SIZE), to_main_thread(MEMPOOL_QUEUE_SIZE);
+    std::atomic<size_t> free_thread_remote_frees = {0}, free_thread_allocated = {0};
+
+    auto free_thread = createAndStartThread(-1, "MemPoolFree", [&](){
+        auto cache = pool.registerThread();
+        uint64_t next_seq = 0, next_returned_seq = 0;
+        while(next_seq < num_objects){
+            Payload *payload;
+            if(!to_free_thread.tryPop(payload)){
+                std::this_thread::yield();
+                continue;
+            }
+            checkAndFree(pool, cache, payload, next_seq++, "free thread");
+            if(next_seq % 8 == 0){
+                // the main thread drains this queue while it waits, so waiting here cannot deadlock
+                while(to_main_thread.size() >= to_main_thread.capacity()){
+                    std::this_thread::yield();
+                }
+                *to_main_thread.getNextToWriteTo() = pool.allocate(cache, next_returned_seq++);
+                to_main_thread.updateWriteIndex();
+            }
+        }
+        free_thread_remote_frees = cache->remoteFrees();
+        free_thread_allocated = cache->allocated();
+    });
+    if(!free_thread){
+        FATAL("Failed to start MemPoolFree thread.");
+    }
+
+    auto cache = pool.registerThread();
+    uint64_t next_returned_seq = 0;
+    auto drain = [&](){
+        Payload *payload;
+        while(to_main_thread.tryPop(payload)){
+            checkAndFree(pool, cache, payload, next_returned_seq++, "main thread");
+        }
+    };
+
+    const auto start = getCurrentNanos();
+    for(uint64_t seq = 0; seq < num_objects; ++seq){
+        while(to_free_thread.size() >= to_free_thread.capacity()){
+            drain();
+            std::this_thread::yield();
+        }
+        *to_free_thread.getNextToWriteTo() = pool.allocate(cache, seq);
+        to_free_thread.updateWriteIndex();
+        drain();
+    }
+    free_thread->join();
+    delete free_thread;
+    drain();
+    const auto elapsed = getCurrentNanos() - start;
+
+    if(UNLIKELY(next_returned_seq != num_objects / 8)){
+        FATAL("main thread freed " + std::to_string(next_returned_seq) + " of " + std::to_string(num_objects / 8) + " returned objects");
+    }
+    std::cout << "objects:" << num_objects << " returned:" << next_returned_seq << " pool_size:" << pool.capacity()
+              << " ns/object:" << static_cast<double>(elapsed) / static_cast<double>(num_objects + next_returned_seq) << "\n"
+              << "main allocated:" << cache->allocated() << " remote frees:" << cache->remoteFrees()
+              << " | free thread allocated:" << free_thread_allocated << " remote frees:" << free_thread_remote_frees << std::endl;
+    return 0;
+}
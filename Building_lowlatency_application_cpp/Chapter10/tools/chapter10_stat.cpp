@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <sys/stat.h>
+#include "common/metrics.h"
+
+// Prints the metrics every running chapter10 process publishes under /dev/shm.
+// A process that exited without removing its file, e.g. on a signal, is printed one last time and its file removed.
+// usage: chapter10_stat [interval_ms=1000] [iterations=0, forever]
+namespace{
+    struct MappedMetrics{
+        const thu::MetricsFile *file_ = nullptr;
+        std::map<std::string, int64_t> last_values_;
+    };
+
+    auto mapMetricsFile(const std::string &path) -> const thu::MetricsFile*{
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0){
+            return nullptr;
+        }
+        struct stat st;
+        if(fstat(fd, &st) || static_cast<size_t>(st.st_size) < sizeof(thu::MetricsFile)){
+            close(fd);
+            return nullptr;
+        }
+        auto mem = mmap(nullptr, sizeof(thu::MetricsFile), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(mem == MAP_FAILED){
+            return nullptr;
+        }
+        auto file = static_cast<const thu::MetricsFile*>(mem);
+        if(file->header_.magic_ != thu::METRICS_MAGIC || file->header_.version_ != thu::METRICS_VERSION){
+            munmap(mem, sizeof(thu::MetricsFile));
+            return nullptr;
+        }
+        return file;
+    }
+}
+
+int main(int argc, char **argv){
+    const long interval_ms = argc > 1 ? atol(argv[1]) : 1000;
+    const long iterations = argc > 2 ? atol(argv[2]) : 0;
+    ASSERT(interval_ms > 0, "interval_ms must be positive");
+    const std::string prefix = thu::METRICS_SHM_PREFIX;
+    const auto dir = std::filesystem::path(prefix).parent_path();
+    const auto file_prefix = std::filesystem::path(prefix).filename().string();
+    const double interval_secs = interval_ms / 1000.0;
+
+    std::map<std::string, MappedMetrics> mapped;
+    for(long iteration = 0; !iterations || iteration < iterations; ++iteration){
+        if(iteration){
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        }
+        for(const auto &entry : std::filesystem::directory_iterator(dir)){
+            const auto path = entry.path().string();
+            if(!entry.path().filename().string().starts_with(file_prefix) || mapped.count(path)){
+                continue;
+            }
+            if(auto file = mapMetricsFile(path)){
+                mapped[path].file_ = file;
+            }
+        }
+
+        printf("----\n");
+        for(auto it = mapped.begin(); it != mapped.end();){
+            const auto &path = it->first;
+            auto &metrics = it->second;
+            const auto &header = metrics.file_->header_;
+            const bool alive = !kill(header.pid_, 0) || errno != ESRCH;
+            printf("%s pid:%d%s\n", header.process_, header.pid_, alive ? "" : " (exited)");
+            const auto num_metrics = header.num_metrics_.load(std::memory_order_acquire);
+            for(uint32_t i = 0; i < num_metrics && i < thu::METRICS_MAX; ++i){
+                const auto &metric = metrics.file_->metrics_[i];
+                const std::string name(metric.name_, strnlen(metric.name_, thu::METRIC_NAME_SIZE));
+                const auto value = metric.value();
+                if(metric.type_ == thu::MetricType::COUNTER){
+                    const auto last = metrics.last_values_.find(name);
+                    const auto rate = last == metrics.last_values_.end() ? 0.0 : (value - last->second) / interval_secs;
+                    printf("  %-40s %16ld %14.1f/s\n", name.c_str(), value, rate);
+                }
+                else{
+                    printf("  %-40s %16ld\n", name.c_str(), value);
+                }
+                metrics.last_values_[name] = value;
+            }
+            if(alive){
+                ++it;
+                continue;
+            }
+            munmap(const_cast<thu::MetricsFile*>(metrics.file_), sizeof(thu::MetricsFile));
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            it = mapped.erase(it);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
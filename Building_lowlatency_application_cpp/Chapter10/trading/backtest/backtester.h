@@ -0,0 +1,274 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include "common/logging.h"
+#include "exchange/matcher/matching_engine.h"
+#include "strategy/algo_trade_engine.h"
+#include "market_data_file.h"
+
+namespace Trading{
+// Recorded orders are mirrored into the simulated exchange under this client id
+constexpr ClientId BACKTEST_REPLAY_CLIENT_ID = ME_MAX_NUM_CLIENTS - 1;
+// Most messages handed to the trade engine per poll(), well below its queue sizes
+constexpr size_t BACKTEST_MAX_DELIVERED = TRADE_ENGINE_MAX_CONFLATED;
+
+struct BacktestCfg{
+    Nanos order_latency_ = 0;   // one way between trade engine and exchange, for requests and for responses
+    Nanos md_latency_ = 0;      // from exchange to trade engine for market data
+    bool conflate_md_ = false;
+    std::string fills_file_;    // one csv line per fill when set
+    std::string log_prefix_;    // prepended to the log file names, keeps backtests running side by side apart
+
+    auto toString() const{
+        std::stringstream ss;
+        ss << "BacktestCfg{"
+           << "order-latency:" << order_latency_ << " "
+           << "md-latency:" << md_latency_ << " "
+           << "conflate-md:" << conflate_md_ << " "
+           << "fills-file:" << fills_file_ << " "
+           << "log-prefix:" << log_prefix_
+           << "}";
+        return ss.str();
+    }
+};
+
+struct BacktestResult{
+    size_t md_records_ = 0;     // recorded market updates replayed into the simulated exchange
+    size_t md_updates_ = 0;     // market updates delivered to the trade engine
+    size_t new_orders_ = 0;
+    size_t cancels_ = 0;
+    size_t fills_ = 0;
+    uint64_t fill_qty_ = 0;
+    double pnl_ = 0;            // total over all tickers at the end
+    double max_pnl_ = 0;
+    double max_drawdown_ = 0;   // largest drop of the total PnL from its running maximum
+    Nanos sim_time_ = 0;        // simulated time covered
+    Nanos wall_time_ = 0;
+    std::string positions_;
+
+    auto toString() const{
+        std::stringstream ss;
+        ss << "BacktestResult{"
+           << "md-records:" << md_records_ << " "
+           << "md-updates:" << md_updates_ << " "
+           << "new-orders:" << new_orders_ << " "
+           << "cancels:" << cancels_ << " "
+           << "fills:" << fills_ << " "
+           << "fill-qty:" << fill_qty_ << " "
+           << "pnl:" << pnl_ << " "
+           << "max-pnl:" << max_pnl_ << " "
+           << "max-drawdown:" << max_drawdown_ << " "
+           << "sim-secs:" << static_cast<double>(sim_time_) / NANOS_TO_SECS << " "
+           << "wall-secs:" << static_cast<double>(wall_time_) / NANOS_TO_SECS << " "
+           << "records/sec:" << (wall_time_ ? md_records_ * static_cast<double>(NANOS_TO_SECS) / wall_time_ : 0)
+           << "}\n" << positions_;
+        return ss.str();
+    }
+};
+
+// Runs one AlgoTradeEngine against recorded market data on a single thread and a simulated clock. Nothing sleeps or
+// spins: the clock jumps from one event to the next. A MatchingEngine stands in for the exchange:
+//  - recorded ADD / MODIFY / CANCEL are mirrored into its books, so the strategy's orders queue among the recorded ones
+//  - a recorded TRADE is sent in as an immediate or cancel order of the aggressor, it hits whatever is first in the
+//    simulated book, the strategy's orders included, and the recorded MODIFY / CANCEL that follow restore the book
+// The trade engine sees the simulated exchange's market data and its own responses, each after the configured latency.
+template<TradingAlgo Algo>
+class Backtester final{
+private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::MAIN;
+    template<typename T>
+    struct InFlight{
+        Nanos arrival_time_;
+        T msg_;
+    };
+
+    const MarketDataFile &md_file_;
+    const BacktestCfg cfg_;
+    const ClientId client_id_;
+
+    // simulated exchange, driven through MatchingEngine::process() so exchange_requests_ is never used
+    Exchange::ClientRequestLFQueue exchange_requests_;
+    Exchange::ClientResponseLFQueue exchange_responses_;
+    Exchange::MEMarketUpdateLFQueue exchange_updates_;
+    Exchange::MatchingEngine matching_engine_;
+
+    // trade engine queues, filled right before each poll()
+    Exchange::ClientRequestLFQueue client_requests_;
+    Exchange::ClientResponseLFQueue client_responses_;
+    Exchange::MEMarketUpdateLFQueue client_updates_;
+    AlgoTradeEngine<Algo> trade_engine_;
+
+    // messages on the wire in either direction, in arrival order since each direction has one fixed latency
+    std::deque<InFlight<Exchange::MEClientRequest>> pending_requests_;
+    std::deque<InFlight<Exchange::MEClientResponse>> pending_responses_;
+    std::deque<InFlight<Exchange::MEMarketUpdate>> pending_updates_;
+
+    std::ofstream fills_file_;
+    BacktestResult result_;
+
+    auto replay(const Exchange::MEMarketUpdate &market_update) noexcept{
+        auto order_book = matching_engine_.orderBook(market_update.ticker_id_);
+        const auto order_id = market_update.order_id_ % ME_MAX_ORDER_IDS;
+        switch(market_update.type_){
+        case Exchange::MarketUpdateType::ADD:
+            order_book->add(BACKTEST_REPLAY_CLIENT_ID, order_id, market_update.ticker_id_, market_update.side_, market_update.price_, market_update.qty_);
+            break;
+        case Exchange::MarketUpdateType::MODIFY:
+            order_book->modify(BACKTEST_REPLAY_CLIENT_ID, order_id, market_update.qty_);
+            break;
+        case Exchange::MarketUpdateType::CANCEL:
+            order_book->cancel(BACKTEST_REPLAY_CLIENT_ID, order_id, market_update.ticker_id_);
+            break;
+        case Exchange::MarketUpdateType::TRADE:
+            order_book->addImmediateOrCancel(BACKTEST_REPLAY_CLIENT_ID, OrderId_INVALID, market_update.ticker_id_, market_update.side_,
+                                             market_update.price_, market_update.qty_);
+            break;
+        default: // snapshot markers and CLEAR are not part of the incremental stream
+            break;
+        }
+        ++result_.md_records_;
+    }
+
+    // What the simulated exchange sent at now goes on the wire towards the trade engine
+    auto drainExchange(Nanos now){
+        for(auto client_response = exchange_responses_.getNextToRead(); client_response; client_response = exchange_responses_.getNextToRead()){
+            if(client_response->client_id_ == client_id_){
+                pending_responses_.push_back({now + cfg_.order_latency_, *client_response});
+            }
+            exchange_responses_.updateReadIndex();
+        }
+        for(auto market_update = exchange_updates_.getNextToRead(); market_update; market_update = exchange_updates_.getNextToRead()){
+            pending_updates_.push_back({now + cfg_.md_latency_, *market_update});
+            exchange_updates_.updateReadIndex();
+        }
+    }
+
+    // What the trade engine sent at now goes on the wire towards the exchange
+    auto drainTradeEngine(Nanos now){
+        for(auto client_request = client_requests_.getNextToRead(); client_request; client_request = client_requests_.getNextToRead()){
+            (client_request->type_ == Exchange::ClientRequestType::NEW ? result_.new_orders_ : result_.cancels_) += 1;
+            pending_requests_.push_back({now + cfg_.order_latency_, *client_request});
+            client_requests_.updateReadIndex();
+        }
+    }
+
+    auto onFill(Nanos now, const Exchange::MEClientResponse &client_response){
+        ++result_.fills_;
+        result_.fill_qty_ += client_response.exec_qty_;
+        if(fills_file_.is_open()){
+            fills_file_ << now << ',' << client_response.ticker_id_ << ',' << sideToString(client_response.side_) << ','
+                        << client_response.price_ << ',' << client_response.exec_qty_ << ',' << client_response.leaves_qty_ << ','
+                        << client_response.client_order_id_ << '\n';
+        }
+    }
+
+    auto totalPnl() const noexcept{
+        HalfTicks pnl = 0;
+        for(TickerId i = 0; i < ME_MAX_TICKERS; ++i){
+            pnl += trade_engine_.positionKeeper().getPositionInfo(i)->total_pnl_;
+        }
+        return halfTicksToPnl(pnl);
+    }
+
+    // Hands everything that arrived by now to the trade engine and runs it once. Returns false if nothing had arrived.
+    auto deliver(Nanos now){
+        size_t delivered = 0;
+        for(; delivered < BACKTEST_MAX_DELIVERED && !pending_responses_.empty() && pending_responses_.front().arrival_time_ <= now; ++delivered){
+            const auto &client_response = pending_responses_.front().msg_;
+            if(client_response.type_ == Exchange::ClientResponseType::FILLED){
+                onFill(now, client_response);
+            }
+            *client_responses_.getNextToWriteTo() = client_response;
+            client_responses_.updateWriteIndex();
+            pending_responses_.pop_front();
+        }
+        for(; delivered < BACKTEST_MAX_DELIVERED && !pending_updates_.empty() && pending_updates_.front().arrival_time_ <= now; ++delivered){
+            *client_updates_.getNextToWriteTo() = pending_updates_.front().msg_;
+            client_updates_.updateWriteIndex();
+            pending_updates_.pop_front();
+            ++result_.md_updates_;
+        }
+        if(!delivered){
+            return false;
+        }
+        trade_engine_.poll(now);
+        drainTradeEngine(now);
+
+        const auto pnl = totalPnl();
+        result_.max_pnl_ = std::max(result_.max_pnl_, pnl);
+        result_.max_drawdown_ = std::max(result_.max_drawdown_, result_.max_pnl_ - pnl);
+        return true;
+    }
+
+public:
+    Backtester(const MarketDataFile &md_file, ClientId client_id, const TradeEngineCfgHashMap &ticker_cfg, const BacktestCfg &cfg)
+        : md_file_(md_file), cfg_(cfg), client_id_(client_id)
+        , exchange_requests_(1), exchange_responses_(ME_MAX_CLIENT_UPDATES), exchange_updates_(ME_MAX_MARKET_UPDATES)
+        , matching_engine_(&exchange_requests_, &exchange_responses_, &exchange_updates_, cfg.log_prefix_ + "exchange_matching_engine.log")
+        , client_requests_(ME_MAX_CLIENT_UPDATES), client_responses_(ME_MAX_CLIENT_UPDATES), client_updates_(ME_MAX_MARKET_UPDATES)
+        , trade_engine_(client_id, ticker_cfg, &client_requests_, &client_responses_, &client_updates_, cfg.conflate_md_
+                        , cfg.log_prefix_ + "trading_engine_" + std::to_string(client_id) + ".log")
+    {
+        ASSERT(client_id != BACKTEST_REPLAY_CLIENT_ID, "Client id " + std::to_string(client_id) + " is reserved for the replayed orders.");
+        if(!cfg_.fills_file_.empty()){
+            fills_file_.open(cfg_.fills_file_, std::ios::trunc);
+            ASSERT(fills_file_.good(), "Could not create fills file:" + cfg_.fills_file_);
+            fills_file_ << "time,ticker,side,price,qty,leaves-qty,order-id\n";
+        }
+    }
+
+    Backtester(const Backtester&) = delete;
+    Backtester& operator=(const Backtester&) = delete;
+
+    auto run() -> BacktestResult{
+        const auto wall_start = std::chrono::steady_clock::now();
+        auto record = md_file_.begin();
+        const auto start_time = record != md_file_.end() ? record->time_ : 0;
+        Nanos now = start_time;
+        while(true){
+            auto next = std::numeric_limits<Nanos>::max();
+            if(record != md_file_.end()) next = record->time_;
+            if(!pending_requests_.empty()) next = std::min(next, pending_requests_.front().arrival_time_);
+            if(!pending_responses_.empty()) next = std::min(next, pending_responses_.front().arrival_time_);
+            if(!pending_updates_.empty()) next = std::min(next, pending_updates_.front().arrival_time_);
+            if(next == std::numeric_limits<Nanos>::max()){
+                break;
+            }
+            now = std::max(now, next);
+
+            // exchange side first, so with zero latency the trade engine sees the results at the same time
+            for(; !pending_requests_.empty() && pending_requests_.front().arrival_time_ <= now; pending_requests_.pop_front()){
+                matching_engine_.process(&pending_requests_.front().msg_);
+                drainExchange(now);
+            }
+            for(; record != md_file_.end() && record->time_ <= now; ++record){
+                replay(record->market_update_);
+                drainExchange(now);
+            }
+            while(deliver(now)){
+            }
+        }
+
+        result_.pnl_ = totalPnl();
+        result_.sim_time_ = now - start_time;
+        result_.wall_time_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wall_start).count();
+        result_.positions_ = trade_engine_.positionKeeper().toString();
+        return result_;
+    }
+};
+
+// Backtests the strategy of algo_type, instantiated once at start-up like makeTradeEngine()
+inline auto runBacktest(const MarketDataFile &md_file, ClientId client_id, AlgoType algo_type, const TradeEngineCfgHashMap &ticker_cfg,
+                        const BacktestCfg &cfg) -> BacktestResult{
+    switch(algo_type){
+    case AlgoType::MAKER:
+        return std::make_unique<Backtester<MarketMaker>>(md_file, client_id, ticker_cfg, cfg)->run();
+    case AlgoType::TAKER:
+        return std::make_unique<Backtester<LiquidityTaker>>(md_file, client_id, ticker_cfg, cfg)->run();
+    default:
+        return std::make_unique<Backtester<NoAlgo>>(md_file, client_id, ticker_cfg, cfg)->run();
+    }
+}
+}// end namespace
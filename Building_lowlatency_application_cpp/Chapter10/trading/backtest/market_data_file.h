@@ -0,0 +1,95 @@
+#pragma once
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common/macros.h"
+#include "common/time_utils.h"
+#include "exchange/market_data/market_update.h"
+
+namespace Trading{
+// Market data for backtests: a header followed by fixed size records, one per incremental market update in the order
+// the exchange published them, each with the time it was published.
+constexpr uint64_t MD_FILE_MAGIC = 0x3130444d554854ull; // "THUMD01"
+
+#pragma pack(push, 1)
+struct MDFileHeader{
+    uint64_t magic_ = MD_FILE_MAGIC;
+    uint32_t record_size_ = 0;
+    uint32_t reserved_ = 0;
+};
+
+struct MDFileRecord{
+    Nanos time_ = 0;
+    Exchange::MEMarketUpdate market_update_;
+};
+#pragma pack(pop)
+
+// Appends records, the file is complete once the writer is destroyed
+class MarketDataFileWriter final{
+private:
+    std::ofstream file_;
+
+public:
+    explicit MarketDataFileWriter(const std::string &file_name) : file_(file_name, std::ios::binary | std::ios::trunc){
+        ASSERT(file_.good(), "Could not create market data file:" + file_name);
+        const MDFileHeader header{MD_FILE_MAGIC, sizeof(MDFileRecord), 0};
+        file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    auto write(Nanos time, const Exchange::MEMarketUpdate &market_update){
+        const MDFileRecord record{time, market_update};
+        file_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+};
+
+// The whole file mapped read only, records are used in place. Several backtests can share one mapping.
+class MarketDataFile final{
+private:
+    void *mapping_ = MAP_FAILED;
+    size_t mapped_bytes_ = 0;
+    const MDFileRecord *records_ = nullptr;
+    size_t num_records_ = 0;
+
+public:
+    explicit MarketDataFile(const std::string &file_name){
+        const auto fd = open(file_name.c_str(), O_RDONLY);
+        ASSERT(fd >= 0, "Could not open market data file:" + file_name + " " + std::string(std::strerror(errno)));
+        struct stat st;
+        ASSERT(fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(MDFileHeader), "Not a market data file:" + file_name);
+        mapped_bytes_ = st.st_size;
+        mapping_ = mmap(nullptr, mapped_bytes_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        ASSERT(mapping_ != MAP_FAILED, "Could not map market data file:" + file_name + " " + std::string(std::strerror(errno)));
+
+        const auto header = static_cast<const MDFileHeader*>(mapping_);
+        ASSERT(header->magic_ == MD_FILE_MAGIC && header->record_size_ == sizeof(MDFileRecord),
+                "Not a market data file or written by an incompatible version:" + file_name);
+        records_ = reinterpret_cast<const MDFileRecord*>(static_cast<const char*>(mapping_) + sizeof(MDFileHeader));
+        num_records_ = (mapped_bytes_ - sizeof(MDFileHeader)) / sizeof(MDFileRecord);
+        madvise(mapping_, mapped_bytes_, MADV_SEQUENTIAL);
+    }
+
+    ~MarketDataFile(){
+        if(mapping_ != MAP_FAILED){
+            munmap(mapping_, mapped_bytes_);
+        }
+    }
+
+    MarketDataFile(const MarketDataFile&) = delete;
+    MarketDataFile& operator=(const MarketDataFile&) = delete;
+
+    auto begin() const noexcept{
+        return records_;
+    }
+    auto end() const noexcept{
+        return records_ + num_records_;
+    }
+    auto size() const noexcept{
+        return num_records_;
+    }
+};
+}// end namespace
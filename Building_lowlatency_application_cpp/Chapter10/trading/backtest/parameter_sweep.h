@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <random>
+#include "common/metrics.h"
+#include "common/work_stealing_pool.h"
+#include "backtester.h"
+
+namespace Trading{
+// The TradeEngineCfg values a sweep tries, read from a file with one line per parameter:
+//     <name> <value> [<value> ...]        e.g. "clip 10 20 50"
+//     <name> <first>:<last>:<step>        e.g. "threshold 0.1:0.5:0.1"
+// where name is clip, threshold, max-order-size, max-position, max-loss or layers. Empty lines and lines starting with # are
+// skipped. Every parameter but layers, which defaults to 1, needs at least one value. A combination is applied to all
+// tickers alike.
+class SweepSpec final{
+private:
+    static constexpr std::array<const char*, 6> PARAM_NAMES = {"clip", "threshold", "max-order-size", "max-position", "max-loss", "layers"};
+    std::array<std::vector<double>, PARAM_NAMES.size()> values_ = {{{}, {}, {}, {}, {}, {1}}};
+
+    // index-th combination, the last parameter varies fastest
+    auto combination(size_t index) const noexcept{
+        std::array<double, PARAM_NAMES.size()> params;
+        for(size_t i = PARAM_NAMES.size(); i-- > 0;){
+            params[i] = values_[i][index % values_[i].size()];
+            index /= values_[i].size();
+        }
+        return TradeEngineCfg{static_cast<Qty>(params[0]), params[1], {static_cast<Qty>(params[2]), static_cast<Qty>(params[3]), params[4]},
+                              static_cast<size_t>(params[5])};
+    }
+
+public:
+    explicit SweepSpec(const std::string &file_name){
+        std::ifstream file(file_name);
+        ASSERT(file.good(), "Could not open sweep spec:" + file_name);
+        for(std::string line; std::getline(file, line);){
+            std::istringstream fields(line);
+            std::string name;
+            if(!(fields >> name) || name[0] == '#'){
+                continue;
+            }
+            const auto param = std::find_if(PARAM_NAMES.begin(), PARAM_NAMES.end(), [&name](auto param_name){ return name == param_name; });
+            ASSERT(param != PARAM_NAMES.end(), "Unknown parameter in sweep spec:" + line);
+            auto &values = values_[param - PARAM_NAMES.begin()];
+            values.clear();
+            for(std::string value; fields >> value;){
+                double first, last, step;
+                if(std::sscanf(value.c_str(), "%lf:%lf:%lf", &first, &last, &step) == 3){
+                    ASSERT(step > 0 && first <= last, "Bad range in sweep spec:" + line);
+                    // counted rather than accumulated so 0.1 steps do not drift past last
+                    for(size_t i = 0; first + i * step <= last + step * 1e-9; ++i){
+                        values.push_back(first + i * step);
+                    }
+                }
+                else{
+                    values.push_back(std::atof(value.c_str()));
+                }
+            }
+        }
+        for(size_t i = 0; i < PARAM_NAMES.size(); ++i){
+            ASSERT(!values_[i].empty(), std::string("Sweep spec has no values for ") + PARAM_NAMES[i] + ":" + file_name);
+        }
+        for(const auto layers : values_[5]){
+            ASSERT(layers >= 1 && layers <= OM_MAX_LAYERS, "Sweep spec layers must be 1 to " + std::to_string(OM_MAX_LAYERS) + ":" + file_name);
+        }
+    }
+
+    auto gridSize() const noexcept{
+        size_t size = 1;
+        for(const auto &values : values_){
+            size *= values.size();
+        }
+        return size;
+    }
+
+    // Every combination
+    auto grid() const{
+        std::vector<TradeEngineCfg> cfgs;
+        for(size_t i = 0; i < gridSize(); ++i){
+            cfgs.push_back(combination(i));
+        }
+        return cfgs;
+    }
+
+    // num_samples combinations drawn uniformly, with repeats once num_samples gets close to the grid size
+    auto sample(size_t num_samples, uint64_t seed) const{
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<size_t> pick(0, gridSize() - 1);
+        std::vector<TradeEngineCfg> cfgs;
+        for(size_t i = 0; i < num_samples; ++i){
+            cfgs.push_back(combination(pick(rng)));
+        }
+        return cfgs;
+    }
+};
+
+// Backtests algo_type once per entry of cfgs on num_workers threads, all replaying the one md_file mapping.
+// Each backtest holds its own exchange and trade engine, several hundred MB, so num_workers also bounds the memory used.
+// Logs go to log_dir, prefixed with the job index. Results are in the order of cfgs.
+// Metric updates are single writer, so each worker registers the metrics of its backtests in a private registry of its own.
+inline auto runSweep(const MarketDataFile &md_file, ClientId client_id, AlgoType algo_type, const std::vector<TradeEngineCfg> &cfgs,
+                     const BacktestCfg &cfg, size_t num_workers, const std::string &log_dir) -> std::vector<BacktestResult>{
+    std::filesystem::create_directories(log_dir);
+    std::vector<BacktestResult> results(cfgs.size());
+    std::atomic<size_t> num_done = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::unique_ptr<thu::MetricsRegistry>> worker_metrics;
+    for(size_t i = 0; i < num_workers; ++i){
+        worker_metrics.push_back(std::make_unique<thu::MetricsRegistry>(false));
+    }
+
+    thu::WorkStealingPool pool(num_workers, "Sweep/Worker");
+    pool.run(cfgs.size(), [&](size_t job, size_t worker){
+        thu::ScopedThreadMetrics scoped_metrics(worker_metrics[worker].get());
+        TradeEngineCfgHashMap ticker_cfg;
+        ticker_cfg.fill(cfgs[job]);
+        auto job_cfg = cfg;
+        job_cfg.fills_file_.clear();
+        job_cfg.log_prefix_ = log_dir + "/job_" + std::to_string(job) + "_";
+        results[job] = runBacktest(md_file, client_id, algo_type, ticker_cfg, job_cfg);
+
+        const auto done = ++num_done;
+        if(done % std::max<size_t>(1, cfgs.size() / 100) == 0 || done == cfgs.size()){
+            const auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << ("Sweep " + std::to_string(done) + "/" + std::to_string(cfgs.size()) + " backtests done in " +
+                          std::to_string(secs) + "s\n") << std::flush;
+        }
+    });
+    return results;
+}
+
+// One csv line per backtest: the parameters and what came of them
+inline auto writeSweepResults(const std::string &file_name, const std::vector<TradeEngineCfg> &cfgs, const std::vector<BacktestResult> &results){
+    std::ofstream file(file_name, std::ios::trunc);
+    ASSERT(file.good(), "Could not create sweep results file:" + file_name);
+    file << "job,clip,threshold,max-order-size,max-position,max-loss,layers,pnl,max-pnl,max-drawdown,fills,fill-qty,new-orders,cancels,"
+            "md-updates,wall-secs\n";
+    for(size_t i = 0; i < cfgs.size(); ++i){
+        const auto &cfg = cfgs[i];
+        const auto &result = results[i];
+        file << i << ',' << cfg.clip_ << ',' << cfg.threshold_ << ',' << cfg.risk_cfg_.max_order_size_ << ','
+             << cfg.risk_cfg_.max_position_ << ',' << cfg.risk_cfg_.max_loss_ << ',' << cfg.layers_ << ',' << result.pnl_ << ',' << result.max_pnl_ << ','
+             << result.max_drawdown_ << ',' << result.fills_ << ',' << result.fill_qty_ << ',' << result.new_orders_ << ','
+             << result.cancels_ << ',' << result.md_updates_ << ',' << static_cast<double>(result.wall_time_) / NANOS_TO_SECS << '\n';
+    }
+}
+}// end namespace
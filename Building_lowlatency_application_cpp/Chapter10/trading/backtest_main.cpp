@@ -0,0 +1,55 @@
+#include <iostream>
+#include "backtest/backtester.h"
+#include "common/logging.h"
+#include "common/types.h"
+
+using namespace thu;
+
+// Runs one strategy over a market data file on a simulated clock and prints its fills, PnL and run time.
+// usage: backtest_main MD_FILE CLIENT_ID ALGO ORDER_LATENCY_NS MD_LATENCY_NS [CLIP_1 THRESH_1 MAX_ORDER_SIZE_1 MAX_POS_1 MAX_LOSS_1] ...
+int main(int argc, char **argv){
+    if(argc < 6){
+        std::cerr << "usage: " << argv[0] << " MD_FILE CLIENT_ID ALGO ORDER_LATENCY_NS MD_LATENCY_NS"
+                  << " [CLIP_1 THRESH_1 MAX_ORDER_SIZE_1 MAX_POS_1 MAX_LOSS_1] ..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    // per event logging would dominate the run time, THU_LOG_LEVELS can turn it back on
+    setLogLevels("WARN");
+    setLogLevels(getenv("THU_LOG_LEVELS"));
+
+    const std::string md_file_name = argv[1];
+    const ClientId client_id = atoi(argv[2]);
+    const auto algo_type = stringToAlgoType(argv[3]);
+    Trading::BacktestCfg cfg;
+    cfg.order_latency_ = std::atoll(argv[4]);
+    cfg.md_latency_ = std::atoll(argv[5]);
+    cfg.conflate_md_ = envFlag("THU_CONFLATE_MD");
+    cfg.fills_file_ = "backtest_fills_" + std::to_string(client_id) + ".csv";
+
+    TradeEngineCfgHashMap ticker_cfg;
+    size_t next_ticker_id = 0;
+    for(int i=6; i + 4 < argc; i+=5, ++next_ticker_id){
+        ticker_cfg.at(next_ticker_id) =
+            { static_cast<Qty>(std::atoi(argv[i]))
+            , std::atof(argv[i+1])
+            , { static_cast<Qty>(std::atoi(argv[i+2]))
+              , static_cast<Qty>(std::atoi(argv[i+3]))
+              , std::atof(argv[i+4])
+              }
+            };
+    }
+    // THU_QUOTE_LAYERS=N has the market maker quote N price levels per side instead of one
+    const auto quote_layers_env = getenv("THU_QUOTE_LAYERS");
+    const size_t quote_layers = (quote_layers_env && *quote_layers_env) ? std::atoll(quote_layers_env) : 1;
+    ASSERT(quote_layers >= 1 && quote_layers <= Trading::OM_MAX_LAYERS, "THU_QUOTE_LAYERS must be 1 to " + std::to_string(Trading::OM_MAX_LAYERS));
+    for(auto &ticker : ticker_cfg){
+        ticker.layers_ = quote_layers;
+    }
+
+    const Trading::MarketDataFile md_file(md_file_name);
+    std::cout << "Backtesting " << algoTypeToString(algo_type) << " client:" << client_id << " over " << md_file.size()
+              << " market updates from " << md_file_name << " " << cfg.toString() << std::endl;
+    const auto result = Trading::runBacktest(md_file, client_id, algo_type, ticker_cfg, cfg);
+    std::cout << result.toString() << "Fills written to " << cfg.fills_file_ << std::endl;
+    exit(EXIT_SUCCESS);
+}
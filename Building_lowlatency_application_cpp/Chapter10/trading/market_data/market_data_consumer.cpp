@@ -1,6 +1,6 @@
 #include "market_data_consumer.h"
 namespace Trading{
-    MarketDataConsumer::MarketDataConsumer(thu::ClientId client_id, Exchange::MEMarketUpdateLFQueue *market_updates, const std::string &iface, const std::string &snapshot_ip, int snapshot_port, const std::string &incremental_ip, int incremental_port)
+    MarketDataConsumer::MarketDataConsumer(thu::ClientId client_id, Exchange::MEMarketUpdateLFQueue *market_updates, const std::string &iface, const std::string &snapshot_ip, int snapshot_port, const std::string &incremental_ip, int incremental_port, bool use_shm)
         : incoming_md_updates_(market_updates)
         , run_(false)
         , logger_("trading_market_data_consumer_" + std::to_string(client_id) + ".log")
@@ -9,14 +9,17 @@ namespace Trading{
         , iface_(iface)
         , snapshot_ip_(snapshot_ip)
         , snapshot_port_(snapshot_port)
+        , use_shm_(use_shm)
     {
-        auto recv_callback = [this](auto socket){
-            recvCallback(socket);
+        auto recv_callback = [this](auto socket, auto rx_time){
+            recvCallback(socket, rx_time);
         };
-        incremental_mcast_socket_.recv_callback_ = recv_callback;
-        ASSERT(incremental_mcast_socket_.init(incremental_ip, iface, incremental_port, true) >= 0, "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
-        ASSERT(incremental_mcast_socket_.join(incremental_ip /*, iface, incremental_port*/), 
-                    "join failed on:"+std::to_string(incremental_mcast_socket_.socket_fd_) + "error:" + std::string(std::strerror(errno)));
+        if(!use_shm){
+            incremental_mcast_socket_.recv_callback_ = recv_callback;
+            ASSERT(incremental_mcast_socket_.init(incremental_ip, iface, incremental_port, true) >= 0, "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
+            ASSERT(incremental_mcast_socket_.join(incremental_ip /*, iface, incremental_port*/), 
+                        "join failed on:"+std::to_string(incremental_mcast_socket_.socket_fd_) + "error:" + std::string(std::strerror(errno)));
+        }
         snapshot_mcast_socket_.recv_callback_ = recv_callback;            
     }
 
@@ -25,6 +28,10 @@ namespace Trading{
         stop();
         using namespace std::literals::chrono_literals;
         std::this_thread::sleep_for(5s);
+        delete shm_reader_;
+        shm_reader_ = nullptr;
+        delete shm_ring_;
+        shm_ring_ = nullptr;
     }
 
     auto MarketDataConsumer::start()->void{
@@ -37,53 +44,128 @@ namespace Trading{
     }
 
     auto MarketDataConsumer::run()noexcept->void{
-        logger_.log("%:% %() %\n", __FILE__, __LINE__,
+        LOG_INFO(logger_, "%:% %() %\n", __FILE__, __LINE__,
                     __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
         while(run_){
-            incremental_mcast_socket_.sendAndRecv();
+            metric_loops_->add();
+            if(use_shm_){
+                if(const auto now = getCurrentNanos(); UNLIKELY(now >= next_shm_check_time_)){
+                    next_shm_check_time_ = now + MD_SHM_CHECK_INTERVAL;
+                    checkShm();
+                }
+                if(shm_reader_){
+                    recvShm();
+                }
+            }
+            else{
+                incremental_mcast_socket_.sendAndRecv();
+            }
             snapshot_mcast_socket_.sendAndRecv();
         }
     }
-    auto MarketDataConsumer::recvCallback(thu::McastSocket *socket) noexcept -> void
+    auto MarketDataConsumer::recvCallback(thu::McastSocket *socket, Nanos rx_time) noexcept -> void
     {
+        const auto rx_tsc = PIPELINE_TRACE ? readTsc() : 0;
+        const auto kernel_rx_tsc = (PIPELINE_TRACE && rx_time) ? nanosToTsc(rx_time) : 0;
         const auto is_snapshot = (socket->socket_fd_ == snapshot_mcast_socket_.socket_fd_);
         if(UNLIKELY(is_snapshot && !in_recovery_)){
-            socket->next_rcv_valid_index_ = 0;
-            logger_.log("%:% %() % WARN Not expecting snapshot messages.\n",
+            socket->inbound_data_.clear();
+            LOG_WARN(logger_, "%:% %() % WARN Not expecting snapshot messages.\n",
                         __FILE__, __LINE__, __FUNCTION__,
                         thu::getCurrentTimeStr(&time_str_));
             return ;
         }
-        if(socket->next_rcv_valid_index_ >= sizeof(Exchange::MDPMarketUpdate)){
-            size_t i = 0;
-            for(; i + sizeof(Exchange::MDPMarketUpdate) <= socket->next_rcv_valid_index_; i += sizeof(Exchange::MDPMarketUpdate)){
-                auto request = reinterpret_cast<const Exchange::MDPMarketUpdate *>(socket->inbound_data_.data() + i);
-                logger_.log("%:% %() % Received % socket len:% %\n", __FILE__, __LINE__, __FUNCTION__,
-                            thu::getCurrentTimeStr(&time_str_),
-                            (is_snapshot ? "snapshot" : "incremental"), sizeof(Exchange::MDPMarketUpdate), request->toString());
-                const bool already_in_recovery = in_recovery_;
-                in_recovery_ = (already_in_recovery || request->seq_num_ != next_exp_inc_seq_num_);
-                if(UNLIKELY(in_recovery_)){
-                    if(UNLIKELY(!already_in_recovery)){
-                        logger_.log("%:% %() % Packet drops on % socket.SeqNum expected : % received : %\n ",
-                                    __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), (is_snapshot ? "snapshot" : "incremental"),
-                                    next_exp_inc_seq_num_, request->seq_num_);
-                        startSnapshotSync();
-                    }
-                    queueMessage(is_snapshot, request);
-                }
-                else if(!is_snapshot){
-                    logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__,
-                                thu::getCurrentTimeStr(&time_str_), request->toString());
-                    ++next_exp_inc_seq_num_;
-                    auto next_write = incoming_md_updates_->getNextToWriteTo();
-                    *next_write = std::move(request->me_market_update_);
-                    incoming_md_updates_->updateWriteIndex();
-                }
+        // parse in place, consume() only moves the read cursor
+        auto &inbound_data = socket->inbound_data_;
+        for(; inbound_data.readable() >= sizeof(Exchange::MDPMarketUpdate); inbound_data.consume(sizeof(Exchange::MDPMarketUpdate))){
+            auto request = reinterpret_cast<const Exchange::MDPMarketUpdate *>(inbound_data.readPtr());
+            LOG_DEBUG(logger_, "%:% %() % Received % socket len:% %\n", __FILE__, __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_),
+                        (is_snapshot ? "snapshot" : "incremental"), sizeof(Exchange::MDPMarketUpdate), *request);
+            onMarketUpdate(is_snapshot, request, kernel_rx_tsc, rx_tsc);
+        }
+    }
+
+    // Drains the shared memory ring. Being lapped is a drop like any other: the next update read is ahead of
+    // next_exp_inc_seq_num_ and onMarketUpdate() starts the snapshot recovery.
+    auto MarketDataConsumer::recvShm() noexcept -> void
+    {
+        Exchange::MDPMarketUpdate request;
+        for(auto result = shm_reader_->tryRead(&request); result != thu::ShmReadResult::EMPTY; result = shm_reader_->tryRead(&request)){
+            if(UNLIKELY(result == thu::ShmReadResult::LAPPED)){
+                LOG_WARN(logger_, "%:% %() % Lapped on the shared memory ring after seq:%\n", __FILE__, __LINE__, __FUNCTION__,
+                            thu::getCurrentTimeStr(&time_str_), next_exp_inc_seq_num_ - 1);
+                metric_shm_lapped_->add();
+                continue;
+            }
+            LOG_DEBUG(logger_, "%:% %() % Received shared memory %\n", __FILE__, __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_), request);
+            onMarketUpdate(false, &request, 0, PIPELINE_TRACE ? readTsc() : 0);
+        }
+    }
+
+    // Attaches to the exchange's ring, and drops it again once the exchange has gone, e.g. to attach the ring of a restarted
+    // one. What was published while no ring was read is lost, so after the first update has been seen a new attachment
+    // always goes through snapshot recovery, even if the sequence numbers of the new ring happen to line up.
+    auto MarketDataConsumer::checkShm() noexcept -> void
+    {
+        if(shm_ring_){
+            if(LIKELY(shm_ring_->live())){
+                return;
             }
+            LOG_WARN(logger_, "%:% %() % Shared memory market data at % is gone after seq:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_), shm_ring_->path(), next_exp_inc_seq_num_ - 1);
+            delete shm_reader_;
+            shm_reader_ = nullptr;
+            delete shm_ring_;
+            shm_ring_ = nullptr;
+        }
+        auto ring = new thu::ShmMapping<Exchange::ShmMarketDataRing>(Exchange::SHM_MD_INCREMENTAL_NAME, false);
+        if(!ring->get()){
+            delete ring;
+            return;
+        }
+        shm_ring_ = ring;
+        shm_reader_ = new Exchange::ShmMarketDataReader(shm_ring_->get());
+        LOG_INFO(logger_, "%:% %() % Reading shared memory market data at %\n", __FILE__, __LINE__, __FUNCTION__,
+                    thu::getCurrentTimeStr(&time_str_), shm_ring_->path());
+        if(next_exp_inc_seq_num_ != 1 && !in_recovery_){
+            LOG_WARN(logger_, "%:% %() % Recovering from snapshot, the stream was not read after seq:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_), next_exp_inc_seq_num_ - 1);
+            in_recovery_ = true;
+            metric_gaps_->add();
+            metric_in_recovery_->set(1);
+            startSnapshotSync();
+        }
+    }
 
-            memcpy(socket->inbound_data_.data(), socket->inbound_data_.data() + i, socket->next_rcv_valid_index_ - i);
-            socket->next_rcv_valid_index_ -= i;
+    auto MarketDataConsumer::onMarketUpdate(bool is_snapshot, const Exchange::MDPMarketUpdate *request, uint64_t kernel_rx_tsc, uint64_t rx_tsc) noexcept -> void
+    {
+        {
+            const bool already_in_recovery = in_recovery_;
+            in_recovery_ = (already_in_recovery || request->seq_num_ != next_exp_inc_seq_num_);
+            if(UNLIKELY(in_recovery_)){
+                if(UNLIKELY(!already_in_recovery)){
+                    LOG_WARN(logger_, "%:% %() % Packet drops on % socket.SeqNum expected : % received : %\n ",
+                                __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), (is_snapshot ? "snapshot" : "incremental"),
+                                next_exp_inc_seq_num_, request->seq_num_);
+                    metric_gaps_->add();
+                    metric_in_recovery_->set(1);
+                    startSnapshotSync();
+                }
+                queueMessage(is_snapshot, request);
+            }
+            else if(!is_snapshot){
+                LOG_DEBUG(logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__,
+                            thu::getCurrentTimeStr(&time_str_), *request);
+                ++next_exp_inc_seq_num_;
+                auto next_write = incoming_md_updates_->getNextToWriteTo();
+                *next_write = request->me_market_update_;
+                next_write->trace_.set(Exchange::TradingHop::MD_KERNEL_RX, kernel_rx_tsc);
+                next_write->trace_.set(Exchange::TradingHop::MD_RX, rx_tsc);
+                incoming_md_updates_->updateWriteIndex();
+                metric_updates_->add();
+            }
         }
     }
     auto MarketDataConsumer::startSnapshotSync() -> void
@@ -97,8 +179,8 @@ namespace Trading{
     {
         if(is_snapshot){
             if(snapshot_queued_msgs_.find(request->seq_num_) != snapshot_queued_msgs_.end()){
-                logger_.log("%:% %() % Packet drops on snapshot socket. Received for a 2nd time:%\n"
-                    , __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), request->toString());
+                LOG_WARN(logger_, "%:% %() % Packet drops on snapshot socket. Received for a 2nd time:%\n"
+                    , __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), *request);
                 snapshot_queued_msgs_.clear();
             }
             snapshot_queued_msgs_[request->seq_num_] = request->me_market_update_;
@@ -106,12 +188,12 @@ namespace Trading{
         else{
             snapshot_queued_msgs_[request->seq_num_] = request->me_market_update_;
         }
-        logger_.log("%:% %() % size snapshot:% incremental:% % \
+        LOG_DEBUG(logger_, "%:% %() % size snapshot:% incremental:% % \
                     = > %\n ", __FILE__, __LINE__, __FUNCTION__,
                     thu::getCurrentTimeStr(&time_str_),
                     snapshot_queued_msgs_.size(),
                     incremental_queued_msgs_.size(),
-                    request->seq_num_, request->toString());
+                    request->seq_num_, *request);
         checkSnapshotSync();
     }
     auto MarketDataConsumer::checkSnapshotSync() -> void
@@ -121,7 +203,7 @@ namespace Trading{
         }
         const auto &first_snapshot_msg = snapshot_queued_msgs_.begin()->second;
         if(first_snapshot_msg.type_ != Exchange::MarketUpdateType::SNAPSHOT_START){
-            logger_.log("%:% %() % Returning because have not\
+            LOG_DEBUG(logger_, "%:% %() % Returning because have not\
                      seen a SNAPSHOT_START yet.\n",
                   __FILE__, __LINE__, __FUNCTION__,
                     thu::getCurrentTimeStr(&time_str_));
@@ -134,16 +216,16 @@ namespace Trading{
         auto have_complete_snapshot = true;
         size_t next_snapshot_seq = 0;
         for(auto &snapshot_itr : snapshot_queued_msgs_){
-            logger_.log("%:% %() % % => %\n", __FILE__, __LINE__,
+            LOG_DEBUG(logger_, "%:% %() % % => %\n", __FILE__, __LINE__,
                         __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
                         snapshot_itr.first,
-                        snapshot_itr.second.toString());
+                        snapshot_itr.second);
             if(snapshot_itr.first != next_snapshot_seq){
                 have_complete_snapshot = false;
-                logger_.log("%:% %() % Detected gap in snapshot \
+                LOG_WARN(logger_, "%:% %() % Detected gap in snapshot \
                         stream expected:% found:% %.\n", __FILE__,
                         __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                        next_snapshot_seq, snapshot_itr.first, snapshot_itr.second.toString());
+                        next_snapshot_seq, snapshot_itr.first, snapshot_itr.second);
                 break;
             }
             if(snapshot_itr.second.type_ != Exchange::MarketUpdateType::SNAPSHOT_START 
@@ -152,7 +234,7 @@ namespace Trading{
                 ++next_snapshot_seq;
             }
             if(!have_complete_snapshot){
-                logger_.log("%:% %() % Returning because found gaps in snapshot stream.\n",
+                LOG_DEBUG(logger_, "%:% %() % Returning because found gaps in snapshot stream.\n",
                             __FILE__, __LINE__, __FUNCTION__,
                             thu::getCurrentTimeStr(&time_str_));
                 snapshot_queued_msgs_.clear();
@@ -160,7 +242,7 @@ namespace Trading{
             }
             const auto &last_snapshot_msg = snapshot_queued_msgs_.rbegin()->second;
             if(last_snapshot_msg.type_ != Exchange::MarketUpdateType::SNAPSHOT_END){
-                logger_.log("%:% %() % Returning because have not seen a SNAPSHOT_END yet.\n",
+                LOG_DEBUG(logger_, "%:% %() % Returning because have not seen a SNAPSHOT_END yet.\n",
                             __FILE__, __LINE__, __FUNCTION__,
                             thu::getCurrentTimeStr(&time_str_));
                 return;
@@ -170,20 +252,20 @@ namespace Trading{
             next_exp_inc_seq_num_ = last_snapshot_msg.order_id_ + 1;
 
             for(auto inc_itr = incremental_queued_msgs_.begin(); inc_itr != incremental_queued_msgs_.end(); ++inc_itr){
-                logger_.log("%:% %() % Checking next_exp:% vs. seq:% %.\n", __FILE__, __LINE__, __FUNCTION__,
-                            thu::getCurrentTimeStr(&time_str_), next_exp_inc_seq_num_, inc_itr->first, inc_itr->second.toString());
+                LOG_DEBUG(logger_, "%:% %() % Checking next_exp:% vs. seq:% %.\n", __FILE__, __LINE__, __FUNCTION__,
+                            thu::getCurrentTimeStr(&time_str_), next_exp_inc_seq_num_, inc_itr->first, inc_itr->second);
                 if(inc_itr->first < next_exp_inc_seq_num_){
                     continue;
                 }
                 if(inc_itr->first != next_exp_inc_seq_num_){
-                    logger_.log("%:% %() % Detected gap in incremental stream expected:% found:% %.\n", __FILE__,
+                    LOG_WARN(logger_, "%:% %() % Detected gap in incremental stream expected:% found:% %.\n", __FILE__,
                         __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                        next_exp_inc_seq_num_, inc_itr->first, inc_itr->second.toString());
+                        next_exp_inc_seq_num_, inc_itr->first, inc_itr->second);
                     have_complete_incremental = false;
                     break;
                 }
-                logger_.log("%:% %() % % => %\n", __FILE__, __LINE__, __FUNCTION__,
-                            thu::getCurrentTimeStr(&time_str_),inc_itr->first, inc_itr->second.toString());
+                LOG_DEBUG(logger_, "%:% %() % % => %\n", __FILE__, __LINE__, __FUNCTION__,
+                            thu::getCurrentTimeStr(&time_str_),inc_itr->first, inc_itr->second);
                 if(inc_itr->second.type_ != Exchange::MarketUpdateType::SNAPSHOT_START && inc_itr->second.type_ != Exchange::MarketUpdateType::SNAPSHOT_END){
                     final_events.push_back(inc_itr->second);
                 }
@@ -192,7 +274,7 @@ namespace Trading{
             }
 
             if(!have_complete_incremental){
-                logger_.log("%:% %() % Returning because have gaps in queued incrementals.\n",
+                LOG_DEBUG(logger_, "%:% %() % Returning because have gaps in queued incrementals.\n",
                             __FILE__, __LINE__, __FUNCTION__,
                             thu::getCurrentTimeStr(&time_str_));
                 snapshot_queued_msgs_.clear();
@@ -205,11 +287,12 @@ namespace Trading{
                 incoming_md_updates_->updateWriteIndex();
             }
 
-            logger_.log("%:% %() % Recovered % snapshot and % incremental orders.\n", __FILE__, __LINE__, __FUNCTION__,
+            LOG_INFO(logger_, "%:% %() % Recovered % snapshot and % incremental orders.\n", __FILE__, __LINE__, __FUNCTION__,
                         thu::getCurrentTimeStr(&time_str_), snapshot_queued_msgs_.size() - 2, num_incrementals);
             snapshot_queued_msgs_.clear();
             incremental_queued_msgs_.clear();
             in_recovery_ = false;
+            metric_in_recovery_->set(0);
             snapshot_mcast_socket_.leave(snapshot_ip_, snapshot_port_);
         }
     }
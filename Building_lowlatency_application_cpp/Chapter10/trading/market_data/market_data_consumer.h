@@ -5,10 +5,17 @@
 #include "common/lockfree_queue.h"
 #include "common/macros.h"
 #include "common/mcast_socket.h"
+#include "common/metrics.h"
 #include "exchange/market_data/market_update.h"
+#include "exchange/market_data/shm_market_data.h"
+#include "exchange/order_server/client_request.h"
 namespace Trading{
+// How often the MarketDataConsumer checks the shared memory ring it reads is still the exchange's, or looks for one
+constexpr Nanos MD_SHM_CHECK_INTERVAL = 100 * 1000 * 1000;
+
 class MarketDataConsumer{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::MD_CONSUMER;
     size_t next_exp_inc_seq_num_ = 1;
     Exchange::MEMarketUpdateLFQueue *incoming_md_updates_ = nullptr;
     volatile bool run_ = false;
@@ -20,14 +27,28 @@ private:
     const int snapshot_port_;
     typedef std::map<size_t, Exchange::MEMarketUpdate> QueuedMarketUpdates;
     QueuedMarketUpdates snapshot_queued_msgs_, incremental_queued_msgs_;
+    // incremental stream from shared memory in place of incremental_mcast_socket_, when the exchange runs on the same host
+    const bool use_shm_;
+    thu::ShmMapping<Exchange::ShmMarketDataRing> *shm_ring_ = nullptr;
+    Exchange::ShmMarketDataReader *shm_reader_ = nullptr;
+    Nanos next_shm_check_time_ = 0;
+    // live values for chapter10_stat
+    Metric *metric_loops_ = metrics().counter("md_consumer.loops");
+    Metric *metric_updates_ = metrics().counter("md_consumer.updates");
+    Metric *metric_gaps_ = metrics().counter("md_consumer.gaps");
+    Metric *metric_in_recovery_ = metrics().gauge("md_consumer.in_recovery");
+    Metric *metric_shm_lapped_ = metrics().counter("md_consumer.shm_lapped");
 public:
     MarketDataConsumer(thu::ClientId client_id, Exchange::MEMarketUpdateLFQueue *market_updates, const std::string &iface, const std::string &snapshot_ip
-                        , int snapshot_port, const std::string &incremental_ip, int incremental_port);
+                        , int snapshot_port, const std::string &incremental_ip, int incremental_port, bool use_shm = false);
     ~MarketDataConsumer();
     auto start()->void;
     auto stop()->void;
     auto run() noexcept -> void;
-    auto recvCallback(thu::McastSocket *socket) noexcept->void;
+    auto recvCallback(thu::McastSocket *socket, Nanos rx_time) noexcept->void;
+    auto recvShm() noexcept->void;
+    auto checkShm() noexcept->void;
+    auto onMarketUpdate(bool is_snapshot, const Exchange::MDPMarketUpdate *request, uint64_t kernel_rx_tsc, uint64_t rx_tsc) noexcept->void;
     auto startSnapshotSync() -> void;
     auto queueMessage(bool is_snapshot, const Exchange::MDPMarketUpdate *request) -> void;
     auto checkSnapshotSync()->void;
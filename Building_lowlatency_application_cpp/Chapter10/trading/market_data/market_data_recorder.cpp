@@ -0,0 +1,67 @@
+#include "market_data_recorder.h"
+namespace Trading{
+    MarketDataRecorder::MarketDataRecorder(const std::string &capture_file_name, const std::string &iface, const std::string &snapshot_ip
+                                            , int snapshot_port, const std::string &incremental_ip, int incremental_port)
+        : logger_("trading_market_data_recorder.log")
+        , writer_(capture_file_name)
+        , incremental_mcast_socket_(logger_)
+        , snapshot_mcast_socket_(logger_)
+    {
+        auto recv_callback = [this](auto socket, auto rx_time){
+            recvCallback(socket, rx_time);
+        };
+        incremental_mcast_socket_.recv_callback_ = recv_callback;
+        ASSERT(incremental_mcast_socket_.init(incremental_ip, iface, incremental_port, true) >= 0, "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
+        ASSERT(incremental_mcast_socket_.join(incremental_ip), "Join failed on:" + std::to_string(incremental_mcast_socket_.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+        // unlike MarketDataConsumer, which only joins the snapshot group to recover, the recorder keeps both for the whole session
+        snapshot_mcast_socket_.recv_callback_ = recv_callback;
+        ASSERT(snapshot_mcast_socket_.init(snapshot_ip, iface, snapshot_port, true) >= 0, "Unable to create snapshot mcast socket. error:" + std::string(std::strerror(errno)));
+        ASSERT(snapshot_mcast_socket_.join(snapshot_ip), "Join failed on:" + std::to_string(snapshot_mcast_socket_.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+    }
+
+    // Joins the recording thread before writer_ truncates the capture file
+    MarketDataRecorder::~MarketDataRecorder()
+    {
+        stop();
+        if(thread_){
+            thread_->join();
+            delete thread_;
+            thread_ = nullptr;
+        }
+    }
+
+    auto MarketDataRecorder::start()->void{
+        run_ = true;
+        thread_ = createAndStartThread(-1, "Trading/MarketDataRecorder", [this](){run();});
+        ASSERT(thread_ != nullptr, "Failed to start MarketDataRecorder thread.");
+    }
+
+    auto MarketDataRecorder::stop()->void{
+        run_ = false;
+    }
+
+    auto MarketDataRecorder::run() noexcept->void{
+        LOG_INFO(logger_, "%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
+        while(run_){
+            incremental_mcast_socket_.sendAndRecv();
+            snapshot_mcast_socket_.sendAndRecv();
+            writer_.flush();
+        }
+        LOG_INFO(logger_, "%:% %() % Captured % datagrams\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                    writer_.numRecords());
+    }
+
+    // Called once per datagram, which is everything readable since each callback consumes it all
+    auto MarketDataRecorder::recvCallback(thu::McastSocket *socket, Nanos rx_time) noexcept -> void
+    {
+        const auto stream = (socket == &snapshot_mcast_socket_) ? MDCaptureStream::SNAPSHOT : MDCaptureStream::INCREMENTAL;
+        auto &inbound_data = socket->inbound_data_;
+        const auto len = inbound_data.readable();
+        writer_.write(stream, rx_time, inbound_data.readPtr(), len);
+        inbound_data.consume(len);
+        metric_datagrams_->add();
+        metric_bytes_->add(len);
+        LOG_DEBUG(logger_, "%:% %() % Captured % datagram len:% ktime:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    thu::getCurrentTimeStr(&time_str_), mdCaptureStreamToString(stream), len, rx_time);
+    }
+} // end namespace Trading
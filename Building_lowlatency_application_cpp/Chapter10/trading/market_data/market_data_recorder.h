@@ -0,0 +1,33 @@
+#pragma once
+#include "common/thread_utils.h"
+#include "common/macros.h"
+#include "common/mcast_socket.h"
+#include "common/metrics.h"
+#include "exchange/market_data/market_update.h"
+#include "md_capture_file.h"
+namespace Trading{
+// Joins the incremental and the snapshot multicast groups like MarketDataConsumer and writes every datagram of both,
+// unparsed and with its kernel receive time, to an MDCaptureWriter. Nothing is decoded or sequenced, gaps and
+// recoveries are left to whoever reads the capture.
+class MarketDataRecorder{
+private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::MD_CONSUMER;
+    volatile bool run_ = false;
+    std::thread *thread_ = nullptr;
+    std::string time_str_;
+    Logger logger_;
+    MDCaptureWriter writer_;
+    thu::McastSocket incremental_mcast_socket_, snapshot_mcast_socket_;
+    // live values for chapter10_stat
+    Metric *metric_datagrams_ = metrics().counter("md_recorder.datagrams");
+    Metric *metric_bytes_ = metrics().counter("md_recorder.bytes");
+public:
+    MarketDataRecorder(const std::string &capture_file_name, const std::string &iface, const std::string &snapshot_ip, int snapshot_port
+                        , const std::string &incremental_ip, int incremental_port);
+    ~MarketDataRecorder();
+    auto start()->void;
+    auto stop()->void;
+    auto run() noexcept -> void;
+    auto recvCallback(thu::McastSocket *socket, Nanos rx_time) noexcept->void;
+};
+}// end namespace
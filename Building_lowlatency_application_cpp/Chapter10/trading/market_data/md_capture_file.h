@@ -0,0 +1,298 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "common/macros.h"
+#include "common/time_utils.h"
+
+namespace Trading{
+// Market data captures: every datagram received on the multicast groups, byte for byte, with its kernel receive time.
+// The data goes to segment files of at most MD_CAPTURE_SEGMENT_SIZE bytes, file_name, file_name.1, file_name.2, ...
+// each a MDCaptureSegmentHeader followed by records that never span segments. file_name.idx holds an MDCaptureIndexEntry
+// for every MD_CAPTURE_INDEX_STRIDE-th record, so readers can seek by time without scanning.
+constexpr uint64_t MD_CAPTURE_MAGIC = 0x31305041434d4454ull;         // "TDMCAP01"
+constexpr uint64_t MD_CAPTURE_INDEX_MAGIC = 0x3130584449434454ull;   // "TDCIDX01"
+constexpr size_t MD_CAPTURE_SEGMENT_SIZE = 256 * 1024 * 1024;
+constexpr size_t MD_CAPTURE_INDEX_STRIDE = 1024;
+constexpr size_t MD_CAPTURE_ASYNC_FLUSH_BYTES = 1024 * 1024;
+
+enum class MDCaptureStream : uint8_t{
+    INCREMENTAL = 0,
+    SNAPSHOT = 1
+};
+
+inline auto mdCaptureStreamToString(MDCaptureStream stream){
+    return stream == MDCaptureStream::SNAPSHOT ? "SNAPSHOT" : "INCREMENTAL";
+}
+
+struct MDCaptureSegmentHeader{
+    uint64_t magic_ = MD_CAPTURE_MAGIC;
+    uint32_t segment_index_ = 0;
+    uint32_t reserved_ = 0;
+};
+
+// Followed by length_ bytes of datagram, padded so the next record is 8 byte aligned.
+// A zeroed record ends a segment whose writer died before truncating it.
+struct MDCaptureRecord{
+    thu::Nanos rx_time_ = 0;     // kernel receive time in nanoseconds since the epoch, never 0
+    uint32_t length_ = 0;
+    MDCaptureStream stream_ = MDCaptureStream::INCREMENTAL;
+    uint8_t reserved_[3] = {};
+
+    auto data() const noexcept{
+        return reinterpret_cast<const char*>(this + 1);
+    }
+    auto size() const noexcept{
+        return sizeof(MDCaptureRecord) + ((length_ + 7) & ~size_t{7});
+    }
+};
+static_assert(sizeof(MDCaptureRecord) == 16);
+
+struct MDCaptureIndexEntry{
+    thu::Nanos rx_time_ = 0;
+    uint32_t segment_index_ = 0;
+    uint32_t reserved_ = 0;
+    uint64_t offset_ = 0;
+};
+
+// Appends records through a writable mapping of the current segment, so a write is one memcpy into the page cache
+// and what was written survives the process dying. Not thread safe, one recorder thread owns it.
+class MDCaptureWriter final{
+private:
+    const std::string file_name_;
+    uint32_t segment_index_ = 0;
+    int fd_ = -1;
+    char *data_ = nullptr;
+    size_t size_ = 0;
+    size_t synced_size_ = 0;
+    int index_fd_ = -1;
+    size_t num_records_ = 0;
+
+    auto segmentName() const{
+        return segment_index_ ? file_name_ + "." + std::to_string(segment_index_) : file_name_;
+    }
+
+    auto open() noexcept{
+        const auto name = segmentName();
+        fd_ = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ASSERT(fd_ >= 0, "Could not open capture file: " + name + " error:" + std::string(strerror(errno)));
+        ASSERT(posix_fallocate(fd_, 0, MD_CAPTURE_SEGMENT_SIZE) == 0, "Could not preallocate capture file: " + name);
+        data_ = static_cast<char*>(mmap(nullptr, MD_CAPTURE_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+        ASSERT(data_ != MAP_FAILED, "Could not mmap capture file: " + name + " error:" + std::string(strerror(errno)));
+        madvise(data_, MD_CAPTURE_SEGMENT_SIZE, MADV_SEQUENTIAL);
+        const MDCaptureSegmentHeader header{MD_CAPTURE_MAGIC, segment_index_, 0};
+        memcpy(data_, &header, sizeof(header));
+        size_ = sizeof(header);
+        synced_size_ = 0;
+    }
+
+    // Drop the unused preallocated tail so readers only see what was captured
+    auto close() noexcept{
+        if(fd_ < 0){
+            return;
+        }
+        munmap(data_, MD_CAPTURE_SEGMENT_SIZE);
+        if(ftruncate(fd_, size_) != 0){
+            std::cerr << "Could not truncate capture file: " << segmentName() << std::endl;
+        }
+        ::close(fd_);
+        fd_ = -1;
+        data_ = nullptr;
+    }
+
+public:
+    explicit MDCaptureWriter(const std::string &file_name) : file_name_(file_name){
+        const auto index_name = file_name_ + ".idx";
+        index_fd_ = ::open(index_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ASSERT(index_fd_ >= 0, "Could not open capture index: " + index_name + " error:" + std::string(strerror(errno)));
+        ASSERT(::write(index_fd_, &MD_CAPTURE_INDEX_MAGIC, sizeof(MD_CAPTURE_INDEX_MAGIC)) == sizeof(MD_CAPTURE_INDEX_MAGIC),
+                "Could not write capture index: " + index_name);
+        open();
+    }
+
+    ~MDCaptureWriter(){
+        close();
+        ::close(index_fd_);
+    }
+
+    MDCaptureWriter(const MDCaptureWriter&) = delete;
+    MDCaptureWriter& operator=(const MDCaptureWriter&) = delete;
+
+    auto write(MDCaptureStream stream, thu::Nanos rx_time, const char *data, size_t len) noexcept{
+        const MDCaptureRecord record{rx_time ? rx_time : thu::getCurrentNanos(), static_cast<uint32_t>(len), stream, {}};
+        if(UNLIKELY(sizeof(MDCaptureSegmentHeader) + record.size() > MD_CAPTURE_SEGMENT_SIZE)){
+            FATAL("Datagram too large to capture: " + std::to_string(len));
+        }
+        if(UNLIKELY(size_ + record.size() > MD_CAPTURE_SEGMENT_SIZE)){
+            close();
+            ++segment_index_;
+            open();
+        }
+        if(num_records_ % MD_CAPTURE_INDEX_STRIDE == 0){
+            const MDCaptureIndexEntry entry{record.rx_time_, segment_index_, 0, size_};
+            if(::write(index_fd_, &entry, sizeof(entry)) != sizeof(entry)){
+                std::cerr << "Could not write capture index: " << file_name_ << ".idx" << std::endl;
+            }
+        }
+        memcpy(data_ + size_, &record, sizeof(record));
+        memcpy(data_ + size_ + sizeof(record), data, len);
+        size_ += record.size();  // the padding is still zero from the preallocation
+        ++num_records_;
+    }
+
+    // Called after every batch, only starts writeback once enough has accumulated
+    auto flush() noexcept{
+        if(size_ - synced_size_ >= MD_CAPTURE_ASYNC_FLUSH_BYTES){
+            const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const auto begin = synced_size_ / page_size * page_size;
+            msync(data_ + begin, size_ - begin, MS_ASYNC);
+            synced_size_ = size_;
+        }
+    }
+
+    auto numRecords() const noexcept{
+        return num_records_;
+    }
+};
+
+// Maps every segment of a capture read only, records are used in place. The index is optional, without it seek() scans.
+class MDCaptureReader final{
+private:
+    struct Segment{
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+    std::vector<Segment> segments_;
+    std::vector<MDCaptureIndexEntry> index_;
+
+    static auto map(const std::string &name, size_t *size) -> const char*{
+        const auto fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0){
+            return nullptr;
+        }
+        struct stat st;
+        ASSERT(fstat(fd, &st) == 0, "Could not stat capture file:" + name);
+        *size = st.st_size;
+        const auto data = *size ? mmap(nullptr, *size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        ASSERT(data != MAP_FAILED, "Could not map capture file:" + name + " " + std::string(std::strerror(errno)));
+        return static_cast<const char*>(data);
+    }
+
+    // Record at offset of segment if there is a complete one
+    auto recordAt(size_t segment, size_t offset) const noexcept -> const MDCaptureRecord*{
+        const auto &seg = segments_[segment];
+        if(offset + sizeof(MDCaptureRecord) > seg.size_){
+            return nullptr;
+        }
+        const auto record = reinterpret_cast<const MDCaptureRecord*>(seg.data_ + offset);
+        return (record->rx_time_ && offset + record->size() <= seg.size_) ? record : nullptr;
+    }
+
+public:
+    class Iterator{
+    private:
+        const MDCaptureReader *reader_ = nullptr;
+        size_t segment_ = 0;
+        size_t offset_ = 0;
+
+        // Moves on to the next segment while the current one has no record left
+        auto settle() noexcept{
+            while(segment_ < reader_->segments_.size() && !reader_->recordAt(segment_, offset_)){
+                ++segment_;
+                offset_ = sizeof(MDCaptureSegmentHeader);
+            }
+            if(segment_ == reader_->segments_.size()){
+                offset_ = sizeof(MDCaptureSegmentHeader);
+            }
+        }
+
+    public:
+        Iterator(const MDCaptureReader *reader, size_t segment, size_t offset) : reader_(reader), segment_(segment), offset_(offset){
+            settle();
+        }
+
+        auto operator*() const noexcept -> const MDCaptureRecord&{
+            return *reader_->recordAt(segment_, offset_);
+        }
+        auto operator->() const noexcept{
+            return reader_->recordAt(segment_, offset_);
+        }
+        auto operator++() noexcept -> Iterator&{
+            offset_ += (*this)->size();
+            settle();
+            return *this;
+        }
+        auto operator==(const Iterator &other) const noexcept{
+            return segment_ == other.segment_ && offset_ == other.offset_;
+        }
+    };
+
+    explicit MDCaptureReader(const std::string &file_name){
+        for(uint32_t i = 0;; ++i){
+            const auto name = i ? file_name + "." + std::to_string(i) : file_name;
+            Segment segment;
+            segment.data_ = map(name, &segment.size_);
+            if(!segment.data_){
+                ASSERT(i, "Could not open capture file:" + file_name + " " + std::string(std::strerror(errno)));
+                break;
+            }
+            const auto header = reinterpret_cast<const MDCaptureSegmentHeader*>(segment.data_);
+            ASSERT(segment.size_ >= sizeof(MDCaptureSegmentHeader) && header->magic_ == MD_CAPTURE_MAGIC && header->segment_index_ == i,
+                    "Not a capture file or written by an incompatible version:" + name);
+            madvise(const_cast<char*>(segment.data_), segment.size_, MADV_SEQUENTIAL);
+            segments_.push_back(segment);
+        }
+
+        size_t index_size = 0;
+        if(const auto index = map(file_name + ".idx", &index_size)){
+            if(index_size >= sizeof(MD_CAPTURE_INDEX_MAGIC) && *reinterpret_cast<const uint64_t*>(index) == MD_CAPTURE_INDEX_MAGIC){
+                const auto entries = reinterpret_cast<const MDCaptureIndexEntry*>(index + sizeof(MD_CAPTURE_INDEX_MAGIC));
+                index_.assign(entries, entries + (index_size - sizeof(MD_CAPTURE_INDEX_MAGIC)) / sizeof(MDCaptureIndexEntry));
+            }
+            munmap(const_cast<char*>(index), index_size);
+        }
+    }
+
+    ~MDCaptureReader(){
+        for(const auto &segment : segments_){
+            munmap(const_cast<char*>(segment.data_), segment.size_);
+        }
+    }
+
+    MDCaptureReader(const MDCaptureReader&) = delete;
+    MDCaptureReader& operator=(const MDCaptureReader&) = delete;
+
+    auto begin() const noexcept{
+        return Iterator(this, 0, sizeof(MDCaptureSegmentHeader));
+    }
+    auto end() const noexcept{
+        return Iterator(this, segments_.size(), sizeof(MDCaptureSegmentHeader));
+    }
+
+    // First record, in capture order, received at or after time. Starts from the last index entry before time and scans
+    // from there. Each stream is in receive time order, across the two a datagram can be captured after a later one of
+    // the other stream by as long as it waited in its socket.
+    auto seek(thu::Nanos time) const noexcept{
+        const auto next = std::partition_point(index_.begin(), index_.end(), [time](const auto &entry){ return entry.rx_time_ < time; });
+        auto it = begin();
+        if(next != index_.begin()){
+            const auto &entry = *std::prev(next);
+            it = entry.segment_index_ < segments_.size() ? Iterator(this, entry.segment_index_, entry.offset_) : end();
+        }
+        for(const auto last = end(); it != last && it->rx_time_ < time; ++it){
+        }
+        return it;
+    }
+
+    auto numSegments() const noexcept{
+        return segments_.size();
+    }
+};
+}// end namespace
@@ -1,6 +1,6 @@
 #include "order_gateway.h"
 namespace Trading{
-    OrderGateway::OrderGateway(ClientId client_id, Exchange::ClientRequestLFQueue *client_requests, Exchange::ClientResponseLFQueue *client_responses, std::string ip, const std::string &iface, int port)
+    OrderGateway::OrderGateway(ClientId client_id, AlgoType algo_type, Exchange::ClientRequestLFQueue *client_requests, Exchange::ClientResponseLFQueue *client_responses, std::string ip, const std::string &iface, int port, bool use_shm)
         : client_id_(client_id)
         , ip_(ip)
         , iface_(iface)
@@ -9,6 +9,8 @@ namespace Trading{
         , incoming_responses_(client_responses)
         , logger_("trading_order_gateway_"+std::to_string(client_id) +".log")
         , tcp_socket_(logger_)
+        , use_shm_(use_shm)
+        , algo_type_(algo_type)
     {
         tcp_socket_.recv_callback_ = [this](auto socket, auto rx_time){
             recvCallback(socket, rx_time);
@@ -20,69 +22,166 @@ namespace Trading{
         stop();
         using namespace std::literals::chrono_literals;
         std::this_thread::sleep_for(5s);
+        if constexpr (PIPELINE_TRACE){
+            LOG_INFO(logger_, "%:% %() % Tick to trade latencies algo:% at shutdown:\n%", __FILE__, __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_), algoTypeToString(algo_type_), tick_to_trade_spans_.toString());
+        }
+        delete shm_session_;
+        shm_session_ = nullptr;
     }
 
     auto OrderGateway::start()->void{
         run_ = true;
-        ASSERT(tcp_socket_.connect(ip_, iface_, port_, false) >= 0, "Unable to connect to ip:" + ip_ + " port:" +
-                                                                        std::to_string(port_) + " on iface:" +
-                                                                        iface_ + " error:" +
-                                                                        std::string(std::strerror(errno)));
+        if(use_shm_){
+            // the OrderServer finds and attaches the session on its own
+            shm_session_ = new thu::ShmMapping<Exchange::ShmOrderSession>(Exchange::shmOrderSessionName(client_id_), true);
+            LOG_INFO(logger_, "%:% %() % Order session on %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                        shm_session_->path());
+        }
+        else{
+            ASSERT(tcp_socket_.connect(ip_, iface_, port_, false) >= 0, "Unable to connect to ip:" + ip_ + " port:" +
+                                                                            std::to_string(port_) + " on iface:" +
+                                                                            iface_ + " error:" +
+                                                                            std::string(std::strerror(errno)));
+        }
         ASSERT(createAndStartThread(-1, "Trading/OrderGateway", [this](){run();}) != nullptr, "Failed to start OrderGateway thread.");
     }
     auto OrderGateway::stop()->void{
         run_ = false;
     }
     auto OrderGateway::run()->void{
-        logger_.log("%:% %() %\n", __FILE__, __LINE__,
+        LOG_INFO(logger_, "%:% %() %\n", __FILE__, __LINE__,
                     __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
         while (run_)
         {
-            tcp_socket_.sendAndRecv();
+            metric_loops_->add();
+            if(shm_session_){
+                if(const auto now = getCurrentNanos(); UNLIKELY(now >= next_shm_check_time_)){
+                    next_shm_check_time_ = now + OG_SHM_CHECK_INTERVAL;
+                    checkShmSession();
+                }
+                recvShmResponses();
+            }
+            else{
+                tcp_socket_.sendAndRecv();
+            }
             for(auto client_request = outgoing_requests_->getNextToRead(); client_request; client_request = outgoing_requests_->getNextToRead()){
-                logger_.log("%:% %() % Sending cid:% seq:% %\n",
+                LOG_DEBUG(logger_, "%:% %() % Sending cid:% seq:% %\n",
                             __FILE__, __LINE__, __FUNCTION__,
                             thu::getCurrentTimeStr(&time_str_),
                             client_id_, next_outgoing_seq_num_,
-                            client_request->toString());
-                tcp_socket_.send(&next_outgoing_seq_num_, sizeof(next_outgoing_seq_num_));
-                tcp_socket_.send(client_request, sizeof(Exchange::MEClientRequest));
+                            *client_request);
+                if(shm_session_){
+                    auto &requests = shm_session_->get()->requests_;
+                    auto next_write = requests.getNextToWriteTo();
+                    if(UNLIKELY(!next_write)){
+                        break;  // the exchange is behind, retried on the next loop
+                    }
+                    *next_write = client_request->msg();
+                    requests.updateWriteIndex();
+                }
+                else{
+                    tcp_socket_.send(&next_outgoing_seq_num_, sizeof(next_outgoing_seq_num_));
+                    tcp_socket_.send(&client_request->msg(), sizeof(Exchange::MEClientRequest));
+                    next_outgoing_seq_num_++;
+                }
+                if constexpr (PIPELINE_TRACE){
+                    auto trace = client_request->trace_;
+                    trace.stamp(Exchange::TradingHop::ORDER_SENT);
+                    tick_to_trade_spans_.record(trace);
+                    if(UNLIKELY(tick_to_trade_spans_.reportDue())){
+                        LOG_INFO(logger_, "%:% %() % Tick to trade latencies algo:%\n%", __FILE__, __LINE__, __FUNCTION__,
+                                    thu::getCurrentTimeStr(&time_str_), algoTypeToString(algo_type_), tick_to_trade_spans_.toString());
+                    }
+                }
                 outgoing_requests_->updateReadIndex();
-                next_outgoing_seq_num_++;
+                metric_requests_->add();
             }
         }        
     }
 
     auto OrderGateway::recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void{
-        logger_.log("%:% %() % Received socket:% len:% %\n",
+        LOG_DEBUG(logger_, "%:% %() % Received socket:% len:% %\n",
                     __FILE__, __LINE__, __FUNCTION__,
                     thu::getCurrentTimeStr(&time_str_), socket->fd_,
-                    socket->next_rcv_valid_index_, rx_time);
-        if(socket->next_rcv_valid_index_ >= sizeof(Exchange::OMClientResponse)){
-            size_t i = 0;
-            for(; i + sizeof(Exchange::OMClientResponse) <= socket->next_rcv_valid_index_; i+= sizeof(Exchange::OMClientResponse)){
-                auto response = reinterpret_cast<const Exchange::OMClientResponse*>(socket->rcv_buffer_ + i);
-                logger_.log("%:% %() % Received %\n", __FILE__,
+                    socket->rcv_buffer_.readable(), rx_time);
+        // parse in place, consume() only moves the read cursor
+        auto &rcv_buffer = socket->rcv_buffer_;
+        for(; rcv_buffer.readable() >= sizeof(Exchange::OMClientResponse); rcv_buffer.consume(sizeof(Exchange::OMClientResponse))){
+            auto response = reinterpret_cast<const Exchange::OMClientResponse*>(rcv_buffer.readPtr());
+            LOG_DEBUG(logger_, "%:% %() % Received %\n", __FILE__,
+                        __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_), response->toString());
+            if(response->me_client_response_.client_id_ != client_id_){
+                LOG_ERROR(logger_, "%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__,
                             __LINE__, __FUNCTION__,
-                            thu::getCurrentTimeStr(&time_str_), response->toString());
-                if(response->me_client_response_.client_id_ != client_id_){
-                    logger_.log("%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__,
-                                __LINE__, __FUNCTION__,
-                                thu::getCurrentTimeStr(&time_str_), client_id_, response->me_client_response_.client_id_);
-                    continue;
-                }
-                if(response->seq_num_ != next_exp_seq_num_){
-                    logger_.log("%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n", __FILE__, __LINE__,
-                                __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_id_, next_exp_seq_num_, response->seq_num_);
-                    continue;
-                }
-                ++next_exp_seq_num_;
+                            thu::getCurrentTimeStr(&time_str_), client_id_, response->me_client_response_.client_id_);
+                continue;
+            }
+            if(response->seq_num_ != next_exp_seq_num_){
+                LOG_ERROR(logger_, "%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n", __FILE__, __LINE__,
+                            __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_id_, next_exp_seq_num_, response->seq_num_);
+                continue;
+            }
+            ++next_exp_seq_num_;
+            auto next_write = incoming_responses_->getNextToWriteTo();
+            *next_write = std::move(response->me_client_response_);
+            incoming_responses_->updateWriteIndex();
+            metric_responses_->add();
+        }
+    }
+
+    // Notices the OrderServer attaching, going away or, as it does when the response ring overflows, closing the session.
+    // Requests queue up in the session while no OrderServer serves it. A closed session lost responses, so the order
+    // state this process holds can no longer be trusted.
+    auto OrderGateway::checkShmSession() noexcept -> void{
+        const auto session = shm_session_->get();
+        if(UNLIKELY(session->closed_.load(std::memory_order_acquire))){
+            FATAL("Exchange closed the order session of ClientId:" + std::to_string(client_id_) + " on " + shm_session_->path() +
+                  ", responses were dropped.");
+        }
+        auto server_pid = session->server_pid_.load(std::memory_order_acquire);
+        if(server_pid && kill(server_pid, 0) != 0 && errno != EPERM){
+            server_pid = 0;
+        }
+        if(server_pid == shm_server_pid_){
+            if(!server_pid && ++shm_unserved_checks_ % OG_SHM_UNSERVED_WARN_CHECKS == 0){
+                LOG_WARN(logger_, "%:% %() % No OrderServer serves % for %ms, % requests waiting\n", __FILE__, __LINE__, __FUNCTION__,
+                            thu::getCurrentTimeStr(&time_str_), shm_session_->path(),
+                            shm_unserved_checks_ * OG_SHM_CHECK_INTERVAL / NANOS_TO_MILLIS, session->requests_.size());
+            }
+            return;
+        }
+        shm_unserved_checks_ = 0;
+        if(server_pid){
+            LOG_INFO(logger_, "%:% %() % OrderServer pid:% attached % with % requests waiting\n", __FILE__, __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_), server_pid, shm_session_->path(), session->requests_.size());
+        }
+        else{
+            LOG_ERROR(logger_, "%:% %() % OrderServer pid:% no longer serves %\n", __FILE__, __LINE__, __FUNCTION__,
+                        thu::getCurrentTimeStr(&time_str_), shm_server_pid_, shm_session_->path());
+        }
+        shm_server_pid_ = server_pid;
+        metric_shm_attached_->set(server_pid != 0);
+    }
+
+    // Shared memory counterpart of recvCallback(), the session is in order so there are no sequence numbers to check
+    auto OrderGateway::recvShmResponses() noexcept -> void{
+        auto &responses = shm_session_->get()->responses_;
+        for(auto response = responses.getNextToRead(); response; response = responses.getNextToRead()){
+            LOG_DEBUG(logger_, "%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                        response->toString());
+            if(UNLIKELY(response->client_id_ != client_id_)){
+                LOG_ERROR(logger_, "%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__, __LINE__,
+                            __FUNCTION__, thu::getCurrentTimeStr(&time_str_), client_id_, response->client_id_);
+            }
+            else{
                 auto next_write = incoming_responses_->getNextToWriteTo();
-                *next_write = std::move(response->me_client_response_);
+                *next_write = *response;
                 incoming_responses_->updateWriteIndex();
+                metric_responses_->add();
             }
-            memcpy(socket->rcv_buffer_, socket->rcv_buffer_ + i, socket->next_rcv_valid_index_-i);
-            socket->next_rcv_valid_index_ -= i;
+            responses.updateReadIndex();
         }
     }
 }
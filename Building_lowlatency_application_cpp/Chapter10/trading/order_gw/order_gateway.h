@@ -3,13 +3,21 @@
 #include "common/thread_utils.h"
 #include "common/macros.h"
 #include "common/tcp_server.h"
+#include "common/metrics.h"
 #include "exchange/order_server/client_request.h"
 #include "exchange/order_server/client_response.h"
+#include "exchange/order_server/shm_order_session.h"
 #include "common/types.h"
 
 namespace Trading{
+// How often the OrderGateway looks at who serves its shared memory session, and how many checks in a row without an
+// OrderServer it takes to warn about it
+constexpr Nanos OG_SHM_CHECK_INTERVAL = 100 * 1000 * 1000;
+constexpr size_t OG_SHM_UNSERVED_WARN_CHECKS = 50;
+
 class OrderGateway{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::ORDER_GATEWAY;
     const ClientId client_id_;
     std::string ip_;
     const std::string iface_;
@@ -22,17 +30,40 @@ private:
     size_t next_outgoing_seq_num_ = 1;
     size_t next_exp_seq_num_ = 1;
     thu::TCPSocket tcp_socket_;
+    // replaces tcp_socket_ when the exchange runs on the same host
+    const bool use_shm_;
+    thu::ShmMapping<Exchange::ShmOrderSession> *shm_session_ = nullptr;
+    pid_t shm_server_pid_ = 0;  // as of the last check, 0 while no OrderServer serves the session
+    Nanos next_shm_check_time_ = 0;
+    size_t shm_unserved_checks_ = 0;
+    // live values for chapter10_stat
+    Metric *metric_loops_ = metrics().counter("order_gateway.loops");
+    Metric *metric_requests_ = metrics().counter("order_gateway.requests");
+    Metric *metric_responses_ = metrics().counter("order_gateway.responses");
+    Metric *metric_shm_attached_ = metrics().gauge("order_gateway.shm_attached");
+    // tick-to-trade of the requests sent, reported under the algo type that produced them
+    const AlgoType algo_type_;
+    TraceSpans<Exchange::TradingHop, 6> tick_to_trade_spans_{{{
+        {"md_kernel_rx->md_rx", Exchange::TradingHop::MD_KERNEL_RX, Exchange::TradingHop::MD_RX},
+        {"md_rx->engine_dequeue", Exchange::TradingHop::MD_RX, Exchange::TradingHop::ENGINE_DEQUEUE},
+        {"engine_dequeue->decision", Exchange::TradingHop::ENGINE_DEQUEUE, Exchange::TradingHop::DECISION},
+        {"decision->order_sent", Exchange::TradingHop::DECISION, Exchange::TradingHop::ORDER_SENT},
+        {"md_rx->order_sent", Exchange::TradingHop::MD_RX, Exchange::TradingHop::ORDER_SENT},
+        {"md_kernel_rx->order_sent", Exchange::TradingHop::MD_KERNEL_RX, Exchange::TradingHop::ORDER_SENT}}}};
 public:
-    OrderGateway(ClientId client_id
+    OrderGateway(ClientId client_id, AlgoType algo_type
         , Exchange::ClientRequestLFQueue *client_requests
         , Exchange::ClientResponseLFQueue *client_responses
         , std::string ip
         , const std::string &iface
-        , int port);
+        , int port
+        , bool use_shm = false);
     ~OrderGateway();
     auto start() -> void;
     auto stop() -> void;
     auto run() -> void;
     auto recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void;
+    auto recvShmResponses() noexcept -> void;
+    auto checkShmSession() noexcept -> void;
 };
 }// end namespace
\ No newline at end of file
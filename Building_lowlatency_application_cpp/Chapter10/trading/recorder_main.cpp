@@ -0,0 +1,43 @@
+#include <csignal>
+#include <iostream>
+#include "market_data/market_data_recorder.h"
+#include "common/logging.h"
+
+using namespace thu;
+
+// Records the exchange's market data multicast groups into a capture file until SIGINT or SIGTERM.
+// usage: recorder_main CAPTURE_FILE [IFACE=lo SNAPSHOT_IP=233.252.14.1 SNAPSHOT_PORT=20000 INCREMENTAL_IP=233.252.14.3 INCREMENTAL_PORT=20001]
+namespace{
+    volatile std::sig_atomic_t stop_requested = 0;
+    void signal_handler(int){
+        stop_requested = 1;
+    }
+}
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "usage: " << argv[0] << " CAPTURE_FILE [IFACE SNAPSHOT_IP SNAPSHOT_PORT INCREMENTAL_IP INCREMENTAL_PORT]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    setLogLevels(getenv("THU_LOG_LEVELS"));
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    const std::string capture_file_name = argv[1];
+    const std::string mkt_data_iface = argc > 2 ? argv[2] : "lo";
+    const std::string snapshot_ip = argc > 3 ? argv[3] : "233.252.14.1";
+    const int snapshot_port = argc > 4 ? atoi(argv[4]) : 20000;
+    const std::string incremental_ip = argc > 5 ? argv[5] : "233.252.14.3";
+    const int incremental_port = argc > 6 ? atoi(argv[6]) : 20001;
+
+    auto recorder = new Trading::MarketDataRecorder(capture_file_name, mkt_data_iface, snapshot_ip, snapshot_port, incremental_ip, incremental_port);
+    recorder->start();
+    std::cout << "Recording " << incremental_ip << ":" << incremental_port << " and " << snapshot_ip << ":" << snapshot_port
+              << " on " << mkt_data_iface << " to " << capture_file_name << std::endl;
+    while(!stop_requested){
+        usleep(100 * 1000);
+    }
+    delete recorder;    // joins the recording thread and truncates the capture
+    std::cout << "Capture closed " << capture_file_name << std::endl;
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include <bit>
+#include <concepts>
+
+#include "trade_engine.h"
+#include "market_maker.h"
+#include "liquidity_taker.h"
+
+namespace Trading{
+// What AlgoTradeEngine calls on its strategy for every event, resolved at compile time
+template<typename T>
+concept TradingAlgo = requires(T algo, TickerId ticker_id, Price price, Side side, MarketOrderBook *book,
+                               const Exchange::MEMarketUpdate *market_update, const Exchange::MEClientResponse *client_response){
+    { T::ALGO_TYPE } -> std::convertible_to<AlgoType>;
+    algo.onOrderBookUpdate(ticker_id, price, side, book);
+    algo.onTradeUpdate(market_update, book);
+    algo.onOrderUpdate(client_response);
+};
+
+// No strategy, e.g. for AlgoType::RANDOM where trading_main sends the orders itself. Events are only logged.
+class NoAlgo{
+private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::STRATEGY;
+    std::string time_str_;
+    Logger *logger_ = nullptr;
+public:
+    static constexpr auto ALGO_TYPE = AlgoType::RANDOM;
+
+    NoAlgo(Logger *logger, TradeEngine *, const FeatureEngine *, OrderManager *, const TradeEngineCfgHashMap &)
+        : logger_(logger){}
+
+    auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *) noexcept->void{
+        LOG_DEBUG(*logger_, "%:% %() % ticker:% price:% side:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    thu::getCurrentTimeStr(&time_str_), ticker_id, thu::priceToString(price).c_str(),
+                    thu::sideToString(side).c_str());
+    }
+    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *) noexcept->void{
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                    *market_update);
+    }
+    auto onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept->void{
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                    *client_response);
+    }
+};
+
+// Most market updates applied to the books in one conflated drain before the strategy runs
+constexpr size_t TRADE_ENGINE_MAX_CONFLATED = 4096;
+static_assert(ME_MAX_TICKERS <= 32);
+
+// TradeEngine running one strategy type: the event loop calls Algo directly instead of through std::function,
+// so every strategy gets its own instantiation of the loop with its callbacks inlined.
+template<TradingAlgo Algo>
+class AlgoTradeEngine final : public TradeEngine{
+private:
+    Algo algo_;
+
+    // conflation state: the last book update and last trade of each ticker touched by the current drain
+    std::array<Traced<Exchange::MEMarketUpdate>, ME_MAX_TICKERS> last_book_update_;
+    std::array<Traced<Exchange::MEMarketUpdate>, ME_MAX_TICKERS> last_trade_;
+
+    // Every update goes through book, features and strategy before the next one is read
+    auto processMarketUpdates() noexcept{
+        size_t num_updates = 0;
+        for(auto market_update = incoming_md_updates_->getNextToRead(); market_update; market_update = incoming_md_updates_->getNextToRead())
+        {
+            LOG_DEBUG(logger_, "%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                        *market_update);
+            if(UNLIKELY(market_update->ticker_id_ >= ticker_order_book_.size())){
+                FATAL("Unknown ticker-id on update:" + market_update->toString());
+            }
+            current_trace_ = market_update->trace_;
+            current_trace_.stamp(Exchange::TradingHop::ENGINE_DEQUEUE);
+            auto book = ticker_order_book_[market_update->ticker_id_];
+            book->onMarketUpdate(market_update);
+            if(market_update->type_ == Exchange::MarketUpdateType::TRADE){
+                onTradeUpdate(market_update, book);
+                algo_.onTradeUpdate(market_update, book);
+            }
+            else{
+                onOrderBookUpdate(market_update->ticker_id_, market_update->price_, market_update->side_, book);
+                algo_.onOrderBookUpdate(market_update->ticker_id_, market_update->price_, market_update->side_, book);
+            }
+            incoming_md_updates_->updateReadIndex();
+            ++num_updates;
+            last_event_time_ = now_;
+        }
+        // size() reads the producer's cursor too, so the depth is sampled once per drain
+        if(num_updates){
+            metric_md_updates_->add(num_updates);
+            metric_md_queue_depth_->set(incoming_md_updates_->size());
+        }
+    }
+
+    // Applies up to TRADE_ENGINE_MAX_CONFLATED queued updates to the books, then runs the book update chain once per
+    // ticker whose book changed and the strategy's trade callback once per ticker that traded, each with the last such
+    // update. Trades still reach the FeatureEngine one by one since VWAP and trade rate need all of them.
+    auto processMarketUpdatesConflated() noexcept{
+        uint32_t book_dirty = 0, trade_dirty = 0;
+        size_t num_updates = 0;
+        for(auto market_update = incoming_md_updates_->getNextToRead(); market_update && num_updates < TRADE_ENGINE_MAX_CONFLATED;
+            market_update = incoming_md_updates_->getNextToRead(), ++num_updates)
+        {
+            LOG_DEBUG(logger_, "%:% %() % Applying %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                        *market_update);
+            const auto ticker_id = market_update->ticker_id_;
+            if(UNLIKELY(ticker_id >= ticker_order_book_.size())){
+                FATAL("Unknown ticker-id on update:" + market_update->toString());
+            }
+            auto book = ticker_order_book_[ticker_id];
+            book->onMarketUpdate(market_update);
+            auto &last = (market_update->type_ == Exchange::MarketUpdateType::TRADE ? last_trade_ : last_book_update_)[ticker_id];
+            last = *market_update;
+            last.trace_.stamp(Exchange::TradingHop::ENGINE_DEQUEUE);
+            if(market_update->type_ == Exchange::MarketUpdateType::TRADE){
+                onTradeUpdate(market_update, book);
+                trade_dirty |= 1u << ticker_id;
+            }
+            else{
+                book_dirty |= 1u << ticker_id;
+            }
+            incoming_md_updates_->updateReadIndex();
+        }
+        if(!num_updates){
+            return;
+        }
+
+        size_t num_dispatched = 0;
+        for(auto dirty = book_dirty | trade_dirty; dirty; dirty &= dirty - 1){
+            const TickerId ticker_id = std::countr_zero(dirty);
+            auto book = ticker_order_book_[ticker_id];
+            if(book_dirty & (1u << ticker_id)){
+                const auto &update = last_book_update_[ticker_id];
+                current_trace_ = update.trace_;
+                onOrderBookUpdate(ticker_id, update.price_, update.side_, book);
+                algo_.onOrderBookUpdate(ticker_id, update.price_, update.side_, book);
+                ++num_dispatched;
+            }
+            if(trade_dirty & (1u << ticker_id)){
+                const auto &trade = last_trade_[ticker_id];
+                current_trace_ = trade.trace_;
+                algo_.onTradeUpdate(&trade, book);
+                ++num_dispatched;
+            }
+        }
+        metric_md_updates_->add(num_updates);
+        metric_md_conflated_->add(num_updates - num_dispatched);
+        metric_md_queue_depth_->set(incoming_md_updates_->size());
+        last_event_time_ = now_;
+    }
+
+public:
+    AlgoTradeEngine(ClientId client_id, const TradeEngineCfgHashMap &ticker_cfg
+                    , Exchange::ClientRequestLFQueue *client_requests
+                    , Exchange::ClientResponseLFQueue *client_responses
+                    , Exchange::MEMarketUpdateLFQueue *market_updates
+                    , bool conflate_md
+                    , const std::string &log_file_name = "")
+        : TradeEngine(client_id, Algo::ALGO_TYPE, ticker_cfg, client_requests, client_responses, market_updates, conflate_md, log_file_name)
+        , algo_(&logger_, this, &feature_engine_, &order_manager_, ticker_cfg){}
+
+    // Stops the event loop before algo_ and then the TradeEngine members go away
+    ~AlgoTradeEngine() override{
+        run_ = false;
+        if(started_){
+            using namespace std::literals::chrono_literals;
+            std::this_thread::sleep_for(1s);
+        }
+    }
+
+    auto start()->void override{
+        run_ = true;
+        started_ = true;
+        ASSERT(createAndStartThread(-1, "Trading/Engine", [this](){run();}) != nullptr, "Failed to start TradeEngine thread.");
+    }
+
+    auto run() noexcept->void{
+        LOG_INFO(logger_, "%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
+        while (run_)
+        {
+            poll(getCurrentNanos());
+        }
+    }
+
+    // One pass over both input queues with the clock at now. run() calls it with TSC time, a backtest with simulated time.
+    auto poll(Nanos now) noexcept->void{
+        now_ = now;
+        metric_loops_->add();
+        for (auto client_response = incoming_ogw_responses_->getNextToRead();
+             client_response; client_response = incoming_ogw_responses_->getNextToRead())
+        {
+            LOG_DEBUG(logger_, "%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                        *client_response);
+            current_trace_ = {};
+            onOrderUpdate(client_response);
+            algo_.onOrderUpdate(client_response);
+            incoming_ogw_responses_->updateReadIndex();
+            metric_responses_->add();
+            last_event_time_ = now_;
+        }
+
+        if(conflate_md_){
+            processMarketUpdatesConflated();
+        }
+        else{
+            processMarketUpdates();
+        }
+    }
+};
+
+// The instantiation for algo_type, picked once at start-up
+inline auto makeTradeEngine(ClientId client_id, AlgoType algo_type, const TradeEngineCfgHashMap &ticker_cfg
+                            , Exchange::ClientRequestLFQueue *client_requests
+                            , Exchange::ClientResponseLFQueue *client_responses
+                            , Exchange::MEMarketUpdateLFQueue *market_updates
+                            , bool conflate_md = false) -> TradeEngine*{
+    switch(algo_type){
+    case AlgoType::MAKER:
+        return new AlgoTradeEngine<MarketMaker>(client_id, ticker_cfg, client_requests, client_responses, market_updates, conflate_md);
+    case AlgoType::TAKER:
+        return new AlgoTradeEngine<LiquidityTaker>(client_id, ticker_cfg, client_requests, client_responses, market_updates, conflate_md);
+    default:
+        return new AlgoTradeEngine<NoAlgo>(client_id, ticker_cfg, client_requests, client_responses, market_updates, conflate_md);
+    }
+}
+}// end namespace
@@ -1,46 +1,194 @@
 #pragma once
+#include <cmath>
+#include <numeric>
 #include "common/macros.h"
 #include "common/logging.h"
+#include "common/time_utils.h"
 #include "market_order_book.h"
 using namespace thu;
 namespace Trading{
 const auto Feature_INVALID = std::numeric_limits<double>::quiet_NaN();
+
+constexpr size_t FEATURE_WINDOW = 64;               // events per rolling window
+constexpr size_t FEATURE_BOOK_LEVELS = 5;           // levels per side in the book pressure
+constexpr Nanos FEATURE_TRADE_RATE_TAU = 1 * NANOS_TO_SECS; // time constant of the trade rate EWMA
+
+// Sums of the last W values pushed for each ticker. push() is O(1): the value leaving the window is subtracted.
+// Floating point sums are recomputed from the window once every W pushes so rounding errors cannot pile up.
+template<typename T, size_t W>
+class RollingWindows final{
+private:
+    std::array<std::array<T, W>, ME_MAX_TICKERS> values_ = {};
+    alignas(CACHE_LINE_SIZE) std::array<T, ME_MAX_TICKERS> sums_ = {};
+    std::array<uint32_t, ME_MAX_TICKERS> next_ = {};
+    std::array<uint32_t, ME_MAX_TICKERS> count_ = {};
+
+public:
+    auto push(TickerId ticker_id, T value) noexcept{
+        auto &slot = values_[ticker_id][next_[ticker_id]];
+        sums_[ticker_id] += value - slot;
+        slot = value;
+        if(UNLIKELY(++next_[ticker_id] == W)){
+            next_[ticker_id] = 0;
+            if constexpr (std::is_floating_point_v<T>){
+                sums_[ticker_id] = std::accumulate(values_[ticker_id].begin(), values_[ticker_id].end(), T{});
+            }
+        }
+        count_[ticker_id] += (count_[ticker_id] < W);
+    }
+    auto sum(TickerId ticker_id) const noexcept{
+        return sums_[ticker_id];
+    }
+    auto count(TickerId ticker_id) const noexcept{
+        return count_[ticker_id];
+    }
+};
+
+// Per ticker features, updated incrementally from every book and trade update. State is laid out structure of arrays:
+// one array of ME_MAX_TICKERS per feature (8 doubles, one cache line), so an update touches one lane of a few lines
+// and loops across tickers, like getTradeRates(), vectorize.
 class FeatureEngine{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::STRATEGY;
+    template<typename T>
+    using PerTicker = std::array<T, ME_MAX_TICKERS>;
+
     std::string time_str_;
     Logger *logger_ = nullptr;
-    double mkt_price_ = Feature_INVALID, agg_trade_qty_ratio_ = Feature_INVALID;
+
+    alignas(CACHE_LINE_SIZE) PerTicker<double> mkt_price_;
+    alignas(CACHE_LINE_SIZE) PerTicker<double> agg_trade_qty_ratio_;
+    alignas(CACHE_LINE_SIZE) PerTicker<double> book_pressure_;
+    alignas(CACHE_LINE_SIZE) PerTicker<double> trade_rate_ = {};
+    alignas(CACHE_LINE_SIZE) PerTicker<Nanos> last_trade_time_ = {};
+    alignas(CACHE_LINE_SIZE) PerTicker<double> last_mid_price_;
+    PerTicker<BBO> last_bbo_ = {};
+
+    RollingWindows<uint64_t, FEATURE_WINDOW> trade_notional_;   // price * qty of the last trades
+    RollingWindows<uint64_t, FEATURE_WINDOW> trade_qty_;
+    RollingWindows<int64_t, FEATURE_WINDOW> order_flow_;        // order flow imbalance of the last top of book changes
+    RollingWindows<double, FEATURE_WINDOW> squared_returns_;    // squared log returns of the last mid price changes
+
+    static auto validBBO(const BBO *bbo) noexcept{
+        return bbo->bid_price_ != Price_INVALID && bbo->ask_price_ != Price_INVALID;
+    }
+
+    // Order flow of one top of book change (Cont, Kukanov, Stoikov): bid side quantity added minus ask side quantity added.
+    static auto orderFlow(const BBO &prev, const BBO &bbo) noexcept -> int64_t{
+        int64_t flow = 0;
+        if(bbo.bid_price_ >= prev.bid_price_) flow += bbo.bid_qty_;
+        if(bbo.bid_price_ <= prev.bid_price_) flow -= prev.bid_qty_;
+        if(bbo.ask_price_ <= prev.ask_price_) flow -= bbo.ask_qty_;
+        if(bbo.ask_price_ >= prev.ask_price_) flow += prev.ask_qty_;
+        return flow;
+    }
+
 public:
     FeatureEngine(Logger *logger) : logger_(logger)
-    {}
-    auto getMktPrice() const noexcept{
-        return mkt_price_;
+    {
+        mkt_price_.fill(Feature_INVALID);
+        agg_trade_qty_ratio_.fill(Feature_INVALID);
+        book_pressure_.fill(Feature_INVALID);
+        last_mid_price_.fill(Feature_INVALID);
+    }
+
+    // Quantity weighted mid, leaning towards the side with less quantity
+    auto getMktPrice(TickerId ticker_id) const noexcept{
+        return mkt_price_[ticker_id];
+    }
+
+    // Size of the last trade relative to the quantity it hit at the top of book
+    auto getAggTradeQtyRatio(TickerId ticker_id) const noexcept{
+        return agg_trade_qty_ratio_[ticker_id];
+    }
+
+    // Volume weighted price of the last FEATURE_WINDOW trades
+    auto getVWAP(TickerId ticker_id) const noexcept{
+        const auto qty = trade_qty_.sum(ticker_id);
+        return qty ? static_cast<double>(trade_notional_.sum(ticker_id)) / qty : Feature_INVALID;
+    }
+
+    // Net quantity added on the bid minus the ask over the last FEATURE_WINDOW top of book changes, > 0 is buying pressure
+    auto getOrderFlowImbalance(TickerId ticker_id) const noexcept{
+        return order_flow_.count(ticker_id) ? static_cast<double>(order_flow_.sum(ticker_id)) : Feature_INVALID;
+    }
+
+    // Square root of the summed squared log returns of the last FEATURE_WINDOW mid price changes
+    auto getRealizedVolatility(TickerId ticker_id) const noexcept{
+        return squared_returns_.count(ticker_id) ? std::sqrt(squared_returns_.sum(ticker_id)) : Feature_INVALID;
+    }
+
+    // (bid qty - ask qty) / (bid qty + ask qty) over the top FEATURE_BOOK_LEVELS levels, in [-1, 1]
+    auto getBookPressure(TickerId ticker_id) const noexcept{
+        return book_pressure_[ticker_id];
+    }
+
+    // Trades per second, exponentially weighted with FEATURE_TRADE_RATE_TAU and decayed to now
+    auto getTradeRate(TickerId ticker_id, Nanos now) const noexcept{
+        return trade_rate_[ticker_id] * std::exp(-static_cast<double>(now - last_trade_time_[ticker_id]) / FEATURE_TRADE_RATE_TAU);
     }
-    
-    auto getAggTradeQtyRatio() const noexcept{
-        return agg_trade_qty_ratio_;
+
+    // getTradeRate() of every ticker at once
+    auto getTradeRates(Nanos now, PerTicker<double> &rates) const noexcept{
+        for(size_t i = 0; i < ME_MAX_TICKERS; ++i){
+            rates[i] = trade_rate_[i] * std::exp(-static_cast<double>(now - last_trade_time_[i]) / FEATURE_TRADE_RATE_TAU);
+        }
     }
-    
+
     auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *book) noexcept->void{
         const auto bbo = book->getBBO();
-        if(LIKELY(bbo->bid_price_ != Price_INVALID && bbo->ask_price_ != Price_INVALID)){
-            mkt_price_ = (bbo->bid_price_ * bbo->ask_qty_ + bbo->ask_price_ * bbo->bid_qty_) / static_cast<double>(bbo->bid_qty_ + bbo->ask_qty_);
+        if(LIKELY(validBBO(bbo))){
+            mkt_price_[ticker_id] = (bbo->bid_price_ * bbo->ask_qty_ + bbo->ask_price_ * bbo->bid_qty_) / static_cast<double>(bbo->bid_qty_ + bbo->ask_qty_);
+
+            auto &last_bbo = last_bbo_[ticker_id];
+            if(validBBO(&last_bbo) && (bbo->bid_price_ != last_bbo.bid_price_ || bbo->bid_qty_ != last_bbo.bid_qty_
+                                       || bbo->ask_price_ != last_bbo.ask_price_ || bbo->ask_qty_ != last_bbo.ask_qty_)){
+                order_flow_.push(ticker_id, orderFlow(last_bbo, *bbo));
+            }
+            last_bbo = *bbo;
+
+            const auto mid_price = (bbo->bid_price_ + bbo->ask_price_) * 0.5;
+            if(!std::isnan(last_mid_price_[ticker_id]) && mid_price != last_mid_price_[ticker_id]){
+                const auto log_return = std::log(mid_price / last_mid_price_[ticker_id]);
+                squared_returns_.push(ticker_id, log_return * log_return);
+            }
+            last_mid_price_[ticker_id] = mid_price;
         }
-        logger_->log("%:% %() % ticker:% price:% side:% mkt-price:% agg-trade-ratio:%\n", __FILE__, __LINE__,
+
+        std::array<MarketPriceLevel, FEATURE_BOOK_LEVELS> levels;
+        uint64_t bid_qty = 0, ask_qty = 0;
+        for(size_t i = 0, n = book->getLevels(Side::BUY, levels); i < n; ++i){
+            bid_qty += levels[i].qty_;
+        }
+        for(size_t i = 0, n = book->getLevels(Side::SELL, levels); i < n; ++i){
+            ask_qty += levels[i].qty_;
+        }
+        book_pressure_[ticker_id] = (bid_qty + ask_qty) ? (static_cast<double>(bid_qty) - ask_qty) / (bid_qty + ask_qty) : Feature_INVALID;
+
+        LOG_DEBUG(*logger_, "%:% %() % ticker:% price:% side:% mkt-price:% agg-trade-ratio:% ofi:% vol:% pressure:%\n", __FILE__, __LINE__,
           __FUNCTION__, getCurrentTimeStr(&time_str_),
                      ticker_id, priceToString(price).c_str(),
-                   sideToString(side).c_str(), mkt_price_, agg_trade_qty_ratio_);        
+                   sideToString(side).c_str(), mkt_price_[ticker_id], agg_trade_qty_ratio_[ticker_id],
+                   getOrderFlowImbalance(ticker_id), getRealizedVolatility(ticker_id), book_pressure_[ticker_id]);
     }
 
-    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book) noexcept->void{
+    // now is the time of the trade, simulated in a backtest
+    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book, Nanos now) noexcept->void{
+        const auto ticker_id = market_update->ticker_id_;
         const auto bbo = book->getBBO();
-        if(LIKELY(bbo->bid_price_ != Price_INVALID && bbo->ask_price_ != Price_INVALID)){
-            agg_trade_qty_ratio_ = static_cast<double>(market_update->qty_) / (market_update->side_ == Side::BUY ? bbo->ask_qty_ : bbo->bid_qty_);
+        if(LIKELY(validBBO(bbo))){
+            agg_trade_qty_ratio_[ticker_id] = static_cast<double>(market_update->qty_) / (market_update->side_ == Side::BUY ? bbo->ask_qty_ : bbo->bid_qty_);
         }
-        logger_->log("%:% %() % % mkt-price:% agg-trade-ratio:%\n", __FILE__, __LINE__, __FUNCTION__,
+        trade_notional_.push(ticker_id, market_update->price_ * market_update->qty_);
+        trade_qty_.push(ticker_id, market_update->qty_);
+
+        trade_rate_[ticker_id] = getTradeRate(ticker_id, now) + static_cast<double>(NANOS_TO_SECS) / FEATURE_TRADE_RATE_TAU;
+        last_trade_time_[ticker_id] = now;
+
+        LOG_DEBUG(*logger_, "%:% %() % % mkt-price:% agg-trade-ratio:% vwap:% trade-rate:%\n", __FILE__, __LINE__, __FUNCTION__,
                    thu::getCurrentTimeStr(&time_str_),
-                   market_update->toString().c_str(),
-                     mkt_price_, agg_trade_qty_ratio_);
+                   *market_update,
+                     mkt_price_[ticker_id], agg_trade_qty_ratio_[ticker_id], getVWAP(ticker_id), trade_rate_[ticker_id]);
     }
 };
-} // end namespace
\ No newline at end of file
+} // end namespace
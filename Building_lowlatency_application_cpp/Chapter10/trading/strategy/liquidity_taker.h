@@ -3,23 +3,69 @@
 #include "common/logging.h"
 #include "order_manager.h"
 #include "feature_engine.h"
+#include "trade_engine.h"
 
 namespace Trading{
-class TradeEngine;
+// Follows aggressive trades once they make up enough of the traded quantity.
+// The callbacks are defined here so AlgoTradeEngine<LiquidityTaker> can inline them into its event loop.
 class LiquidityTaker{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::STRATEGY;
+    TradeEngine *trade_engine_ = nullptr;
     const FeatureEngine *feature_engine_ = nullptr;
     OrderManager *order_manager_ = nullptr;
     std::string time_str_;
     Logger *logger_ = nullptr;
     const TradeEngineCfgHashMap ticker_cfg_;
 public:
+    static constexpr auto ALGO_TYPE = AlgoType::TAKER;
+
     LiquidityTaker(Logger *logger, TradeEngine *trade_engine, FeatureEngine *feature_engine, OrderManager *order_manager
         , const TradeEngineCfgHashMap &ticker_cfg);
-    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book) noexcept->void;
 
-    auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *) noexcept->void;
+    auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *) noexcept -> void
+    {
+        LOG_DEBUG(*logger_, "%:% %() % ticker:% price:% side:%\n",
+                     __FILE__, __LINE__, __FUNCTION__,
+                     thu::getCurrentTimeStr(&time_str_),
+                     ticker_id, thu::priceToString(price).c_str(),
+                     thu::sideToString(side).c_str());
+    }
+
+    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book) noexcept -> void
+    {
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                     *market_update);
+        const auto bbo = book->getBBO();
+        const auto agg_qty_ratio = feature_engine_->getAggTradeQtyRatio(market_update->ticker_id_);
+        if (LIKELY(bbo->bid_price_ != Price_INVALID && bbo->ask_price_ != Price_INVALID && agg_qty_ratio != Feature_INVALID))
+        {
+            LOG_DEBUG(*logger_, "%:% %() % % agg-qty-ratio:%\n", __FILE__, __LINE__, __FUNCTION__,
+                         thu::getCurrentTimeStr(&time_str_),
+                         *bbo, agg_qty_ratio);
+            const auto clip = ticker_cfg_.at(market_update->ticker_id_).clip_;
+            const auto threshold = ticker_cfg_.at(market_update->ticker_id_).threshold_;
+            if (agg_qty_ratio >= threshold)
+            {
+                trade_engine_->traceDecision();
+                if (market_update->side_ == Side::BUY)
+                {
+                    order_manager_->moveOrders(market_update->ticker_id_, bbo->ask_price_, Price_INVALID, clip);
+                }
+                else
+                {
+                    order_manager_->moveOrders(market_update->ticker_id_, Price_INVALID, bbo->bid_price_, clip);
+                }
+            }
+        }
+    }
 
-    auto onOrderUpdate(const Exchange::MEClientResponse *client_response)noexcept ->void;
+    auto onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept -> void
+    {
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__,
+                     __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                     *client_response);
+        order_manager_->onOrderUpdate(client_response);
+    }
 };
 }
\ No newline at end of file
@@ -8,55 +8,54 @@
 using namespace thu;
 
 namespace Trading{
+// Quotes both sides around the fair price from the FeatureEngine, on TradeEngineCfg::layers_ price levels per side.
+// The callbacks are defined here so AlgoTradeEngine<MarketMaker> can inline them into its event loop.
 class MarketMaker{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::STRATEGY;
+    TradeEngine *trade_engine_ = nullptr;
     const FeatureEngine *feature_engine_ = nullptr;
     OrderManager *order_manager_ = nullptr;
     std::string time_str_;
     Logger *logger_ = nullptr;
     const TradeEngineCfgHashMap ticker_cfg_;
 public:
+    static constexpr auto ALGO_TYPE = AlgoType::MAKER;
+
     MarketMaker(Logger *logger, TradeEngine *trade_engine, const FeatureEngine *feature_engine
         , OrderManager *order_manager, const TradeEngineCfgHashMap &ticker_cfg);
-    //     : feature_engine_(feature_engine), order_manager_(order_manager), logger_(logger), ticker_cfg_(ticker_cfg)
-    // {
-    //     trade_engine->algoOnOrderBookUpdate_ = [this](auto ticker_id, auto price, auto side, auto book){
-    //         onOrderBookUpdate(ticker_id, price, side, book);
-    //     };
-    //     trade_engine->algoOnTradeUpdate_ = [this](auto market_update, auto book){
-    //         onTradeUpdate(market_update, book);
-    //     };
-    //     trade_engine->algoOnOrderUpdate_ = [this](auto client_response){
-    //         onOrderUpdate(client_response);
-    //     };
-    // }
 
-    auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, const MarketOrderBook *book) noexcept->void;
-    //     logger_->log("%:% %() % ticker:% price:% side:%\n",
-    //                  __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), ticker_id, priceToString(price).c_str(), sideToString(side).c_str());
-    //     const auto bbo = book->getBBO();
-    //     const auto fair_price = feature_engine_->getMktPrice();
-    //     if(LIKELY(bbo->bid_price_ != Price_INVALID && bbo->ask_price_ != Price_INVALID && fair_price != Feature_INVALID)){
-    //         logger_->log("%:% %() % % fair-price:%\n", __FILE__, __LINE__, __FUNCTION__,
-    //                      thu::getCurrentTimeStr(&time_str_),
-    //                      bbo->toString().c_str(), fair_price);
-    //         const auto clip = ticker_cfg_.at(ticker_id).clip_;
-    //         const auto threshold = ticker_cfg_.at(ticker_id).threshold_;
-    //         const auto bid_price = bbo->bid_price_ - (fair_price - bbo->bid_price_ >= threshold ? 0 : 1);
-    //         const auto ask_price = bbo->ask_price_ - (fair_price - bbo->ask_price_ >= threshold ? 0 : 1);
-    //         order_manager_->moveOrders(ticker_id, bid_price, ask_price, clip);
-    //     }
-    // }
+    auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, const MarketOrderBook *book) noexcept -> void
+    {
+        LOG_DEBUG(*logger_, "%:% %() % ticker:% price:% side:%\n",
+                     __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), ticker_id, priceToString(price).c_str(), sideToString(side).c_str());
+        const auto bbo = book->getBBO();
+        const auto fair_price = feature_engine_->getMktPrice(ticker_id);
+        if (LIKELY(bbo->bid_price_ != Price_INVALID && bbo->ask_price_ != Price_INVALID && fair_price != Feature_INVALID))
+        {
+            LOG_DEBUG(*logger_, "%:% %() % % fair-price:%\n", __FILE__, __LINE__, __FUNCTION__,
+                         thu::getCurrentTimeStr(&time_str_),
+                         *bbo, fair_price);
+            const auto clip = ticker_cfg_.at(ticker_id).clip_;
+            const auto threshold = ticker_cfg_.at(ticker_id).threshold_;
+            const auto bid_price = bbo->bid_price_ - (fair_price - bbo->bid_price_ >= threshold ? 0 : 1);
+            const auto ask_price = bbo->ask_price_ + (bbo->ask_price_ - fair_price >= threshold ? 0 : 1);
+            trade_engine_->traceDecision();
+            order_manager_->moveOrders(ticker_id, bid_price, ask_price, clip, ticker_cfg_.at(ticker_id).layers_);
+        }
+    }
 
-    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *) noexcept->void;
-    //     logger_->log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-    //                market_update->toString().c_str());
-    // }
+    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *) noexcept -> void
+    {
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                     *market_update);
+    }
 
-    auto onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept->void;
-    //     logger_->log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-    //                client_response->toString().c_str());
-    //     order_manager_->onOrderUpdate(client_response);
-    // }
+    auto onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept -> void
+    {
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                     *client_response);
+        order_manager_->onOrderUpdate(client_response);
+    }
 };
 }; // end namespace
\ No newline at end of file
@@ -4,13 +4,10 @@ namespace Trading{
         std::stringstream ss;
         ss << "MarketOrder"
            << " ["
-           << "oid:" << orderIdToString(order_id_) << " "
            << "side:" << sideToString(side_) << " "
            << "price:" << priceToString(price_) << " "
-           << "prio:" << priorityToString(priority_) << " "
-           << "prev:" << orderIdToString(prev_order_ ? prev_order_->order_id_ : OrderId_INVALID) << " "
-           << "next:" << orderIdToString(next_order_ ? next_order_->order_id_ : OrderId_INVALID)
+           << "qty:" << qtyToString(qty_)
            << "]";
         return ss.str();
     }
-}
\ No newline at end of file
+}
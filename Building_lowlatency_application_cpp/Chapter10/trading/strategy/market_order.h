@@ -4,64 +4,36 @@
 #include "common/types.h"
 using namespace thu;
 namespace Trading{
+// What the book remembers of a single order, only read to resolve MODIFY and CANCEL updates which carry
+// the order id but not always the quantity the order had.
 struct MarketOrder{
-    // TickerId ticker_id_ = TickerId_INVALID;
-    // ClientId client_id_ = ClientId_INVALID;
-    // OrderId client_order_id_ = OrderId_INVALID;
-    OrderId order_id_ = OrderId_INVALID;
-    Side side_ = Side::INVALID;
     Price price_ =  Price_INVALID;
     Qty qty_ = Qty_INVALID;
-    Priority priority_ = Priority_INVALID;
-    MarketOrder *prev_order_ = nullptr;
-    MarketOrder *next_order_ = nullptr;
-    // use with Mempool
-    MarketOrder() = default;
-    MarketOrder(OrderId order_id
-        , Side side
-        , Price price
-        , Qty qty
-        , Priority priority
-        , MarketOrder *prev_order
-        , MarketOrder *next_order)
-        : order_id_(order_id)
-        , side_(side)
-        , price_(price)
-        , qty_(qty)
-        , priority_(priority)
-        , prev_order_(prev_order)
-        , next_order_(next_order)
-    {}
+    Side side_ = Side::INVALID;
 
     auto toString() const -> std::string;
 };
+static_assert(sizeof(MarketOrder) == 16);
 
-struct MarketOrdersAtPrice{
-    Side side_ = Side::INVALID;
-    Price price_ =  Price_INVALID;
-    MarketOrder *first_mkt_order_ = nullptr;
-    MarketOrdersAtPrice *prev_entry_ = nullptr;
-    MarketOrdersAtPrice *next_entry_ = nullptr;
-
-    MarketOrdersAtPrice() = default;
-    MarketOrdersAtPrice(Side side, Price price, MarketOrder *first_mkt_order, MarketOrdersAtPrice *prev_entry, MarketOrdersAtPrice *next_entry)
-    : side_(side), price_(price), first_mkt_order_(first_mkt_order), prev_entry_(prev_entry), next_entry_(next_entry)
-    {}
+// Aggregate of all orders resting at one price, four levels per cache line
+struct MarketPriceLevel{
+    Price price_ = Price_INVALID;
+    Qty qty_ = 0;
+    uint32_t num_orders_ = 0;
 
     auto toString() const
     {
         std::stringstream ss;
-        ss << "MarketOrdersAtPrice"
+        ss << "MarketPriceLevel"
            << " ["
-           << "side:" << sideToString(side_) << " "
-           << "price:" << priceToString(price_)
-           << "first_mkt_order:" << (first_mkt_order_ ? first_mkt_order_->toString() : "null") << " "
-           << "prev:" << priceToString(prev_entry_ ? prev_entry_->price_ : Price_INVALID) << " "
-           << "next:" << priceToString(next_entry_ ? next_entry_->price_ : Price_INVALID) << " "
+           << "price:" << priceToString(price_) << " "
+           << "qty:" << qtyToString(qty_) << " "
+           << "orders:" << num_orders_
            << "]";
         return ss.str();
     }
 };
+static_assert(sizeof(MarketPriceLevel) == 16);
 
 // represent total quantity at best bid and ask prices
 struct BBO{
@@ -78,7 +50,7 @@ struct BBO{
     }
 };
 
-typedef std::array<MarketOrdersAtPrice *, ME_MAX_PRICE_LEVELS> OrdersAtPriceHashMap;
-typedef std::array<MarketOrder *, ME_MAX_ORDER_IDS> OrderHashMap;
+typedef std::array<MarketPriceLevel, ME_MAX_PRICE_LEVELS> PriceLevelHashMap;
+typedef std::array<MarketOrder, ME_MAX_ORDER_IDS> OrderHashMap;
 
-} // end namespace
\ No newline at end of file
+} // end namespace
@@ -1,79 +1,51 @@
 #include "market_order_book.h"
-#include "trade_engine.h"
 namespace Trading
 {
     MarketOrderBook::MarketOrderBook(TickerId ticker_id, Logger *logger)
-        : ticker_id_(ticker_id), orders_at_price_pool_(ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS), logger_(logger)
+        : ticker_id_(ticker_id), logger_(logger)
     {
     }
 
     MarketOrderBook::~MarketOrderBook()
     {
-        logger_->log("%:% %() % OrderBook\n%\n", __FILE__, __LINE__, __FUNCTION__,
+        LOG_DEBUG(*logger_, "%:% %() % OrderBook\n%\n", __FILE__, __LINE__, __FUNCTION__,
                      thu::getCurrentTimeStr(&time_str_), toString(false, true));
-        trade_engine_ = nullptr;
-        bids_by_price_ = asks_by_price_ = nullptr;
-        oid_to_order_.fill(nullptr);
-    }
-    auto MarketOrderBook::setTradeEngine(TradeEngine *trade_engine) -> void
-    {
-        trade_engine_ = trade_engine;
     }
+
     auto MarketOrderBook::onMarketUpdate(const Exchange::MEMarketUpdate *market_update) noexcept -> void
     {
-        const auto bid_updated = (bids_by_price_ && market_update->side_ == Side::BUY && market_update->price_ >= bids_by_price_->price_);
-        const auto ask_updated = (asks_by_price_ && market_update->side_ == Side::SELL && market_update->price_ <= asks_by_price_->price_);
         switch (market_update->type_)
         {
         case Exchange::MarketUpdateType::ADD:
         {
-            auto order = order_pool_.allocate(market_update->order_id_, market_update->side_, market_update->price_, market_update->qty_, market_update->priority_, nullptr, nullptr);
-            addOrder(order);
+            oid_to_order_.at(market_update->order_id_) = {market_update->price_, market_update->qty_, market_update->side_};
+            addToLevel(market_update->side_, market_update->price_, market_update->qty_);
         }
         break;
         case Exchange::MarketUpdateType::MODIFY:
         {
-            auto order = oid_to_order_.at(market_update->order_id_);
-            order->qty_ = market_update->qty_;
+            auto &order = oid_to_order_.at(market_update->order_id_);
+            auto &level = bookSide(order.side_).levels_[priceToIndex(order.price_)];
+            level.qty_ = level.qty_ - order.qty_ + market_update->qty_;
+            order.qty_ = market_update->qty_;
         }
         break;
         case Exchange::MarketUpdateType::CANCEL:
         {
-            auto order = oid_to_order_.at(market_update->order_id_);
-            removeOrder(order);
+            auto &order = oid_to_order_.at(market_update->order_id_);
+            removeFromLevel(order.side_, order.price_, order.qty_);
+            order = {};
         }
         break;
-        case Exchange::MarketUpdateType::TRADE:
-        {
-            trade_engine_->onTradeUpdate(market_update, this);
+        case Exchange::MarketUpdateType::TRADE: // leaves the book as it is, the trade engine passes it on as is
             return;
-        }
         case Exchange::MarketUpdateType::CLEAR:
         {
-            for (auto &order : oid_to_order_)
-            {
-                if (order)
-                    order_pool_.deallocate(order);
-            }
-            oid_to_order_.fill(nullptr);
-            if (bids_by_price_)
-            {
-                for (auto bid = bids_by_price_->next_entry_; bid != bids_by_price_; bid = bid->next_entry_)
-                {
-                    orders_at_price_pool_.deallocate(bid);
-                }
-                orders_at_price_pool_.deallocate(bids_by_price_);
-            }
-            if (asks_by_price_)
-            {
-                for (auto ask = asks_by_price_->next_entry_; ask != asks_by_price_; ask = ask->next_entry_)
-                {
-                    orders_at_price_pool_.deallocate(ask);
-                }
-                orders_at_price_pool_.deallocate(asks_by_price_);
-            }
-            bids_by_price_ = asks_by_price_ = nullptr;
+            oid_to_order_.fill({});
+            bids_ = {};
+            asks_ = {};
         }
+        break;
         case Exchange::MarketUpdateType::INVALID:
         case Exchange::MarketUpdateType::SNAPSHOT_END:
         case Exchange::MarketUpdateType::SNAPSHOT_START:
@@ -81,90 +53,88 @@ namespace Trading
             break;
         }
 
-        updateBBO(bid_updated, ask_updated);
-        trade_engine_->onOrderBookUpdate(market_update->ticker_id_, market_update->price_, market_update->side_, this);
-        logger_->log("%:% %() % OrderBook\n%\n", __FILE__, __LINE__, __FUNCTION__,
+        updateBBO();
+        LOG_DEBUG(*logger_, "%:% %() % OrderBook\n%\n", __FILE__, __LINE__, __FUNCTION__,
                      thu::getCurrentTimeStr(&time_str_), toString(false, true));
     }
-    auto MarketOrderBook::updateBBO(bool update_bid, bool update_ask) noexcept -> void
+
+    auto MarketOrderBook::nextOccupied(const BookSide &book_side, Side side, size_t start) noexcept -> size_t
     {
-        if (update_bid)
-        {
-            if (bids_by_price_)
-            {
-                bbo_.bid_price_ = bids_by_price_->price_;
-                bbo_.bid_qty_ = bids_by_price_->first_mkt_order_->qty_;
-                for (auto order = bids_by_price_->first_mkt_order_->next_order_; order != bids_by_price_->first_mkt_order_; order = order->next_order_)
-                {
-                    bbo_.bid_qty_ += order->qty_;
-                }
-            }
-            else
-            {
-                bbo_.bid_price_ = Price_INVALID;
-                bbo_.bid_qty_ = Qty_INVALID;
-            }
-        }
-        if (update_ask)
+        const auto bit = start % 64;
+        for (size_t n = 0; n <= OCCUPIED_WORDS; ++n)
         {
-            if (asks_by_price_)
+            if (side == Side::SELL)
             {
-                bbo_.ask_price_ = asks_by_price_->price_;
-                bbo_.ask_qty_ = asks_by_price_->first_mkt_order_->qty_;
-                for (auto order = asks_by_price_->first_mkt_order_->next_order_; order != asks_by_price_->first_mkt_order_; order = order->next_order_)
-                {
-                    bbo_.ask_qty_ += order->qty_;
-                }
+                const auto word_index = (start / 64 + n) % OCCUPIED_WORDS;
+                auto word = book_side.occupied_[word_index];
+                if (n == 0)
+                    word &= ~uint64_t{0} << bit;                // start and above
+                else if (n == OCCUPIED_WORDS)
+                    word &= ~(~uint64_t{0} << bit);             // wrapped round to below start
+                if (word)
+                    return word_index * 64 + std::countr_zero(word);
             }
             else
             {
-                bbo_.ask_price_ = Price_INVALID;
-                bbo_.ask_qty_ = Qty_INVALID;
+                const auto word_index = (start / 64 + OCCUPIED_WORDS - n % OCCUPIED_WORDS) % OCCUPIED_WORDS;
+                auto word = book_side.occupied_[word_index];
+                if (n == 0)
+                    word &= ~uint64_t{0} >> (63 - bit);         // start and below
+                else if (n == OCCUPIED_WORDS)
+                    word &= ~(~uint64_t{0} >> (63 - bit));      // wrapped round to above start
+                if (word)
+                    return word_index * 64 + 63 - std::countl_zero(word);
             }
         }
+        return ME_MAX_PRICE_LEVELS;
     }
 
-    auto MarketOrderBook::addOrder(MarketOrder *order) noexcept -> void
+    auto MarketOrderBook::addToLevel(Side side, Price price, Qty qty) noexcept -> void
     {
-        const auto orders_at_price = getOrdersAtPrice(order->price_);
-        if (!orders_at_price)
+        auto &book_side = bookSide(side);
+        const auto index = priceToIndex(price);
+        auto &level = book_side.levels_[index];
+        if (!level.num_orders_)
         {
-            order->next_order_ = order->prev_order_ = order;
-            auto new_orders_at_price = orders_at_price_pool_.allocate(order->side_, order->price_, order, nullptr, nullptr);
-            addOrdersAtPrice(new_orders_at_price);
+            level.price_ = price;
+            book_side.occupied_[index / 64] |= uint64_t{1} << (index % 64);
+            if (isBetter(side, price, book_side.best_price_))
+                book_side.best_price_ = price;
         }
-        else
-        {
-            auto first_order = (orders_at_price ? orders_at_price->first_mkt_order_ : nullptr); // copied from git
-            first_order->prev_order_->next_order_ = order;
-            order->prev_order_ = first_order->prev_order_;
-            order->next_order_ = first_order;
-            first_order->prev_order_ = order;
+        if (UNLIKELY(level.price_ != price)) {
+            FATAL("Price " + priceToString(price) + " collides with " + level.toString() +
+                  ", book side wider than ME_MAX_PRICE_LEVELS.");
         }
-        oid_to_order_.at(order->order_id_) = order;
+        level.qty_ += qty;
+        ++level.num_orders_;
     }
 
-    auto MarketOrderBook::removeOrder(MarketOrder *order) noexcept -> void
+    auto MarketOrderBook::removeFromLevel(Side side, Price price, Qty qty) noexcept -> void
     {
-        auto orders_at_price = getOrdersAtPrice(order->price_);
-        if (order->prev_order_ == order)
-        { // only one element
-            removeOrdersAtPrice(order->side_, order->price_);
-        }
-        else
-        { // remove the link
-            const auto order_before = order->prev_order_;
-            const auto order_after = order->next_order_;
-            order_before->next_order_ = order_after;
-            order_after->prev_order_ = order_before;
-            if (orders_at_price->first_mkt_order_ == order)
-            {
-                orders_at_price->first_mkt_order_ = order_after;
-            }
-            order->prev_order_ = order->next_order_ = nullptr;
+        auto &book_side = bookSide(side);
+        const auto index = priceToIndex(price);
+        auto &level = book_side.levels_[index];
+        level.qty_ -= qty;
+        if (--level.num_orders_)
+            return;
+
+        level = {};
+        book_side.occupied_[index / 64] &= ~(uint64_t{1} << (index % 64));
+        if (price == book_side.best_price_)
+        {
+            const auto next = nextOccupied(book_side, side, index);
+            book_side.best_price_ = (next == ME_MAX_PRICE_LEVELS ? Price_INVALID : book_side.levels_[next].price_);
         }
-        oid_to_order_.at(order->order_id_) = nullptr;
-        order_pool_.deallocate(order);
+    }
+
+    auto MarketOrderBook::updateBBO() noexcept -> void
+    {
+        const auto &best_bid = bids_.levels_[priceToIndex(bids_.best_price_)];
+        const auto &best_ask = asks_.levels_[priceToIndex(asks_.best_price_)];
+        bbo_.bid_price_ = bids_.best_price_;
+        bbo_.bid_qty_ = (bids_.best_price_ != Price_INVALID ? best_bid.qty_ : Qty_INVALID);
+        bbo_.ask_price_ = asks_.best_price_;
+        bbo_.ask_qty_ = (asks_.best_price_ != Price_INVALID ? best_ask.qty_ : Qty_INVALID);
     }
 
     auto MarketOrderBook::toString(bool detailed, bool validity_check) const -> std::string
@@ -172,81 +142,49 @@ namespace Trading
         std::stringstream ss;
         std::string time_str;
 
-        auto printer = [&](std::stringstream &ss, MarketOrdersAtPrice *itr, Side side, Price &last_price,
-                           bool sanity_check)
+        auto printer = [&](const BookSide &book_side, Side side)
         {
-            char buf[4096];
-            Qty qty = 0;
-            size_t num_orders = 0;
-
-            for (auto o_itr = itr->first_mkt_order_;; o_itr = o_itr->next_order_)
+            std::array<MarketPriceLevel, ME_MAX_PRICE_LEVELS> levels;
+            const auto n = getLevels(side, levels);
+            auto last_price = Price_INVALID;
+            for (size_t count = 0; count < n; ++count)
             {
-                qty += o_itr->qty_;
-                ++num_orders;
-                if (o_itr->next_order_ == itr->first_mkt_order_)
-                    break;
-            }
-            sprintf(buf, " <px:%3s p:%3s n:%3s> %-3s @ %-5s(%-4s)",
-                    priceToString(itr->price_).c_str(), priceToString(itr->prev_entry_->price_).c_str(),
-                    priceToString(itr->next_entry_->price_).c_str(),
-                    priceToString(itr->price_).c_str(), qtyToString(qty).c_str(), std::to_string(num_orders).c_str());
-            ss << buf;
-            for (auto o_itr = itr->first_mkt_order_;; o_itr = o_itr->next_order_)
-            {
-                if (detailed)
+                const auto &level = levels[count];
+                char buf[4096];
+                sprintf(buf, " <px:%3s> %-5s(%-4s)", priceToString(level.price_).c_str(), qtyToString(level.qty_).c_str(),
+                        std::to_string(level.num_orders_).c_str());
+                ss << (side == Side::BUY ? "BIDS" : "ASKS") << " L:" << count << " =>" << buf << std::endl;
+
+                if (validity_check)
                 {
-                    sprintf(buf, "[oid:%s q:%s p:%s n:%s] ",
-                            orderIdToString(o_itr->order_id_).c_str(), qtyToString(o_itr->qty_).c_str(),
-                            orderIdToString(o_itr->prev_order_ ? o_itr->prev_order_->order_id_ : OrderId_INVALID).c_str(),
-                            orderIdToString(o_itr->next_order_ ? o_itr->next_order_->order_id_ : OrderId_INVALID).c_str());
-                    ss << buf;
+                    if (last_price != Price_INVALID && !isBetter(side, last_price, level.price_))
+                    {
+                        FATAL("Bids/Asks not sorted by ascending/descending prices last:" + priceToString(last_price) + " level:" +
+                              level.toString());
+                    }
+                    if (count == 0 && level.price_ != book_side.best_price_)
+                    {
+                        FATAL("Best price " + priceToString(book_side.best_price_) + " is not the first level:" + level.toString());
+                    }
+                    last_price = level.price_;
                 }
-                if (o_itr->next_order_ == itr->first_mkt_order_)
-                    break;
             }
-
-            ss << std::endl;
-
-            if (sanity_check)
+            if (detailed)
             {
-                if ((side == Side::SELL && last_price >= itr->price_) || (side == Side::BUY && last_price <= itr->price_))
-                {
-                    FATAL("Bids/Asks not sorted by ascending/descending prices last:" + priceToString(last_price) + " itr:" +
-                          itr->toString());
-                }
-                last_price = itr->price_;
+                size_t num_orders = 0;
+                for (const auto &order : oid_to_order_)
+                    num_orders += (order.side_ == side);
+                ss << (side == Side::BUY ? "BIDS" : "ASKS") << " orders:" << num_orders << std::endl;
             }
         };
 
         ss << "Ticker:" << TickerIdToString(ticker_id_) << std::endl;
-        {
-            auto ask_itr = asks_by_price_;
-            auto last_ask_price = std::numeric_limits<Price>::min();
-            for (size_t count = 0; ask_itr; ++count)
-            {
-                ss << "ASKS L:" << count << " => ";
-                auto next_ask_itr = (ask_itr->next_entry_ == asks_by_price_ ? nullptr : ask_itr->next_entry_);
-                printer(ss, ask_itr, Side::SELL, last_ask_price, validity_check);
-                ask_itr = next_ask_itr;
-            }
-        }
-
+        printer(asks_, Side::SELL);
         ss << std::endl
            << "                          X" << std::endl
            << std::endl;
-
-        {
-            auto bid_itr = bids_by_price_;
-            auto last_bid_price = std::numeric_limits<Price>::max();
-            for (size_t count = 0; bid_itr; ++count)
-            {
-                ss << "BIDS L:" << count << " => ";
-                auto next_bid_itr = (bid_itr->next_entry_ == bids_by_price_ ? nullptr : bid_itr->next_entry_);
-                printer(ss, bid_itr, Side::BUY, last_bid_price, validity_check);
-                bid_itr = next_bid_itr;
-            }
-        }
+        printer(bids_, Side::BUY);
 
         return ss.str();
     }
-}
\ No newline at end of file
+}
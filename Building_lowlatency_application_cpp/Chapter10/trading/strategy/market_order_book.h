@@ -1,114 +1,94 @@
 #pragma once
+#include <bit>
 #include "common/types.h"
-#include "common/memory_pool.h"
 #include "common/logging.h"
 #include "market_order.h"
 #include "exchange/market_data/market_update.h"
 namespace Trading{
-class TradeEngine;
+// Client side view of one ticker, reduced to what the strategies read: aggregated quantity and order count per price.
+// Each side keeps its levels in a flat array indexed by price and a bitmap of the occupied ones, so an update touches
+// one level and the best price moves incrementally; only removing the best level scans the bitmap for the next one.
+// Live prices of one side must lie within ME_MAX_PRICE_LEVELS of each other.
 class MarketOrderBook final{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::TRADE_ENGINE;
+    static constexpr size_t OCCUPIED_WORDS = ME_MAX_PRICE_LEVELS / 64;
+    static_assert(ME_MAX_PRICE_LEVELS % 64 == 0);
+
+    struct BookSide{
+        PriceLevelHashMap levels_;
+        std::array<uint64_t, OCCUPIED_WORDS> occupied_ = {};
+        Price best_price_ = Price_INVALID;
+    };
+
     const TickerId ticker_id_;
-    TradeEngine *trade_engine_ = nullptr;
-    OrderHashMap oid_to_order_;
-    MemPool<MarketOrdersAtPrice> orders_at_price_pool_;
-    MarketOrdersAtPrice *bids_by_price_ = nullptr;
-    MarketOrdersAtPrice *asks_by_price_ = nullptr;
-    OrdersAtPriceHashMap price_orders_at_price_;
-    MemPool<MarketOrder> order_pool_;
+    BookSide bids_, asks_;
     BBO bbo_;
+    OrderHashMap oid_to_order_;
     std::string time_str_;
     Logger *logger_;
+
+    auto bookSide(Side side) noexcept -> BookSide&{
+        return side == Side::BUY ? bids_ : asks_;
+    }
+    auto bookSide(Side side) const noexcept -> const BookSide&{
+        return side == Side::BUY ? bids_ : asks_;
+    }
+    static auto isBetter(Side side, Price price, Price than) noexcept{
+        return than == Price_INVALID || (side == Side::BUY ? price > than : price < than);
+    }
+
+    // Next occupied index from start, walking towards worse prices: down for bids, up for asks, wrapping around.
+    // ME_MAX_PRICE_LEVELS if the side is empty.
+    static auto nextOccupied(const BookSide &book_side, Side side, size_t start) noexcept -> size_t;
+
+    auto addToLevel(Side side, Price price, Qty qty) noexcept -> void;
+    auto removeFromLevel(Side side, Price price, Qty qty) noexcept -> void;
+
 public:
     MarketOrderBook(TickerId ticker_id, Logger *logger);
     ~MarketOrderBook();
-    auto setTradeEngine(TradeEngine *trade_engine)->void;
+    MarketOrderBook() = delete;
+    MarketOrderBook(const MarketOrderBook&) = delete;
+    MarketOrderBook& operator=(const MarketOrderBook&) = delete;
+
     auto onMarketUpdate(const Exchange::MEMarketUpdate *market_update) noexcept ->void;
-    auto updateBBO(bool update_bid, bool update_ask) noexcept ->void;
+    auto updateBBO() noexcept ->void;
     auto priceToIndex(Price price) const noexcept{
         return (price % ME_MAX_PRICE_LEVELS);
     }
-    auto getOrdersAtPrice(Price price) const noexcept->MarketOrdersAtPrice*{
-        return price_orders_at_price_.at(priceToIndex(price));
-    }
-    auto addOrder(MarketOrder *order) noexcept ->void;
-    auto removeOrder(MarketOrder *order) noexcept->void;
-    auto addOrdersAtPrice(MarketOrdersAtPrice *new_orders_at_price) noexcept {
-      price_orders_at_price_.at(priceToIndex(new_orders_at_price->price_)) = new_orders_at_price;
-
-      const auto best_orders_by_price = (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_);
-      if (UNLIKELY(!best_orders_by_price)) {
-        (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_) = new_orders_at_price;
-        new_orders_at_price->prev_entry_ = new_orders_at_price->next_entry_ = new_orders_at_price;
-      } else {
-        auto target = best_orders_by_price;
-        bool add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
-                          (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
-        if (add_after) {
-          target = target->next_entry_;
-          add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
-                       (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
-        }
-        while (add_after && target != best_orders_by_price) {
-          add_after = ((new_orders_at_price->side_ == Side::SELL && new_orders_at_price->price_ > target->price_) ||
-                       (new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ < target->price_));
-          if (add_after)
-            target = target->next_entry_;
-        }
-
-        if (add_after) { // add new_orders_at_price after target.
-          if (target == best_orders_by_price) {
-            target = best_orders_by_price->prev_entry_;
-          }
-          new_orders_at_price->prev_entry_ = target;
-          target->next_entry_->prev_entry_ = new_orders_at_price;
-          new_orders_at_price->next_entry_ = target->next_entry_;
-          target->next_entry_ = new_orders_at_price;
-        } else { // add new_orders_at_price before target.
-          new_orders_at_price->prev_entry_ = target->prev_entry_;
-          new_orders_at_price->next_entry_ = target;
-          target->prev_entry_->next_entry_ = new_orders_at_price;
-          target->prev_entry_ = new_orders_at_price;
 
-          if ((new_orders_at_price->side_ == Side::BUY && new_orders_at_price->price_ > best_orders_by_price->price_) ||
-              (new_orders_at_price->side_ == Side::SELL &&
-               new_orders_at_price->price_ < best_orders_by_price->price_)) {
-            target->next_entry_ = (target->next_entry_ == best_orders_by_price ? new_orders_at_price
-                                                                               : target->next_entry_);
-            (new_orders_at_price->side_ == Side::BUY ? bids_by_price_ : asks_by_price_) = new_orders_at_price;
-          }
-        }
-      }
+    auto getBBO() const noexcept->const BBO*{
+        return &bbo_;
     }
 
-    /// Remove the MarketOrdersAtPrice from the containers - the hash map and the doubly linked list of price levels.
-    auto removeOrdersAtPrice(Side side, Price price) noexcept {
-      const auto best_orders_by_price = (side == Side::BUY ? bids_by_price_ : asks_by_price_);
-      auto orders_at_price = getOrdersAtPrice(price);
-
-      if (UNLIKELY(orders_at_price->next_entry_ == orders_at_price)) { // empty side of book.
-        (side == Side::BUY ? bids_by_price_ : asks_by_price_) = nullptr;
-      } else {
-        orders_at_price->prev_entry_->next_entry_ = orders_at_price->next_entry_;
-        orders_at_price->next_entry_->prev_entry_ = orders_at_price->prev_entry_;
+    // Aggregate at price, num_orders_ is 0 if nothing rests there
+    auto getLevel(Side side, Price price) const noexcept -> MarketPriceLevel{
+        const auto &level = bookSide(side).levels_[priceToIndex(price)];
+        return level.price_ == price ? level : MarketPriceLevel{price, 0, 0};
+    }
 
-        if (orders_at_price == best_orders_by_price) {
-          (side == Side::BUY ? bids_by_price_ : asks_by_price_) = orders_at_price->next_entry_;
+    // Copies up to N levels of side, best first, and returns how many there were
+    template<size_t N>
+    auto getLevels(Side side, std::array<MarketPriceLevel, N> &levels) const noexcept -> size_t{
+        const auto &book_side = bookSide(side);
+        if(book_side.best_price_ == Price_INVALID){
+            return 0;
         }
-
-        orders_at_price->prev_entry_ = orders_at_price->next_entry_ = nullptr;
-      }
-
-      price_orders_at_price_.at(priceToIndex(price)) = nullptr;
-
-      orders_at_price_pool_.deallocate(orders_at_price);
-    }
-    
-    auto getBBO() const noexcept->const BBO*{
-        return &bbo_;
+        const auto best_index = priceToIndex(book_side.best_price_);
+        size_t n = 0;
+        for(auto index = best_index; n < N; ){
+            levels[n++] = book_side.levels_[index];
+            index = nextOccupied(book_side, side, (side == Side::BUY ? index + ME_MAX_PRICE_LEVELS - 1 : index + 1) % ME_MAX_PRICE_LEVELS);
+            if(index == best_index || index == ME_MAX_PRICE_LEVELS){
+                break;
+            }
+        }
+        return n;
     }
+
     auto toString(bool detailed, bool validity_check) const ->std::string;
 };
 
 typedef std::array<MarketOrderBook *, ME_MAX_TICKERS> MarketOrderBookHashMap;
-}// end namespace
\ No newline at end of file
+}// end namespace
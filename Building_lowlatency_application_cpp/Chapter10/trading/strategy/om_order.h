@@ -37,6 +37,9 @@ struct OMOrder{
     Price price_ = Price_INVALID;
     Qty qty_ = Qty_INVALID;
     OMOrderState order_state_ = OMOrderState::INVALID;
+    size_t layer_ = 0;
+    // the live order this one takes the layer over from, cancelled once this one is accepted
+    OrderId replaces_order_id_ = OrderId_INVALID;
 
     auto toString() const{
         std::stringstream ss;
@@ -47,13 +50,28 @@ struct OMOrder{
            << "side:" << sideToString(side_) << " "
            << "price:" << priceToString(price_) << " "
            << "qty:" << qtyToString(qty_) << " "
-           << "state:" << OMOrderStateToString(order_state_)
+           << "state:" << OMOrderStateToString(order_state_) << " "
+           << "layer:" << layer_ << " "
+           << "replaces:" << orderIdToString(replaces_order_id_)
            << "]";
         return ss.str();
     }
 };
 
-typedef std::array<OMOrder, sideToIndex(Side::MAX) + 1> OMOrderSideHashMap;
+// Price levels a side can be quoted on, and the orders it can have out at once: per layer a live order, its pending
+// replacement and the orders still being cancelled
+constexpr size_t OM_MAX_LAYERS = 4;
+constexpr size_t OM_MAX_ORDERS_PER_SIDE = 4 * OM_MAX_LAYERS;
+
+struct OMOrderSide{
+    std::array<OMOrder, OM_MAX_ORDERS_PER_SIDE> orders_;
+    // newest order of each layer, nullptr while the layer has none
+    std::array<OMOrder *, OM_MAX_LAYERS> layer_orders_ = {};
+};
+
+typedef std::array<OMOrderSide, sideToIndex(Side::MAX) + 1> OMOrderSideHashMap;
 typedef std::array<OMOrderSideHashMap, ME_MAX_TICKERS> OMOrderTickerSideHashMap;
+// order id to the order, for the orders still out; ids wrap around ME_MAX_ORDER_IDS like the exchange's
+typedef std::array<OMOrder *, ME_MAX_ORDER_IDS> OMOrderIdHashMap;
 
 }// end namespace
\ No newline at end of file
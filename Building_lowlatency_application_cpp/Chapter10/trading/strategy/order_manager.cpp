@@ -5,6 +5,7 @@ namespace Trading
     OrderManager::OrderManager(Logger *logger, TradeEngine *trade_engine, RiskManager &risk_manager)
         : trade_engine_(trade_engine), risk_manager_(risk_manager), logger_(logger)
     {
+        order_id_order_.fill(nullptr);
     }
 
         auto OrderManager::newOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty) noexcept->void{
@@ -16,10 +17,12 @@ namespace Trading
             , price
             , qty};
         
+        trade_engine_->sendClientRequest(&new_request);
         *order = {ticker_id, next_order_id_, side, price, qty, OMOrderState::PENDING_NEW};
-        ++next_order_id_;
-        logger_->log("%:% %() % Sent new order % for %\n", __FILE__, __LINE__, __FUNCTION__,
-                 thu::getCurrentTimeStr(&time_str_), new_request.toString().c_str(), order->toString().c_str());
+        order_id_order_.at(next_order_id_) = order;
+        next_order_id_ = (next_order_id_ + 1) % ME_MAX_ORDER_IDS; // the exchange keeps ME_MAX_ORDER_IDS ids per client
+        LOG_AUDIT(*logger_, "%:% %() % Sent new order % for %\n", __FILE__, __LINE__, __FUNCTION__,
+                 thu::getCurrentTimeStr(&time_str_), new_request, *order);
     }
     auto OrderManager::cancelOrder(OMOrder *order) noexcept->void{
         const Exchange::MEClientRequest cancel_request{Exchange::ClientRequestType::CANCEL, trade_engine_->clientId()
@@ -30,7 +33,7 @@ namespace Trading
             , order->qty_};
         trade_engine_->sendClientRequest(&cancel_request);
         order->order_state_ = OMOrderState::PENDING_CANCEL;
-        logger_->log("%:% %() % Sent cancel % for %\n", __FILE__, __LINE__, __FUNCTION__,
-                 thu::getCurrentTimeStr(&time_str_), cancel_request.toString().c_str(), order->toString().c_str());
+        LOG_AUDIT(*logger_, "%:% %() % Sent cancel % for %\n", __FILE__, __LINE__, __FUNCTION__,
+                 thu::getCurrentTimeStr(&time_str_), cancel_request, *order);
     }
 }
\ No newline at end of file
@@ -10,12 +10,66 @@ namespace Trading{
 class TradeEngine;
 class OrderManager{
 private:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::STRATEGY;
     TradeEngine *trade_engine_ = nullptr;
     const RiskManager &risk_manager_;
     std::string time_str_;
     Logger *logger_ = nullptr;
     OMOrderTickerSideHashMap ticker_side_order_;
+    OMOrderIdHashMap order_id_order_;
     OrderId next_order_id_ = 1;
+
+    // An order of the side's pool that is not out, nullptr if all are
+    static auto freeOrder(OMOrderSide *order_side) noexcept -> OMOrder*{
+        for(auto &order : order_side->orders_){
+            if(order.order_state_ == OMOrderState::INVALID || order.order_state_ == OMOrderState::DEAD)
+                return &order;
+        }
+        return nullptr;
+    }
+
+    // What the side's orders that are out could still get filled for
+    static auto openQty(const OMOrderSide &order_side) noexcept{
+        Qty qty = 0;
+        for(const auto &order : order_side.orders_){
+            if(order.order_state_ != OMOrderState::INVALID && order.order_state_ != OMOrderState::DEAD)
+                qty += order.qty_;
+        }
+        return qty;
+    }
+
+    // Risk checks and sends a new order for the layer from the side's pool. nullptr if the pool or the limits leave no room.
+    auto sendLayerOrder(OMOrderSide *order_side, size_t layer, TickerId ticker_id, Price price, Side side, Qty qty) noexcept -> OMOrder*{
+        auto order = freeOrder(order_side);
+        if(UNLIKELY(!order))
+            return nullptr;
+        const auto risk_result = risk_manager_.checkPreTradeRisk(ticker_id, side, qty, openQty(*order_side));
+        if(UNLIKELY(risk_result != RiskCheckResult::ALLOWED)){
+            LOG_AUDIT(*logger_, "%:% %() % Ticker:% Side:% Qty:% Layer:% RiskCheckResult : %\n ", __FILE__, __LINE__, __FUNCTION__,
+                         thu::getCurrentTimeStr(&time_str_),
+                         TickerIdToString(ticker_id),
+                         sideToString(side),
+                         qtyToString(qty),
+                         layer,
+                         riskCheckResultToString(risk_result));
+            return nullptr;
+        }
+        newOrder(order, ticker_id, price, side, qty);
+        order->layer_ = layer;
+        order_side->layer_orders_.at(layer) = order;
+        return order;
+    }
+
+    // The order is off the book. Its layer goes back to the order it was to replace if it never got accepted.
+    auto retireOrder(OMOrder *order) noexcept{
+        order->order_state_ = OMOrderState::DEAD;
+        order_id_order_.at(order->order_id_) = nullptr;
+        auto &layer_order = ticker_side_order_.at(order->ticker_id_).at(sideToIndex(order->side_)).layer_orders_.at(order->layer_);
+        if(layer_order == order){
+            layer_order = (order->replaces_order_id_ != OrderId_INVALID) ? order_id_order_.at(order->replaces_order_id_) : nullptr;
+        }
+    }
+
 public:
     OrderManager(Logger *logger, TradeEngine *trade_engine, RiskManager &risk_manager);
     // : trade_engine_(trade_engine), risk_manager_(risk_manager), logger_(logger)
@@ -32,35 +86,31 @@ public:
     }
     auto newOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty) noexcept->void;
     auto cancelOrder(OMOrder *order) noexcept->void;
-    auto moveOrder(OMOrder *order, TickerId ticker_id, Price price, Side side, Qty qty) noexcept{
-        switch (order->order_state_)
+
+    // Quotes one layer of a side at price, Price_INVALID pulls it. A live order at another price is replaced
+    // make-before-break: it stays on the book until the new order is accepted, unless the pool or the risk limits leave
+    // no room for both, in which case it is cancelled first as a single order per side used to be.
+    auto moveOrder(OMOrderSide *order_side, size_t layer, TickerId ticker_id, Price price, Side side, Qty qty) noexcept{
+        auto order = order_side->layer_orders_.at(layer);
+        switch (order ? order->order_state_ : OMOrderState::DEAD)
         {
         case OMOrderState::LIVE:
         {
             if (order->price_ != price || order->qty_ != qty)
-                cancelOrder(order);
+            {
+                auto replacement = (price != Price_INVALID) ? sendLayerOrder(order_side, layer, ticker_id, price, side, qty) : nullptr;
+                if (replacement)
+                    replacement->replaces_order_id_ = order->order_id_;
+                else
+                    cancelOrder(order);
+            }
         }
         break;
         case OMOrderState::INVALID:
         case OMOrderState::DEAD:
         {
             if (LIKELY(price != Price_INVALID))
-            {
-                const auto risk_result = risk_manager_.checkPreTradeRisk(ticker_id, side, qty);
-                if (LIKELY(risk_result == RiskCheckResult::ALLOWED))
-                {
-                    newOrder(order, ticker_id, price, side, qty);
-                }
-                else
-                {
-                    logger_->log("%:% %() % Ticker:% Side:% Qty:% RiskCheckResult : %\n ", __FILE__, __LINE__, __FUNCTION__,
-                                 thu::getCurrentTimeStr(&time_str_),
-                                 TickerIdToString(ticker_id),
-                                 sideToString(side),
-                                 qtyToString(qty),
-                                 riskCheckResultToString(risk_result));
-                }
-            }
+                sendLayerOrder(order_side, layer, ticker_id, price, side, qty);
         }
         break;
         case OMOrderState::PENDING_NEW:
@@ -70,31 +120,56 @@ public:
         }
     }
 
-    auto moveOrders(TickerId ticker_id, Price bid_price, Price ask_price, Qty clip) noexcept{
-        auto bid_order = &(ticker_side_order_.at(ticker_id)).at(sideToIndex(Side::BUY));
-        moveOrder(bid_order, ticker_id, bid_price, Side::BUY, clip);
-        auto ask_order = &(ticker_side_order_.at(ticker_id)).at(sideToIndex(Side::SELL));
-        moveOrder(ask_order, ticker_id, ask_price, Side::SELL, clip);
+    // Quotes num_layers price levels per side, one tick apart going away from bid_price and ask_price, clip on each.
+    // Layers beyond num_layers are pulled.
+    auto moveOrders(TickerId ticker_id, Price bid_price, Price ask_price, Qty clip, size_t num_layers = 1) noexcept{
+        auto bid_orders = &(ticker_side_order_.at(ticker_id)).at(sideToIndex(Side::BUY));
+        auto ask_orders = &(ticker_side_order_.at(ticker_id)).at(sideToIndex(Side::SELL));
+        for (size_t layer = 0; layer < OM_MAX_LAYERS; ++layer)
+        {
+            const auto quoted = layer < num_layers;
+            const auto bid = (quoted && bid_price != Price_INVALID && bid_price > layer) ? bid_price - layer : Price_INVALID;
+            const auto ask = (quoted && ask_price != Price_INVALID) ? ask_price + layer : Price_INVALID;
+            moveOrder(bid_orders, layer, ticker_id, bid, Side::BUY, clip);
+            moveOrder(ask_orders, layer, ticker_id, ask, Side::SELL, clip);
+        }
     }
 
     auto onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept->void{
-        logger_->log("%:% %() % %\n", __FILE__, __LINE__,
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__,
                      __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                     client_response->toString().c_str());
-        auto order = &(ticker_side_order_.at(client_response->ticker_id_)).at(sideToIndex(client_response->side_));
-        logger_->log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), order->toString().c_str());
+                     *client_response);
+        auto order = order_id_order_.at(client_response->client_order_id_ % ME_MAX_ORDER_IDS);
+        if (UNLIKELY(!order))
+        {
+            // a cancel rejected because a fill took the order off the book first is expected
+            if (client_response->type_ != Exchange::ClientResponseType::CANCEL_REJECTED)
+                LOG_WARN(*logger_, "%:% %() % No order out for %\n", __FILE__, __LINE__, __FUNCTION__,
+                            thu::getCurrentTimeStr(&time_str_), *client_response);
+            return;
+        }
+        LOG_DEBUG(*logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_), *order);
         switch (client_response->type_)
         {
         case Exchange::ClientResponseType::ACCEPTED:
+        {
             order->order_state_ = OMOrderState::LIVE;
+            if (order->replaces_order_id_ != OrderId_INVALID)
+            {
+                auto replaced = order_id_order_.at(order->replaces_order_id_);
+                if (replaced && replaced->order_state_ == OMOrderState::LIVE)
+                    cancelOrder(replaced);
+                order->replaces_order_id_ = OrderId_INVALID;
+            }
+        }
             break;
         case Exchange::ClientResponseType::CANCELED:
-            order->order_state_ = OMOrderState::DEAD;
+            retireOrder(order);
             break;
         case Exchange::ClientResponseType::FILLED:{
             order->qty_ = client_response->leaves_qty_;
             if(!order->qty_)
-                order->order_state_ = OMOrderState::DEAD;
+                retireOrder(order);
         }
             break;
         case Exchange::ClientResponseType::CANCEL_REJECTED:
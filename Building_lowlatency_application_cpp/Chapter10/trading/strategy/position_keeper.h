@@ -6,80 +6,83 @@
 #include "market_order_book.h"
 using namespace thu;
 namespace Trading{
+// Money in PositionInfo is integer half ticks x qty: fills are in whole ticks and positions are marked at the mid, which
+// is in half ticks, so every update is exact and needs no floating point. It becomes ticks x qty as a double only to be
+// reported or checked against the loss limit.
+typedef int64_t HalfTicks;
+inline constexpr auto halfTicksToPnl(HalfTicks amount) noexcept{
+    return static_cast<double>(amount) * 0.5;
+}
+
 struct PositionInfo{
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::STRATEGY;
     int32_t position_ = 0;
-    double real_pnl_ = 0, unreal_pnl_ = 0, total_pnl_ = 0;
-    std::array<double, sideToIndex(Side::MAX) + 1> open_vwap_;
+    // received for sells less paid for buys, over all fills
+    HalfTicks cash_ = 0;
+    // what the open position cost at its average price, negative for a short
+    HalfTicks open_cost_ = 0;
+    // cash_ plus the position at the last mark
+    HalfTicks total_pnl_ = 0;
     Qty volume_ = 0;
     const BBO *bbo_ = nullptr;
+
+    auto realPnl() const noexcept{
+        return halfTicksToPnl(cash_ + open_cost_);
+    }
+    auto unrealPnl() const noexcept{
+        return halfTicksToPnl(total_pnl_ - cash_ - open_cost_);
+    }
+    auto totalPnl() const noexcept{
+        return halfTicksToPnl(total_pnl_);
+    }
+    // average price of the open position, 0 when flat
+    auto openVwap() const noexcept{
+        return position_ ? halfTicksToPnl(open_cost_) / position_ : 0;
+    }
+
     auto toString() const{
         std::stringstream ss;
         ss << "Position{"
            << "pos:" << position_
-           << "u-pnl:" << unreal_pnl_
-           << "r-pnl:" << real_pnl_
-           << "t-pnl:" << total_pnl_
+           << "u-pnl:" << unrealPnl()
+           << "r-pnl:" << realPnl()
+           << "t-pnl:" << totalPnl()
            << "vol:" << qtyToString(volume_)
-           << "vwaps:[" << (position_ ? open_vwap_.at(sideToIndex(Side::BUY)) / std::abs(position_) : 0)
-           << "X" << (position_ ? open_vwap_.at(sideToIndex(Side::SELL)) / std::abs(position_) : 0)
+           << "vwaps:[" << (position_ > 0 ? openVwap() : 0)
+           << "X" << (position_ < 0 ? openVwap() : 0)
            << "]"
            << (bbo_ ? bbo_->toString() : "") << "}";
         return ss.str();
     }
+    // The only division left is the integer one keeping open_cost_ at the average price when a fill reduces the position.
+    // Its rounding shifts a fraction of a tick per such fill between realized and unrealized PnL, the total stays exact.
     auto addFill(const Exchange::MEClientResponse *client_response, Logger *logger) noexcept{
         const auto old_position = position_;
-        const auto side_index = sideToIndex(client_response->side_);
-        const auto opp_side_index = sideToIndex(client_response->side_ == Side::BUY ? Side::SELL : Side::BUY);
-        const auto side_value = sideToIndex(client_response->side_);
-        position_ += client_response->exec_qty_ * side_value;
+        const auto side_value = sideToValue(client_response->side_);
+        const auto price = 2 * static_cast<HalfTicks>(client_response->price_);
+        const auto signed_qty = static_cast<int32_t>(client_response->exec_qty_) * side_value;
+        position_ += signed_qty;
         volume_ += client_response->exec_qty_;
-        if(old_position * sideToValue(client_response->side_) >= 0){
-            open_vwap_[side_index] += (client_response->price_ * client_response->exec_qty_);
+        cash_ -= price * signed_qty;
+        if(old_position * side_value >= 0){
+            open_cost_ += price * signed_qty;
+        }
+        else if((position_ > 0) == (old_position > 0) && position_){   // compared by sign, the product overflows int32
+            open_cost_ = open_cost_ * position_ / old_position;
         }
         else{
-            const auto opp_side_vwap = open_vwap_[opp_side_index]/std::abs(old_position);
-            open_vwap_[opp_side_index] = opp_side_vwap * std::abs(position_);
-            real_pnl_ += std::min(static_cast<int32_t>(client_response->exec_qty_), std::abs(old_position)) * (opp_side_vwap-client_response->price_) * sideToValue(client_response->side_);
-            if(position_ * old_position < 0){
-                open_vwap_[side_index] = client_response->price_ * std::abs(position_);
-                open_vwap_[opp_side_index] = 0;
-            }
-            if(!position_){
-                open_vwap_[sideToIndex(Side::BUY)] = open_vwap_[sideToIndex(Side::SELL)] = 0;
-                unreal_pnl_ = 0;
-            }
-            else{
-                if(position_ > 0){
-                    unreal_pnl_ = (client_response->price_ - open_vwap_[sideToIndex(Side::BUY)] / std::abs(position_)) * std::abs(position_);
-                }
-                else{
-                    unreal_pnl_ = (open_vwap_[sideToIndex(Side::SELL)] / std::abs(position_) - client_response->price_) * std::abs(position_);
-                }
-            }
-
-            total_pnl_ = unreal_pnl_ + real_pnl_;
-            std::string time_str;
-            logger->log("%:% %() % % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str),
-                        toString(), client_response->toString().c_str());
+            open_cost_ = price * position_;    // flat, or the rest of the fill opened the other way
         }
+        total_pnl_ = cash_ + price * position_;
+        std::string time_str;
+        LOG_DEBUG(*logger, "%:% %() % % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str),
+                    toString(), *client_response);
     }
 
-    auto updateBBO(const BBO *bbo, Logger *logger) noexcept{
-        std::string time_str;
+    auto updateBBO(const BBO *bbo) noexcept{
         bbo_ = bbo;
         if(position_ && bbo->bid_price_ != Price_INVALID && bbo->ask_price_ != Price_INVALID){
-            const auto mid_price = (bbo->bid_price_ + bbo->ask_price_) * 0.5;
-            if(position_ > 0){
-                unreal_pnl_ = (mid_price-open_vwap_[sideToIndex(Side::BUY)]/std::abs(position_)) * std::abs(position_);
-            }
-            else{
-                unreal_pnl_ = (open_vwap_[sideToIndex(Side::SELL)]/std::abs(position_) - mid_price) * std::abs(position_);
-            }
-            const auto old_total_pnl = total_pnl_;
-            total_pnl_ = unreal_pnl_ + real_pnl_;
-            if(total_pnl_ != old_total_pnl){
-                logger->log("%:% %() % % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str), toString(), bbo_->toString());
-            }
+            total_pnl_ = cash_ + static_cast<HalfTicks>(bbo->bid_price_ + bbo->ask_price_) * position_;
         }
     }
 }; // struct PositionInfo
@@ -96,7 +99,7 @@ public:
         return &(ticker_position_.at(ticker_id));
     }
     auto toString() const{
-        double total_pnl = 0;
+        HalfTicks total_pnl = 0;
         Qty total_vol = 0;
         std::stringstream ss;
         for(TickerId i = 0; i < ticker_position_.size(); i++){
@@ -104,14 +107,14 @@ public:
             total_pnl += ticker_position_.at(i).total_pnl_;
             total_vol += ticker_position_.at(i).volume_;
         }
-        ss << "Total PnL:" << total_pnl << " Vol:" << total_vol << "\n";
+        ss << "Total PnL:" << halfTicksToPnl(total_pnl) << " Vol:" << total_vol << "\n";
         return ss.str();
     }
     auto addFill(const Exchange::MEClientResponse *client_response) noexcept{
         ticker_position_.at(client_response->ticker_id_).addFill(client_response, logger_);
     }
     auto updateBBO(TickerId ticker_id, const BBO *bbo) noexcept{
-        ticker_position_.at(ticker_id).updateBBO(bbo, logger_);
+        ticker_position_.at(ticker_id).updateBBO(bbo);
     }
 }; // PositionKeeper
 
@@ -45,14 +45,15 @@ struct RiskInfo{
            << "]";
         return ss.str();
     }
-    auto checkPreTradeRisk(Side side, Qty qty) const noexcept{
+    // open_qty: what orders already out on that side could still add to the position
+    auto checkPreTradeRisk(Side side, Qty qty, Qty open_qty = 0) const noexcept{
         if(UNLIKELY(qty > risk_cfg_.max_order_size_))
             return RiskCheckResult::ORDER_TOO_LARGE;
-        if(UNLIKELY(std::abs(position_info_->position_ + sideToValue(side)*static_cast<int32_t>(qty)) 
+        if(UNLIKELY(std::abs(position_info_->position_ + sideToValue(side)*static_cast<int32_t>(qty + open_qty)) 
                             > static_cast<int32_t>(risk_cfg_.max_position_))){
             return RiskCheckResult::POSITION_TOO_LARGE;                        
         }
-        if(UNLIKELY(position_info_->total_pnl_ < risk_cfg_.max_loss_)){
+        if(UNLIKELY(position_info_->totalPnl() < risk_cfg_.max_loss_)){
             return RiskCheckResult::LOSS_TOO_LARGE;
         }
         return RiskCheckResult::ALLOWED;
@@ -75,8 +76,8 @@ public:
     //         ticker_risk_.at(i).risk_cfg_ = ticker_cfg[i].risk_cfg_;
     //     }
     // }
-    auto checkPreTradeRisk(TickerId ticker_id, Side side, Qty qty) const noexcept{
-        return ticker_risk_.at(ticker_id).checkPreTradeRisk(side, qty);
+    auto checkPreTradeRisk(TickerId ticker_id, Side side, Qty qty, Qty open_qty = 0) const noexcept{
+        return ticker_risk_.at(ticker_id).checkPreTradeRisk(side, qty, open_qty);
     }
 };
 } // end namespace
\ No newline at end of file
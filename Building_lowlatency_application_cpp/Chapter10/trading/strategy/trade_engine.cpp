@@ -1,11 +1,12 @@
 #include "trade_engine.h"
 namespace Trading{
-    TradeEngine::TradeEngine(ClientId client_id, AlgoType algo_type, const TradeEngineCfgHashMap &ticker_cfg, Exchange::ClientRequestLFQueue *client_requests, Exchange::ClientResponseLFQueue *client_responses, Exchange::MEMarketUpdateLFQueue *market_updates)
+    TradeEngine::TradeEngine(ClientId client_id, AlgoType algo_type, const TradeEngineCfgHashMap &ticker_cfg, Exchange::ClientRequestLFQueue *client_requests, Exchange::ClientResponseLFQueue *client_responses, Exchange::MEMarketUpdateLFQueue *market_updates, bool conflate_md, const std::string &log_file_name)
                             : client_id_(client_id)
                             , outgoing_ogw_requests_(client_requests)
                             , incoming_ogw_responses_(client_responses)
                             , incoming_md_updates_(market_updates)
-                            , logger_("trading_engine_" + std::to_string(client_id) + ".log")
+                            , conflate_md_(conflate_md)
+                            , logger_(log_file_name.empty() ? "trading_engine_" + std::to_string(client_id) + ".log" : log_file_name)
                             , feature_engine_(&logger_)
                             , position_keeper_(&logger_)
                             , order_manager_(&logger_, this, risk_manager_)
@@ -13,39 +14,21 @@ namespace Trading{
     {
         for(size_t i = 0; i < ticker_order_book_.size(); ++i){
             ticker_order_book_[i] = new MarketOrderBook(i, &logger_);
-            ticker_order_book_[i]->setTradeEngine(this);
-        }
-
-        algoOnOrderBookUpdate_ = [this](auto ticker_id, auto price, auto side, auto book){
-            defaultAlgoOnOrderBookUpdate(ticker_id, price, side, book);
-        };
-        algoOnTradeUpdate_ = [this](auto market_update, auto book){defaultAlgoOnTradeUpdate(market_update, book);};
-        algoOnOrderUpdate_ = [this](auto client_response){defaultAlgoOnOrderUpdate(client_response);};
-
-        if(algo_type == AlgoType::MAKER){
-            mm_algo_ = new MarketMaker(&logger_, this, &feature_engine_, &order_manager_, ticker_cfg);
-        }
-        else if(algo_type == AlgoType::TAKER){
-            taker_algo_ = new LiquidityTaker(&logger_, this, &feature_engine_, &order_manager_, ticker_cfg);
         }
 
         for(TickerId i =0; i < ticker_cfg.size(); ++i){
-            logger_.log("%:% %() % Initialized % Ticker:% %.\n", __FILE__, __LINE__, __FUNCTION__,
+            LOG_INFO(logger_, "%:% %() % Initialized % Ticker:% %.\n", __FILE__, __LINE__, __FUNCTION__,
                         thu::getCurrentTimeStr(&time_str_),
                         algoTypeToString(algo_type), i,
                         ticker_cfg.at(i).toString());
         }
+        LOG_INFO(logger_, "%:% %() % Market data conflation:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    thu::getCurrentTimeStr(&time_str_), conflate_md_);
     }
 
+    // The event loop was stopped by ~AlgoTradeEngine()
     TradeEngine::~TradeEngine()
     {
-        run_ = false;
-        using namespace std::literals::chrono_literals;
-        std::this_thread::sleep_for(1s);
-
-        delete mm_algo_; mm_algo_ = nullptr;
-        delete taker_algo_; taker_algo_ = nullptr;
-
         for(auto &order_book : ticker_order_book_){
             delete order_book;
             order_book = nullptr;
@@ -56,66 +39,38 @@ namespace Trading{
         incoming_md_updates_ = nullptr;
     }
 
-    auto TradeEngine::run() noexcept -> void
-    {
-        logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_));
-        while (run_)
-        {
-            for (auto client_response = incoming_ogw_responses_->getNextToRead();
-                 client_response; client_response = incoming_ogw_responses_->getNextToRead())
-            {
-                logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                            client_response->toString().c_str());
-                onOrderUpdate(client_response);
-                incoming_ogw_responses_->updateReadIndex();
-                last_event_time_ = getCurrentNanos();
-            }
-
-            for(auto market_update = incoming_md_updates_->getNextToRead(); market_update; market_update = incoming_md_updates_->getNextToRead())
-            {
-                logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                            market_update->toString().c_str());
-                ASSERT(market_update->ticker_id_ < ticker_order_book_.size(), "Unknown ticker-id on update:"+market_update->toString());
-                ticker_order_book_[market_update->ticker_id_]->onMarketUpdate(market_update);
-                incoming_md_updates_->updateReadIndex();
-                last_event_time_ = getCurrentNanos();
-            }
-        }
-    }
-    
     auto TradeEngine::sendClientRequest(const Exchange::MEClientRequest *client_request) noexcept -> void
     {
-        logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                    client_request->toString().c_str());
+        LOG_DEBUG(logger_, "%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                    *client_request);
         auto next_write = outgoing_ogw_requests_->getNextToWriteTo();
-        *next_write = std::move(*client_request);
+        *next_write = *client_request;
+        next_write->trace_ = current_trace_;
         outgoing_ogw_requests_->updateWriteIndex();
+        metric_requests_->add();
     }
 
     auto TradeEngine::onOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *book) noexcept -> void
     {
-        logger_.log("%:% %() % ticker:% price:% side:%\n", __FILE__, __LINE__, __FUNCTION__,
+        LOG_DEBUG(logger_, "%:% %() % ticker:% price:% side:%\n", __FILE__, __LINE__, __FUNCTION__,
                     thu::getCurrentTimeStr(&time_str_), ticker_id, thu::priceToString(price).c_str(),
                     thu::sideToString(side).c_str());
         auto bbo = book->getBBO();
         position_keeper_.updateBBO(ticker_id, bbo);
         feature_engine_.onOrderBookUpdate(ticker_id, price, side, book);
-        algoOnOrderBookUpdate_(ticker_id, price, side, book);
     }
     auto TradeEngine::onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book) noexcept -> void
     {
-        logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                    market_update->toString().c_str());
-        feature_engine_.onTradeUpdate(market_update, book);
-        algoOnTradeUpdate_(market_update, book);
+        LOG_DEBUG(logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                    *market_update);
+        feature_engine_.onTradeUpdate(market_update, book, now_);
     }
     auto TradeEngine::onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept -> void
     {
-        logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                    client_response->toString().c_str());
+        LOG_DEBUG(logger_, "%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+                    *client_response);
         if(UNLIKELY(client_response->type_ == Exchange::ClientResponseType::FILLED)){
             position_keeper_.addFill(client_response);
         }
-        algoOnOrderUpdate_(client_response);
     }
 }
\ No newline at end of file
@@ -1,5 +1,4 @@
 #pragma once
-#include <functional>
 
 #include "common/types.h"
 #include "common/thread_utils.h"
@@ -7,6 +6,7 @@
 #include "common/macros.h"
 #include "common/logging.h"
 #include "common/time_utils.h"
+#include "common/metrics.h"
 
 #include "exchange/order_server/client_request.h"
 #include "exchange/order_server/client_response.h"
@@ -18,24 +18,28 @@
 #include "order_manager.h"
 #include "risk_manager.h"
 
-#include "market_maker.h"
-#include "liquidity_taker.h"
-
 namespace Trading{
 using namespace thu;
 class OrderManager;
-class LiquidityTaker;
-class MarketMaker;
+// Queues, books, features, positions, orders and risk shared by every strategy. The strategy itself is a template
+// parameter of AlgoTradeEngine (algo_trade_engine.h), which owns the event loop, so strategy callbacks are called
+// directly and can be inlined. Only start() and destruction are virtual.
 class TradeEngine{
-private:
+protected:
+    static constexpr auto LOG_COMPONENT = thu::LogComponent::TRADE_ENGINE;
     ClientId client_id_;
     MarketOrderBookHashMap ticker_order_book_;
     Exchange::ClientRequestLFQueue *outgoing_ogw_requests_ = nullptr;
     Exchange::ClientResponseLFQueue *incoming_ogw_responses_ = nullptr;
     Exchange::MEMarketUpdateLFQueue *incoming_md_updates_ = nullptr;
     
+    // time of the events being processed: TSC time when live, simulated time in a backtest
+    Nanos now_ = 0;
     Nanos last_event_time_ = 0;
     volatile bool run_ = false;
+    bool started_ = false;
+    // apply every queued market update to the books first, then run features and strategy once per touched ticker
+    const bool conflate_md_;
 
     std::string time_str_;
     Logger logger_;
@@ -45,59 +49,64 @@ private:
     OrderManager order_manager_;
     RiskManager risk_manager_;
 
-    MarketMaker *mm_algo_ = nullptr;
-    LiquidityTaker *taker_algo_ = nullptr;
+    // trace of the market update being processed, copied into every request it leads to
+    TraceStamps current_trace_;
 
-    auto defaultAlgoOnOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *) noexcept->void{
-        logger_.log("%:% %() % ticker:% price:% side:%\n", __FILE__, __LINE__, __FUNCTION__,
-                    thu::getCurrentTimeStr(&time_str_), ticker_id, thu::priceToString(price).c_str(),
-                    thu::sideToString(side).c_str());
-    }
-    auto defaultAlgoOnTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *) noexcept->void{
-        logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                    market_update->toString().c_str());
-    }
-    auto defaultAlgoOnOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept->void{
-        logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
-                    client_response->toString().c_str());
-    }
+    // live values for chapter10_stat
+    Metric *metric_loops_ = metrics().counter("trade_engine.loops");
+    Metric *metric_md_updates_ = metrics().counter("trade_engine.md_updates");
+    Metric *metric_md_queue_depth_ = metrics().gauge("trade_engine.md_queue_depth");
+    Metric *metric_responses_ = metrics().counter("trade_engine.responses");
+    Metric *metric_requests_ = metrics().counter("trade_engine.requests");
+    Metric *metric_md_conflated_ = metrics().counter("trade_engine.md_conflated");
 
-public:
     TradeEngine(ClientId client_id, AlgoType type, const TradeEngineCfgHashMap &ticker_cfg
                 , Exchange::ClientRequestLFQueue *client_requests
                 , Exchange::ClientResponseLFQueue *client_responses
-                , Exchange::MEMarketUpdateLFQueue *market_updates);
-    ~TradeEngine();
+                , Exchange::MEMarketUpdateLFQueue *market_updates
+                , bool conflate_md
+                , const std::string &log_file_name);
+
+    // Engine side of each event, the strategy sees the event right after
+    auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *book) noexcept->void;
+    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book) noexcept->void;
+    auto onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept->void;
+
+public:
+    virtual ~TradeEngine();
     TradeEngine() = delete;
     TradeEngine(const TradeEngine &) = delete;
     TradeEngine& operator=(const TradeEngine&) = delete;
     TradeEngine(TradeEngine&&) = delete;
     TradeEngine& operator=(TradeEngine &&) = delete;
 
-    auto start()->void{
-        run_ = true;
-        ASSERT(createAndStartThread(-1, "Trading/Engine", [this](){run();}) != nullptr, "Failed to start TradeEngine thread.");
-    }
+    virtual auto start()->void = 0;
 
     auto stop()->void{
         while(incoming_ogw_responses_->size() || incoming_md_updates_->size()){
-            logger_.log("%:% %() % Sleeping till all updates are consumed ogw-size:% md-size:%\n", __FILE__, __LINE__, __FUNCTION__,
+            LOG_INFO(logger_, "%:% %() % Sleeping till all updates are consumed ogw-size:% md-size:%\n", __FILE__, __LINE__, __FUNCTION__,
                         thu::getCurrentTimeStr(&time_str_), incoming_ogw_responses_->size(), incoming_md_updates_->size());
 
             using namespace std::literals::chrono_literals;
             std::this_thread::sleep_for(10ms);
         }
-        logger_.log("%:% %() % POSITIONS\n%\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
+        LOG_AUDIT(logger_, "%:% %() % POSITIONS\n%\n", __FILE__, __LINE__, __FUNCTION__, thu::getCurrentTimeStr(&time_str_),
                     position_keeper_.toString());
+        LOG_INFO(logger_, "%:% %() % QUEUES ogw-requests hwm:% overflows:% ogw-responses hwm:% overflows:% md-updates hwm:% overflows:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    thu::getCurrentTimeStr(&time_str_),
+                    outgoing_ogw_requests_->highWaterMark(), outgoing_ogw_requests_->overflows(),
+                    incoming_ogw_responses_->highWaterMark(), incoming_ogw_responses_->overflows(),
+                    incoming_md_updates_->highWaterMark(), incoming_md_updates_->overflows());
 
         run_ = false;
     }
 
-    auto run() noexcept->void;
     auto sendClientRequest(const Exchange::MEClientRequest *client_request) noexcept->void;
-    auto onOrderBookUpdate(TickerId ticker_id, Price price, Side side, MarketOrderBook *book) noexcept->void;
-    auto onTradeUpdate(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book) noexcept->void;
-    auto onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept->void;
+
+    // Called by the strategy right before it acts on the current market update
+    auto traceDecision() noexcept{
+        current_trace_.stamp(Exchange::TradingHop::DECISION);
+    }
 
     auto initLastEventTime(){
         last_event_time_ = getCurrentNanos();
@@ -108,11 +117,8 @@ public:
     auto clientId() const{
         return client_id_;
     }
-
-    std::function<void(TickerId ticker_id, Price price, Side side, MarketOrderBook *book)> algoOnOrderBookUpdate_;
-    std::function<void(const Exchange::MEMarketUpdate *market_update, MarketOrderBook *book)> algoOnTradeUpdate_;
-    std::function<void(const Exchange::MEClientResponse *client_response)> algoOnOrderUpdate_;
-
-
+    auto positionKeeper() const noexcept -> const PositionKeeper&{
+        return position_keeper_;
+    }
 };
 }// end namespace
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include "backtest/parameter_sweep.h"
+#include "common/logging.h"
+#include "common/types.h"
+
+using namespace thu;
+
+// Backtests one strategy over a grid or a random sample of TradeEngineCfg values in parallel, all replaying the same
+// market data file, and writes one csv line per backtest to RESULTS_CSV. SAMPLES=0 runs the whole grid of SPEC_FILE.
+// usage: sweep_main MD_FILE ALGO ORDER_LATENCY_NS MD_LATENCY_NS SPEC_FILE RESULTS_CSV [SAMPLES=0] [WORKERS=all cpus] [SEED=1]
+namespace{
+    constexpr ClientId SWEEP_CLIENT_ID = 1;     // every backtest has its own exchange, so one id serves them all
+    constexpr size_t SWEEP_NUM_BEST = 10;
+}
+
+int main(int argc, char **argv){
+    if(argc < 7){
+        std::cerr << "usage: " << argv[0] << " MD_FILE ALGO ORDER_LATENCY_NS MD_LATENCY_NS SPEC_FILE RESULTS_CSV"
+                  << " [SAMPLES=0] [WORKERS=all cpus] [SEED=1]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    setLogLevels("WARN");
+    setLogLevels(getenv("THU_LOG_LEVELS"));
+
+    const std::string md_file_name = argv[1];
+    const auto algo_type = stringToAlgoType(argv[2]);
+    Trading::BacktestCfg cfg;
+    cfg.order_latency_ = std::atoll(argv[3]);
+    cfg.md_latency_ = std::atoll(argv[4]);
+    cfg.conflate_md_ = envFlag("THU_CONFLATE_MD");
+    const Trading::SweepSpec spec(argv[5]);
+    const std::string results_file_name = argv[6];
+    const size_t num_samples = argc > 7 ? std::atoll(argv[7]) : 0;
+    const size_t num_workers = argc > 8 ? std::atoll(argv[8]) : std::max(1u, std::thread::hardware_concurrency());
+    const uint64_t seed = argc > 9 ? std::atoll(argv[9]) : 1;
+
+    const auto cfgs = num_samples ? spec.sample(num_samples, seed) : spec.grid();
+    const Trading::MarketDataFile md_file(md_file_name);
+    std::cout << "Sweeping " << algoTypeToString(algo_type) << " over " << cfgs.size() << " of " << spec.gridSize()
+              << " parameter combinations on " << num_workers << " workers, " << md_file.size() << " market updates from "
+              << md_file_name << " " << cfg.toString() << std::endl;
+    const auto results = Trading::runSweep(md_file, SWEEP_CLIENT_ID, algo_type, cfgs, cfg, num_workers, results_file_name + ".logs");
+    Trading::writeSweepResults(results_file_name, cfgs, results);
+
+    std::vector<size_t> best(cfgs.size());
+    std::iota(best.begin(), best.end(), 0);
+    std::sort(best.begin(), best.end(), [&results](auto lhs, auto rhs){ return results[lhs].pnl_ > results[rhs].pnl_; });
+    best.resize(std::min(best.size(), SWEEP_NUM_BEST));
+    std::cout << "Best by pnl:\n";
+    for(const auto job : best){
+        std::cout << "job:" << job << " pnl:" << results[job].pnl_ << " max-drawdown:" << results[job].max_drawdown_
+                  << " fills:" << results[job].fills_ << " " << cfgs[job].toString() << "\n";
+    }
+    std::cout << "Results written to " << results_file_name << std::endl;
+    exit(EXIT_SUCCESS);
+}
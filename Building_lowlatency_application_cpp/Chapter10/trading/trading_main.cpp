@@ -1,17 +1,19 @@
 #include <csignal>
-#include "strategy/trade_engine.h"
+#include "strategy/algo_trade_engine.h"
 #include "order_gw/order_gateway.h"
 #include "market_data/market_data_consumer.h"
 #include "common/logging.h"
 #include "common/types.h"
 
 using namespace thu;
+static constexpr auto LOG_COMPONENT = LogComponent::MAIN;
 Logger *logger = nullptr;
 Trading::TradeEngine *trade_engine = nullptr;
 Trading::MarketDataConsumer *market_data_consumer = nullptr;
 Trading::OrderGateway *order_gateway = nullptr;
 
 int main(int argc, char **argv){
+    setLogLevels(getenv("THU_LOG_LEVELS"));
     const ClientId client_id = atoi(argv[1]);
     srand(client_id);
     const auto algo_type = stringToAlgoType(argv[2]);
@@ -27,25 +29,37 @@ int main(int argc, char **argv){
               }
             };
     }
+    // THU_QUOTE_LAYERS=N has the market maker quote N price levels per side instead of one
+    const auto quote_layers_env = getenv("THU_QUOTE_LAYERS");
+    const size_t quote_layers = (quote_layers_env && *quote_layers_env) ? std::atoll(quote_layers_env) : 1;
+    ASSERT(quote_layers >= 1 && quote_layers <= Trading::OM_MAX_LAYERS, "THU_QUOTE_LAYERS must be 1 to " + std::to_string(Trading::OM_MAX_LAYERS));
+    for(auto &ticker : ticker_cfg){
+        ticker.layers_ = quote_layers;
+    }
     logger = new Logger("trading_main_"+std::to_string(client_id) + ".log");
     const int sleep_time = 20*1000;
     Exchange::ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
     Exchange::ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
     Exchange::MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
     std::string time_str;
-    logger->log("%:% %() % Starting Trade Engine...\n",
+    LOG_INFO(*logger, "%:% %() % Starting Trade Engine...\n",
                 __FILE__, __LINE__, __FUNCTION__,
                 thu::getCurrentTimeStr(&time_str));
-    trade_engine = new Trading::TradeEngine(client_id, algo_type, ticker_cfg, &client_requests, &client_responses, &market_updates);
+    // THU_CONFLATE_MD=1 runs the strategy once per changed ticker per queue drain instead of once per update
+    const bool conflate_md = envFlag("THU_CONFLATE_MD");
+    trade_engine = Trading::makeTradeEngine(client_id, algo_type, ticker_cfg, &client_requests, &client_responses, &market_updates, conflate_md);
     trade_engine->start();
 
+    // THU_SHM_TRANSPORT=1 talks to an exchange_main on this host, started with the same setting, over shared memory
+    const bool use_shm = envFlag("THU_SHM_TRANSPORT");
+
     const std::string order_gw_ip = "127.0.0.1";
     const std::string order_gw_iface = "lo";
     const int order_gw_port = 12345;
-    logger->log("%:% %() % Starting Order Gateway...\n",
+    LOG_INFO(*logger, "%:% %() % Starting Order Gateway...\n",
                 __FILE__, __LINE__, __FUNCTION__,
                 thu::getCurrentTimeStr(&time_str));
-    order_gateway = new Trading::OrderGateway(client_id, &client_requests, &client_responses, order_gw_ip, order_gw_iface, order_gw_port);
+    order_gateway = new Trading::OrderGateway(client_id, algo_type, &client_requests, &client_responses, order_gw_ip, order_gw_iface, order_gw_port, use_shm);
     order_gateway->start();
     
     const std::string mkt_data_iface = "lo";
@@ -53,9 +67,9 @@ int main(int argc, char **argv){
     const int snapshot_port = 20000;
     const std::string incremental_ip = "233.252.14.3";
     const int incremental_port = 20001;
-    logger->log("%:% %() % Starting Market Data Consumer...\n ", __FILE__, __LINE__, __FUNCTION__,
+    LOG_INFO(*logger, "%:% %() % Starting Market Data Consumer...\n ", __FILE__, __LINE__, __FUNCTION__,
                 thu::getCurrentTimeStr(&time_str));
-    market_data_consumer = new Trading::MarketDataConsumer(client_id, &market_updates, mkt_data_iface, snapshot_ip, snapshot_port, incremental_ip, incremental_port);
+    market_data_consumer = new Trading::MarketDataConsumer(client_id, &market_updates, mkt_data_iface, snapshot_ip, snapshot_port, incremental_ip, incremental_port, use_shm);
     market_data_consumer->start();
 
     usleep(10*1000*1000);
@@ -89,7 +103,7 @@ int main(int argc, char **argv){
     }
 
     while(trade_engine->silentSeconds() < 60){
-        logger->log("%:% %() % Waiting till no activity, been silent for % seconds...\n", __FILE__, __LINE__, __FUNCTION__,
+        LOG_INFO(*logger, "%:% %() % Waiting till no activity, been silent for % seconds...\n", __FILE__, __LINE__, __FUNCTION__,
                     thu::getCurrentTimeStr(&time_str),
                     trade_engine->silentSeconds());
         using namespace std::literals::chrono_literals;
@@ -1,24 +1,25 @@
 #include <iostream>
 #include <thread>
-#include "lockfree_queue_multithread_in_push_using_reference_counting.h"
+#include <vector>
+#include "slogger.h"
 
 int main(){
-    lock_free_queue<int> queue;
+    constexpr int num_threads = 4;
+    constexpr int num_logs = 5'000;
+    thu::SLogger logger("slogger.log");
 
-    std::thread t1([&](){
-        for(int i=0; i<1'000'000; ++i){
-            queue.push(i);
-        }
-    });
-
-    std::thread t2([&](){
-        while (true)
-        {
-            auto ptr = queue.pop();
-            if(!ptr) std::cout << "popped: " << *ptr << " ";
-        }
-        
-    });
+    std::vector<std::thread> threads;
+    for(int t=0; t<num_threads; ++t){
+        threads.emplace_back([&, t](){
+            for(int i=0; i<num_logs; ++i){
+                logger.log("thread % message % value %", t, i, i * 0.5);
+            }
+        });
+    }
+    for(auto &t : threads){
+        t.join();
+    }
 
+    std::cout << "dropped: " << logger.dropped() << std::endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,307 @@
+#ifndef SLOGGER_H
+#define SLOGGER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace thu{
+    constexpr size_t SLOGGER_MAX_THREADS = 64;
+    constexpr size_t SLOGGER_BUFFER_SIZE = 1024 * 1024; // bytes per producing thread, power of two
+    constexpr size_t CACHE_LINE = 64;
+
+    inline auto slogger_now() noexcept -> int64_t{
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Every record starts with this header, arguments are copied raw right behind it
+    // and only turned into text by decode_ on the collector thread.
+    struct RecordHeader{
+        int64_t timestamp_;
+        uint32_t size_;             // whole record including padding, 0 marks the unused tail before a wrap
+        void (*decode_)(const char *fmt, const char *args, std::string &out);
+        const char *fmt_;
+    };
+
+    // Substitutes each '%' in fmt with the next argument.
+    template<typename T>
+    inline void append_arg(const char *&args, std::string &out){
+        T value;
+        memcpy(&value, args, sizeof(T));
+        args += sizeof(T);
+        if constexpr (std::is_same_v<T, char>){
+            out += value;
+        }
+        else if constexpr (std::is_same_v<T, bool>){
+            out += value ? "true" : "false";
+        }
+        else if constexpr (std::is_pointer_v<T>){
+            out += value; // const char*, must point to static storage
+        }
+        else{
+            out += std::to_string(value);
+        }
+    }
+
+    template<typename... Args>
+    void decode_record(const char *fmt, const char *args, std::string &out){
+        auto append_next = [&]<typename T>(){
+            for(; *fmt && *fmt != '%'; ++fmt){
+                out += *fmt;
+            }
+            if(*fmt){
+                ++fmt;
+                append_arg<T>(args, out);
+            }
+        };
+        (append_next.template operator()<Args>(), ...);
+        out += fmt;
+        out += '\n';
+    }
+
+    // Byte ring owned by one producing thread and drained by the collector.
+    // Records never straddle the end of the ring: a record that does not fit in the tail starts over at 0 and leaves a size 0
+    // marker behind, or nothing when the tail is shorter than a header.
+    class ThreadBuffer{
+    private:
+        alignas(CACHE_LINE) std::atomic<size_t> write_index_ = {0};
+        size_t cached_read_index_ = 0;          // producer only
+        size_t dropped_ = 0;                    // producer only
+        alignas(CACHE_LINE) std::atomic<size_t> read_index_ = {0};
+        alignas(CACHE_LINE) std::atomic<bool> in_use_ = {false};
+        std::unique_ptr<char[]> data_;
+
+        friend class SLogger;
+
+    public:
+        // Producer: size bytes, 8 byte aligned, or nullptr when the collector has not caught up.
+        char* reserve(size_t size) noexcept{
+            const auto write_index = write_index_.load(std::memory_order_relaxed);
+            const auto offset = write_index & (SLOGGER_BUFFER_SIZE - 1);
+            const auto skip = (offset + size > SLOGGER_BUFFER_SIZE) ? SLOGGER_BUFFER_SIZE - offset : 0;
+            if(write_index + skip + size - cached_read_index_ > SLOGGER_BUFFER_SIZE){
+                cached_read_index_ = read_index_.load(std::memory_order_acquire);
+                if(write_index + skip + size - cached_read_index_ > SLOGGER_BUFFER_SIZE){
+                    ++dropped_;
+                    return nullptr;
+                }
+            }
+            if(skip){
+                if(skip >= sizeof(RecordHeader)){
+                    reinterpret_cast<RecordHeader*>(&data_[offset])->size_ = 0;
+                }
+                write_index_.store(write_index + skip, std::memory_order_release);
+                return &data_[0];
+            }
+            return &data_[offset];
+        }
+
+        void commit(size_t size) noexcept{
+            write_index_.store(write_index_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+        }
+    };
+
+    // Multi-producer asynchronous logger. Every thread that logs gets its own ThreadBuffer on its first call,
+    // so a log call is a clock read plus a memcpy into memory no other producer writes to.
+    // One collector thread drains all buffers, merges the records by timestamp and writes them in one fwrite per batch.
+    // The merge is per batch: a record committed after the collector took its snapshot can carry an older timestamp
+    // than the last one written, by at most the time a batch takes.
+    // Buffers of exited threads are handed to the next thread that registers. The logger must outlive the producing threads.
+    class SLogger{
+    private:
+        std::array<ThreadBuffer, SLOGGER_MAX_THREADS> buffers_;
+        std::atomic<size_t> num_buffers_ = {0};
+        std::mutex register_mutex_;
+
+        FILE *file_ = nullptr;
+        std::atomic<bool> running_ = {true};
+        std::thread collector_;
+        std::string batch_;
+        std::atomic<size_t> written_ = {0};
+
+        struct ThreadHandle{
+            SLogger *logger_ = nullptr;
+            ThreadBuffer *buffer_ = nullptr;
+
+            ~ThreadHandle(){
+                if(buffer_){
+                    buffer_->in_use_.store(false, std::memory_order_release);
+                }
+            }
+        };
+
+        static ThreadHandle& thread_handle() noexcept{
+            thread_local ThreadHandle handle;
+            return handle;
+        }
+
+        ThreadBuffer* register_thread(){
+            std::lock_guard<std::mutex> lock(register_mutex_);
+            const auto num_buffers = num_buffers_.load(std::memory_order_relaxed);
+            for(size_t i = 0; i < num_buffers; ++i){
+                bool expected = false;
+                if(buffers_[i].in_use_.compare_exchange_strong(expected, true, std::memory_order_acq_rel)){
+                    return &buffers_[i];
+                }
+            }
+            if(num_buffers == SLOGGER_MAX_THREADS){
+                return nullptr;
+            }
+            // allocated on first registration and faulted in here, not in the first log call
+            buffers_[num_buffers].data_.reset(new char[SLOGGER_BUFFER_SIZE]);
+            memset(buffers_[num_buffers].data_.get(), 0, SLOGGER_BUFFER_SIZE);
+            buffers_[num_buffers].in_use_.store(true, std::memory_order_relaxed);
+            num_buffers_.store(num_buffers + 1, std::memory_order_release);
+            return &buffers_[num_buffers];
+        }
+
+        ThreadBuffer* local_buffer(){
+            auto &handle = thread_handle();
+            if(handle.logger_ != this){
+                if(handle.buffer_){
+                    handle.buffer_->in_use_.store(false, std::memory_order_release);
+                }
+                handle.logger_ = this;
+                handle.buffer_ = register_thread();
+            }
+            return handle.buffer_;
+        }
+
+        struct Cursor{
+            ThreadBuffer *buffer_;
+            size_t read_index_;
+            size_t end_index_;
+        };
+
+        // Skips the wrap marker, returns the next record below end_index_ or nullptr.
+        static const RecordHeader* head(Cursor &cursor) noexcept{
+            while(cursor.read_index_ < cursor.end_index_){
+                const auto offset = cursor.read_index_ & (SLOGGER_BUFFER_SIZE - 1);
+                const auto header = reinterpret_cast<const RecordHeader*>(&cursor.buffer_->data_[offset]);
+                if(SLOGGER_BUFFER_SIZE - offset >= sizeof(RecordHeader) && header->size_){
+                    return header;
+                }
+                cursor.read_index_ += SLOGGER_BUFFER_SIZE - offset;
+            }
+            return nullptr;
+        }
+
+        bool collect(){
+            std::array<Cursor, SLOGGER_MAX_THREADS> cursors;
+            size_t num_cursors = 0;
+            const auto num_buffers = num_buffers_.load(std::memory_order_acquire);
+            for(size_t i = 0; i < num_buffers; ++i){
+                auto &buffer = buffers_[i];
+                const auto read_index = buffer.read_index_.load(std::memory_order_relaxed);
+                const auto end_index = buffer.write_index_.load(std::memory_order_acquire);
+                if(read_index != end_index){
+                    cursors[num_cursors++] = {&buffer, read_index, end_index};
+                }
+            }
+            if(!num_cursors){
+                return false;
+            }
+
+            batch_.clear();
+            while(true){
+                Cursor *oldest = nullptr;
+                const RecordHeader *oldest_header = nullptr;
+                for(size_t i = 0; i < num_cursors; ++i){
+                    const auto header = head(cursors[i]);
+                    if(header && (!oldest_header || header->timestamp_ < oldest_header->timestamp_)){
+                        oldest = &cursors[i];
+                        oldest_header = header;
+                    }
+                }
+                if(!oldest){
+                    break;
+                }
+                batch_ += std::to_string(oldest_header->timestamp_);
+                batch_ += ' ';
+                oldest_header->decode_(oldest_header->fmt_, reinterpret_cast<const char*>(oldest_header + 1), batch_);
+                oldest->read_index_ += oldest_header->size_;
+                written_.store(written_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            for(size_t i = 0; i < num_cursors; ++i){
+                cursors[i].buffer_->read_index_.store(cursors[i].end_index_, std::memory_order_release);
+            }
+            fwrite(batch_.data(), 1, batch_.size(), file_);
+            return true;
+        }
+
+        void run(){
+            for(bool running = true; running;){
+                running = running_.load(std::memory_order_acquire);
+                if(!collect() && running){
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            }
+            fflush(file_);
+        }
+
+    public:
+        explicit SLogger(const std::string &file_name) : file_(fopen(file_name.c_str(), "w")){
+            if(!file_){
+                throw std::runtime_error("Could not open log file: " + file_name);
+            }
+            batch_.reserve(SLOGGER_BUFFER_SIZE);
+            collector_ = std::thread([this](){run();});
+        }
+
+        ~SLogger(){
+            running_.store(false, std::memory_order_release);
+            collector_.join();
+            fclose(file_);
+            auto &handle = thread_handle();
+            if(handle.logger_ == this){
+                handle = ThreadHandle();
+            }
+        }
+
+        SLogger(const SLogger&) = delete;
+        SLogger& operator=(const SLogger&) = delete;
+
+        // Arguments are copied byte for byte, so only arithmetic values and string literals can be passed.
+        template<typename... Args>
+        void log(const char *fmt, Args... args) noexcept{
+            static_assert((std::is_trivially_copyable_v<Args> && ...));
+            auto buffer = local_buffer();
+            if(!buffer){
+                return;
+            }
+            constexpr size_t size = ((sizeof(RecordHeader) + ... + sizeof(Args)) + 7) & ~size_t(7);
+            auto record = buffer->reserve(size);
+            if(!record){
+                return;
+            }
+            new(record) RecordHeader{slogger_now(), static_cast<uint32_t>(size), &decode_record<Args...>, fmt};
+            auto p = record + sizeof(RecordHeader);
+            ((memcpy(p, &args, sizeof(Args)), p += sizeof(Args)), ...);
+            buffer->commit(size);
+        }
+
+        // Records dropped because a thread's buffer was full, read after the producers stopped
+        size_t dropped() const noexcept{
+            size_t dropped = 0;
+            for(size_t i = 0; i < num_buffers_.load(std::memory_order_acquire); ++i){
+                dropped += buffers_[i].dropped_;
+            }
+            return dropped;
+        }
+
+        // Records written to the file so far
+        size_t written() const noexcept{
+            return written_.load(std::memory_order_relaxed);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,28 @@
+#include <benchmark/benchmark.h>
+#include "slogger.h"
+
+// ns per log call with 1 to 32 producers sharing one logger, the collector writes to /dev/null.
+// Needs a core per producer plus one for the collector, otherwise most calls measure the full-buffer drop path.
+static thu::SLogger logger("/dev/null");
+
+// items are the records that made it into a buffer, calls that found it full are counted in "dropped".
+// No thread logs before the loop starts or after it ends, so thread 0 reads the drop counters there.
+static void slogger_log(benchmark::State& s)
+{
+    const auto dropped_before = logger.dropped();
+    int64_t i = 0;
+    for(auto state : s){
+        logger.log("thread % message % value %", s.thread_index(), i, i * 0.5);
+        ++i;
+    }
+    int64_t dropped = 0;
+    if(s.thread_index() == 0){
+        dropped = static_cast<int64_t>(logger.dropped() - dropped_before);
+        s.counters["dropped"] = benchmark::Counter(static_cast<double>(dropped));
+    }
+    s.SetItemsProcessed(s.iterations() - dropped);
+}
+
+BENCHMARK(slogger_log)->ThreadRange(1, 32)->UseRealTime();
+
+BENCHMARK_MAIN();